@@ -0,0 +1,211 @@
+#include <grpcpp/grpcpp.h>
+#include "consensus.grpc.fb.h"
+#include "consensus_generated.h"
+
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+
+namespace tomchain
+{
+
+    grpc::Status TcClient::FbRegister(uint64_t stub_id)
+    {
+        spdlog::trace("gRPC-fb(Register) starts");
+
+        flatbuffers::grpc::MessageBuilder mb_;
+        const std::vector<uint8_t> &ser_pkey = this->ecc_pkey->get_pub_key_data();
+        auto pkey_offset = mb_.CreateVector(ser_pkey);
+        mb_.Finish(fb::CreateRegisterRequest(mb_, this->client_id, pkey_offset));
+        auto request_msg = mb_.ReleaseMessage<fb::RegisterRequest>();
+
+        flatbuffers::grpc::Message<fb::RegisterResponse> response_msg;
+        grpc::ClientContext context;
+        grpc::Status status = fb_stubs.at(stub_id)->Register(
+            &context,
+            request_msg,
+            &response_msg);
+
+        if (status.ok())
+        {
+            const fb::RegisterResponse *response = response_msg.GetRoot();
+            this->init_tss_key(response->tss_sk()->str());
+        }
+
+        spdlog::trace("gRPC-fb(Register): {}:{}",
+                      status.error_code(),
+                      status.error_message());
+
+        return status;
+    }
+
+    grpc::Status TcClient::FbHeartbeat(uint64_t stub_id)
+    {
+        flatbuffers::grpc::MessageBuilder mb_;
+        mb_.Finish(fb::CreateHeartbeatRequest(mb_, this->client_id));
+        auto request_msg = mb_.ReleaseMessage<fb::HeartbeatRequest>();
+
+        flatbuffers::grpc::Message<fb::HeartbeatResponse> response_msg;
+        grpc::ClientContext context;
+        grpc::Status status = fb_stubs.at(stub_id)->Heartbeat(
+            &context,
+            request_msg,
+            &response_msg);
+
+        spdlog::trace("gRPC-fb(Heartbeat): {}:{}",
+                      status.error_code(),
+                      status.error_message());
+
+        return status;
+    }
+
+    grpc::Status TcClient::FbPullPendingBlocks(uint64_t stub_id)
+    {
+        EASY_BLOCK("PullPendingBlocks_req");
+        spdlog::trace("gRPC-fb(PullPendingBlocks) starts");
+
+        flatbuffers::grpc::MessageBuilder mb_;
+        mb_.Finish(fb::CreatePullPendingBlocksRequest(mb_, this->client_id));
+        auto request_msg = mb_.ReleaseMessage<fb::PullPendingBlocksRequest>();
+
+        flatbuffers::grpc::Message<fb::PullPendingBlocksResponse> response_msg;
+        grpc::ClientContext context;
+
+        EASY_BLOCK("waiting");
+        spdlog::debug("PullPendingBlocks waiting for stub {}", stub_id);
+        grpc::Status status = fb_stubs.at(stub_id)->PullPendingBlocks(
+            &context,
+            request_msg,
+            &response_msg);
+        EASY_END_BLOCK;
+
+        // unpack response
+        EASY_BLOCK("unpack response");
+        const fb::PullPendingBlocksResponse *response = response_msg.GetRoot();
+        if (status.ok() && response->pb_hdrs() != nullptr)
+        {
+            for (auto fb_hdr : *(response->pb_hdrs()))
+            {
+                auto block_hdr = flatbuffers_adapter<BlockHeader>::from_fb(fb_hdr);
+                this->accept_header(block_hdr);
+            }
+        }
+        EASY_END_BLOCK;
+
+        spdlog::trace("gRPC-fb(PullPendingBlocks): {}:{}",
+                      status.error_code(),
+                      status.error_message());
+
+        EASY_END_BLOCK;
+
+        return status;
+    }
+
+    grpc::Status TcClient::FbGetBlocks(uint64_t stub_id)
+    {
+        EASY_BLOCK("GetBlocks_req");
+        spdlog::trace("gRPC-fb(GetBlocks): start");
+
+        EASY_BLOCK("render request");
+        flatbuffers::grpc::MessageBuilder mb_;
+        std::vector<flatbuffers::Offset<fb::BlockHeader>> hdr_vec;
+        for (auto iter = pending_blkhdr.begin(); iter != pending_blkhdr.end(); iter++)
+        {
+            hdr_vec.push_back(
+                flatbuffers_adapter<BlockHeader>::build(mb_, *(iter->second)));
+        }
+        auto pb_hdrs = mb_.CreateVector(hdr_vec);
+        mb_.Finish(fb::CreateGetBlocksRequest(mb_, pb_hdrs));
+        auto request_msg = mb_.ReleaseMessage<fb::GetBlocksRequest>();
+        EASY_END_BLOCK;
+
+        flatbuffers::grpc::Message<fb::GetBlocksResponse> response_msg;
+        grpc::ClientContext context;
+
+        EASY_BLOCK("waiting");
+        spdlog::debug("GetBlocks waiting for stub {}", stub_id);
+        grpc::Status status = fb_stubs.at(stub_id)->GetBlocks(
+            &context,
+            request_msg,
+            &response_msg);
+        EASY_END_BLOCK;
+
+        EASY_BLOCK("unpack response");
+        // gRPC verified the response on arrival
+        const fb::GetBlocksResponse *response = response_msg.GetRoot();
+        if (status.ok() && response->pb() != nullptr)
+        {
+            for (auto fb_block : *(response->pb()))
+            {
+                EASY_BLOCK("deserialize");
+                BlockView block_view(fb_block);
+                if (!block_view.verify())
+                {
+                    EASY_END_BLOCK;
+                    spdlog::warn("GetBlocks: malformed block dropped");
+                    continue;
+                }
+                auto block = block_view.to_block();
+                EASY_END_BLOCK;
+
+                spdlog::trace("GetBlocks tx count = {}", block->tx_vec_.size());
+
+                this->accept_block(block);
+
+                spdlog::trace("get block: {}, {}", block->header_.id_, block->header_.base_id_);
+            }
+        }
+        EASY_END_BLOCK;
+
+        spdlog::trace("gRPC-fb(GetBlocks): {}:{}",
+                      status.error_code(),
+                      status.error_message());
+
+        EASY_END_BLOCK;
+
+        return status;
+    }
+
+    grpc::Status TcClient::FbVoteBlocks(const std::vector<std::shared_ptr<BlockVote>> &votes)
+    {
+        EASY_BLOCK("VoteBlocks_req");
+        spdlog::trace("gRPC-fb(VoteBlocks): start");
+
+        // only the votes go on the wire, no block wrapper around them
+        EASY_BLOCK("serialize");
+        flatbuffers::grpc::MessageBuilder mb_;
+        std::vector<flatbuffers::Offset<fb::BlockVote>> vote_vec;
+        vote_vec.reserve(votes.size());
+        for (const auto &sp_vote : votes)
+        {
+            vote_vec.push_back(flatbuffers_adapter<BlockVote>::build(mb_, *sp_vote));
+        }
+        auto fb_votes = mb_.CreateVector(vote_vec);
+        mb_.Finish(fb::CreateVoteBlocksRequest(mb_, this->client_id, fb_votes));
+        auto request_msg = mb_.ReleaseMessage<fb::VoteBlocksRequest>();
+        EASY_END_BLOCK;
+
+        grpc::Status status;
+        for (uint64_t stub_id = 0; stub_id < fb_stubs.size(); stub_id++)
+        {
+            flatbuffers::grpc::Message<fb::VoteBlocksResponse> response_msg;
+            grpc::ClientContext context;
+
+            EASY_BLOCK("waiting");
+            spdlog::debug("VoteBlocks waiting for stub {}", stub_id);
+            status = fb_stubs.at(stub_id)->VoteBlocks(
+                &context,
+                request_msg,
+                &response_msg);
+            EASY_END_BLOCK;
+        }
+
+        spdlog::trace("gRPC-fb(VoteBlocks): {}:{}",
+                      status.error_code(),
+                      status.error_message());
+
+        EASY_END_BLOCK;
+
+        return status;
+    }
+
+}
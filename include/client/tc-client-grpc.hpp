@@ -2,12 +2,195 @@
 #include "tc-server.grpc.pb.h"
 
 #include "flexbuffers_adapter.hpp"
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+#include "vote_codec.hpp"
 
 namespace tomchain
 {
 
+    void TcClient::init_tss_key(const std::string &tss_sk_str)
+    {
+        BLSPrivateKeyShare skey_share(
+            tss_sk_str,
+            (*::conf_data)["vote-threshold"],
+            (*::conf_data)["client-count"]);
+        std::shared_ptr<libff::alt_bn128_Fr> skey_raw = skey_share.getPrivateKey();
+        BLSPublicKeyShare pkey_share(
+            *skey_raw,
+            (*::conf_data)["vote-threshold"],
+            (*::conf_data)["client-count"]);
+        this->tss_key = std::make_shared<std::pair<
+            std::shared_ptr<BLSPrivateKeyShare>,
+            std::shared_ptr<BLSPublicKeyShare>>>(
+            std::make_pair<
+                std::shared_ptr<BLSPrivateKeyShare>,
+                std::shared_ptr<BLSPublicKeyShare>>(
+                std::make_shared<BLSPrivateKeyShare>(skey_share),
+                std::make_shared<BLSPublicKeyShare>(pkey_share)));
+    }
+
+    bool TcClient::execute_block(std::shared_ptr<Block> sp_block)
+    {
+        EASY_BLOCK("verify body");
+        if (!sp_block->verify_body())
+        {
+            spdlog::warn("block {}: transactions do not match tx root", sp_block->header_.id_);
+            return false;
+        }
+        EASY_END_BLOCK;
+
+        // check transactions
+        EASY_BLOCK("check tx");
+        const uint64_t tx_count = sp_block->tx_vec_.size();
+        spdlog::trace("VoteBlocks tx count: {}", tx_count);
+
+        for (uint64_t i = 0; i < tx_count; i++)
+        {
+            const tomchain::Transaction &curr_tx = sp_block->tx_vec_[i];
+            const uint64_t sender = curr_tx.sender_;
+            const uint64_t receiver = curr_tx.receiver_;
+            std::string &sender_str = this->sender_strvec.at(i);
+            std::string &receiver_str = this->receiver_strvec.at(i);
+            snprintf(sender_str.data(), sender_str.size(), "%ld", sender);
+            snprintf(receiver_str.data(), receiver_str.size(), "%ld", receiver);
+        }
+
+        // std::unique_lock<std::mutex> db_ul_1(db_mutex);
+        for (uint64_t i = 0; i < tx_count; i++)
+        {
+            db->Get(rocksdb::ReadOptions(), sender_strvec[i], &sender_bal_strvec[i]);
+            db->Get(rocksdb::ReadOptions(), receiver_strvec[i], &receiver_bal_strvec[i]);
+
+            // calculations
+            // assert(sender_bal >= curr_tx->value);
+
+            db->Put(rocksdb::WriteOptions(), sender_strvec[i], sender_bal_strvec[i]);
+            db->Put(rocksdb::WriteOptions(), receiver_strvec[i], receiver_bal_strvec[i]);
+        }
+        // db_ul_1.unlock();
+        EASY_END_BLOCK;
+
+        return true;
+    }
+
+    bool TcClient::prepare_block(std::shared_ptr<Block> sp_block)
+    {
+        // the server seals each block; only vote for what was received
+        EASY_BLOCK("verify header");
+        if (!Block::verify_header(sp_block->header_))
+        {
+            spdlog::warn("block {}: digest mismatch, not voting", sp_block->header_.id_);
+            return false;
+        }
+        EASY_END_BLOCK;
+
+        // header votes run ahead of the body, see accept_block()
+        if (!this->header_votes && !this->execute_block(sp_block))
+        {
+            return false;
+        }
+
+        // no need to transmit transactions in vote
+        sp_block->tx_vec_.clear();
+        sp_block->tx_vec_.shrink_to_fit();
+
+        return true;
+    }
+
+    std::shared_ptr<BlockVote> TcClient::sign_block(std::shared_ptr<Block> sp_block)
+    {
+        auto block_hash_str = sp_block->get_sha256();
+
+        // client_id starts from 1, so does signer_index
+        EASY_BLOCK("sign");
+        std::shared_ptr<BLSSigShare> sig_share =
+            this->tss_key->first->sign(block_hash_str, this->client_id);
+        BlockVote bv;
+        bv.block_id_ = sp_block->header_.id_;
+        bv.sig_share_ = sig_share;
+        bv.voter_id_ = this->client_id;
+        EASY_END_BLOCK;
+
+        return std::make_shared<BlockVote>(bv);
+    }
+
+    std::shared_ptr<BlockVote> TcClient::sign_batch(const BatchCert &batch)
+    {
+        auto root = std::make_shared<std::array<uint8_t, picosha2::k_digest_size>>(batch.root);
+
+        EASY_BLOCK("sign batch");
+        std::shared_ptr<BLSSigShare> sig_share =
+            this->tss_key->first->sign(root, this->client_id);
+        BlockVote bv;
+        bv.block_id_ = batch.first_id;
+        bv.sig_share_ = sig_share;
+        bv.voter_id_ = this->client_id;
+        bv.batch_size_ = batch.size;
+        bv.batch_root_ = batch.root;
+        EASY_END_BLOCK;
+
+        return std::make_shared<BlockVote>(bv);
+    }
+
+    void TcClient::accept_header(std::shared_ptr<BlockHeader> block_hdr)
+    {
+        // servers only hand out blocks of our committees; check anyway
+        if (!committee::contains(
+                block_hdr->id_,
+                this->committee_seed,
+                (*::conf_data)["client-count"].template get<uint64_t>(),
+                this->committee_size,
+                this->client_id))
+        {
+            return;
+        }
+
+        // both servers of a block announce it
+        const bool is_new = pending_blkhdr.insert(
+            std::make_pair(
+                block_hdr->id_,
+                block_hdr));
+        spdlog::trace("block id: {}", block_hdr->id_);
+
+        if (is_new && this->header_votes)
+        {
+            auto sp_block = std::make_shared<Block>();
+            sp_block->header_ = *block_hdr;
+            vote_pipeline->push(sp_block);
+        }
+    }
+
+    void TcClient::accept_block(std::shared_ptr<Block> block)
+    {
+        if (this->header_votes)
+        {
+            // already voted on the header; execute off the vote path
+            EASY_BLOCK("execute");
+            this->execute_block(block);
+            EASY_END_BLOCK;
+        }
+        else
+        {
+            EASY_BLOCK("insert into pb");
+            vote_pipeline->push(
+                block);
+            EASY_END_BLOCK;
+        }
+
+        // remove block header from CHM
+        EASY_BLOCK("remove");
+        pending_blkhdr.erase(block->header_.id_);
+        EASY_END_BLOCK;
+    }
+
     grpc::Status TcClient::Register(uint64_t stub_id)
     {
+        if (this->use_fb_rpc)
+        {
+            return this->FbRegister(stub_id);
+        }
+
         RegisterRequest request;
         request.set_id(this->client_id);
         const std::vector<uint8_t> &ser_pkey = this->ecc_pkey->get_pub_key_data();
@@ -38,24 +221,7 @@ namespace tomchain
             cv.wait(lock);
         }
 
-        auto tss_sk_str = response.tss_sk();
-        BLSPrivateKeyShare skey_share(
-            tss_sk_str,
-            (*::conf_data)["client-count"],
-            (*::conf_data)["client-count"]);
-        std::shared_ptr<libff::alt_bn128_Fr> skey_raw = skey_share.getPrivateKey();
-        BLSPublicKeyShare pkey_share(
-            *skey_raw,
-            (*::conf_data)["client-count"],
-            (*::conf_data)["client-count"]);
-        this->tss_key = std::make_shared<std::pair<
-            std::shared_ptr<BLSPrivateKeyShare>,
-            std::shared_ptr<BLSPublicKeyShare>>>(
-            std::make_pair<
-                std::shared_ptr<BLSPrivateKeyShare>,
-                std::shared_ptr<BLSPublicKeyShare>>(
-                std::make_shared<BLSPrivateKeyShare>(skey_share),
-                std::make_shared<BLSPublicKeyShare>(pkey_share)));
+        this->init_tss_key(response.tss_sk());
 
         spdlog::trace("gRPC(Register): {}:{}",
                       status.error_code(),
@@ -66,6 +232,11 @@ namespace tomchain
 
     grpc::Status TcClient::Heartbeat(uint64_t stub_id)
     {
+        if (this->use_fb_rpc)
+        {
+            return this->FbHeartbeat(stub_id);
+        }
+
         HeartbeatRequest request;
         request.set_id(this->client_id);
         HeartbeatResponse response;
@@ -103,6 +274,11 @@ namespace tomchain
 
     grpc::Status TcClient::PullPendingBlocks(uint64_t stub_id)
     {
+        if (this->use_fb_rpc)
+        {
+            return this->FbPullPendingBlocks(stub_id);
+        }
+
         EASY_BLOCK("PullPendingBlocks_req");
         spdlog::trace("gRPC(PullPendingBlocks) starts");
 
@@ -141,20 +317,13 @@ namespace tomchain
         EASY_BLOCK("unpack response");
         for (int i = 0; i < response.pb_hdrs_size(); i++)
         {
-            auto iter = response.pb_hdrs(i);
             // msgpack::sbuffer des_b = stringToSbuffer(response.pb_hdrs(i));
             // auto oh = msgpack::unpack(des_b.data(), des_b.size());
             // auto block_hdr = oh->as<BlockHeader>();
-            std::vector<uint8_t> blkhdr_ser(iter.begin(), iter.end());
             auto block_hdr =
                 flexbuffers_adapter<BlockHeader>::from_bytes(
-                    std::make_shared<std::vector<uint8_t>>(blkhdr_ser));
-
-            pending_blkhdr.insert(
-                std::make_pair(
-                    block_hdr->id_,
-                    block_hdr));
-            spdlog::trace("block id: {}", block_hdr->id_);
+                    std::string_view(response.pb_hdrs(i)));
+            this->accept_header(block_hdr);
         }
         EASY_END_BLOCK;
 
@@ -174,6 +343,11 @@ namespace tomchain
 
     grpc::Status TcClient::GetBlocks(uint64_t stub_id)
     {
+        if (this->use_fb_rpc)
+        {
+            return this->FbGetBlocks(stub_id);
+        }
+
         EASY_BLOCK("GetBlocks_req");
         spdlog::trace("gRPC(GetBlocks): start");
 
@@ -185,10 +359,7 @@ namespace tomchain
             // msgpack::sbuffer b;
             // msgpack::pack(b, iter->second);
             // std::string blk_hdr_str = sbufferToString(b);
-            auto hdr_bv = flexbuffers_adapter<BlockHeader>::to_bytes(*(iter->second));
-            std::string blk_hdr_str(hdr_bv->begin(), hdr_bv->end());
-
-            request.add_pb_hdrs(blk_hdr_str);
+            flexbuffers_adapter<BlockHeader>::to_bytes(*(iter->second), *request.add_pb_hdrs());
         }
         EASY_END_BLOCK;
 
@@ -229,27 +400,23 @@ namespace tomchain
             // msgpack::sbuffer des_b = stringToSbuffer(*iter);
             // auto oh = msgpack::unpack(des_b.data(), des_b.size());
             // auto block = oh->as<Block>();
-            std::vector<uint8_t> blk_ser((*iter).begin(), (*iter).end());
-            auto block =
-                flexbuffers_adapter<Block>::from_bytes(
-                    std::make_shared<std::vector<uint8_t>>(blk_ser));
+            BlockView block_view(*iter);
+            if (!block_view.verify())
+            {
+                EASY_END_BLOCK;
+                spdlog::warn("GetBlocks: malformed block dropped");
+                continue;
+            }
+            auto block = block_view.to_block();
             EASY_END_BLOCK;
 
             spdlog::trace("GetBlocks tx count = {}", block->tx_vec_.size());
 
-            EASY_BLOCK("insert into pb");
-            pending_blks.push(
-                block);
-            EASY_END_BLOCK;
-
             // EASY_BLOCK("vote");
             // this->VoteBlocks();
             // EASY_END_BLOCK;
 
-            // remove block header from CHM
-            EASY_BLOCK("remove");
-            pending_blkhdr.erase(block->header_.id_);
-            EASY_END_BLOCK;
+            this->accept_block(block);
 
             spdlog::trace("get block: {}, {}", block->header_.id_, block->header_.base_id_);
         }
@@ -264,132 +431,79 @@ namespace tomchain
         return status;
     }
 
-    grpc::Status TcClient::VoteBlocks()
+    grpc::Status TcClient::VoteBlocks(const std::vector<std::shared_ptr<BlockVote>> &votes)
     {
+        if (this->use_fb_rpc)
+        {
+            return this->FbVoteBlocks(votes);
+        }
+
         EASY_BLOCK("VoteBlocks_req");
         spdlog::trace("gRPC(VoteBlocks): start");
 
-        grpc::Status status;
+        VoteBlocksRequest request;
+        request.set_id(this->client_id);
 
-        std::shared_ptr<Block> sp_block;
-        while (pending_blks.try_pop(sp_block))
+        EASY_BLOCK("serialize");
+        spdlog::trace("gRPC(VoteBlocks): serialize {} votes", votes.size());
+        std::vector<std::string> sig_shares =
+            vote_codec::encode_sig_shares(votes, this->vote_encoding);
+        request.set_share_encoding((ShareEncoding)(this->vote_encoding));
+        for (size_t i = 0; i < votes.size(); i++)
         {
-            VoteBlocksRequest request;
-            request.set_id(this->client_id);
-
-            // check transactions
-            EASY_BLOCK("check tx");
-            const uint64_t tx_count = sp_block->tx_vec_.size();
-            spdlog::trace("VoteBlocks tx count: {}", tx_count);
-
-            for (uint64_t i = 0; i < tx_count; i++)
+            VoteEntry *entry = request.add_votes();
+            entry->set_block_id(votes[i]->block_id_);
+            entry->set_voter_id(votes[i]->voter_id_);
+            entry->set_sig_share(std::move(sig_shares[i]));
+            entry->set_hint(votes[i]->sig_share_->getHint());
+            if (votes[i]->batch_size_ > 0)
             {
-                std::shared_ptr<tomchain::Transaction> curr_tx = sp_block->tx_vec_.at(i);
-                const uint64_t sender = curr_tx->sender_;
-                const uint64_t receiver = curr_tx->receiver_;
-                std::string &sender_str = this->sender_strvec.at(i);
-                std::string &receiver_str = this->receiver_strvec.at(i);
-                snprintf(sender_str.data(), sender_str.size(), "%ld", sender);
-                snprintf(receiver_str.data(), receiver_str.size(), "%ld", receiver);
+                entry->set_batch_size(votes[i]->batch_size_);
+                entry->set_batch_root(votes[i]->batch_root_.data(), votes[i]->batch_root_.size());
             }
+        }
+        EASY_END_BLOCK;
 
-            // std::unique_lock<std::mutex> db_ul_1(db_mutex);
-            for (uint64_t i = 0; i < tx_count; i++)
-            {
-                db->Get(rocksdb::ReadOptions(), sender_strvec[i], &sender_bal_strvec[i]);
-                db->Get(rocksdb::ReadOptions(), receiver_strvec[i], &receiver_bal_strvec[i]);
-
-                // calculations
-                // assert(sender_bal >= curr_tx->value);
-
-                db->Put(rocksdb::WriteOptions(), sender_strvec[i], sender_bal_strvec[i]);
-                db->Put(rocksdb::WriteOptions(), receiver_strvec[i], receiver_bal_strvec[i]);
-            }
-            // db_ul_1.unlock();
-            EASY_END_BLOCK;
-
-            auto block_hash_str = sp_block->get_sha256();
-            const uint64_t block_id = sp_block->header_.id_;
-
-            // no need to transmit transactions in vote
-            sp_block->tx_vec_.clear();
-
-            // client_id starts from 1, so does signer_index
-            EASY_BLOCK("sign");
-            auto signer_index = this->client_id;
-            std::shared_ptr<BLSSigShare> sig_share =
-                this->tss_key->first->sign(block_hash_str, this->client_id);
-            BlockVote bv;
-            bv.block_id_ = sp_block->header_.id_;
-            bv.sig_share_ = sig_share;
-            bv.voter_id_ = this->client_id;
-            EASY_END_BLOCK;
-
-            EASY_BLOCK("insert into votes");
-            sp_block->votes_.insert(
-                std::make_pair(
-                    this->client_id,
-                    std::make_shared<BlockVote>(bv)));
-            EASY_END_BLOCK;
+        // primary and shadow in flight together
+        const size_t stub_count = stubs.size();
+        std::vector<VoteBlocksResponse> responses(stub_count);
+        std::vector<grpc::ClientContext> contexts(stub_count);
+        std::vector<grpc::Status> statuses(stub_count);
+        std::mutex mu;
+        std::condition_variable cv;
+        size_t pending = stub_count;
 
-            EASY_BLOCK("serialize");
-            spdlog::trace("gRPC(VoteBlocks): serialize");
-            Block block = *(sp_block);
-            // msgpack::sbuffer b;
-            // msgpack::pack(b, iter->second);
-            // std::string block_ser = sbufferToString(b);
-            auto block_bv = flexbuffers_adapter<Block>::to_bytes(block);
-            std::string block_ser(block_bv->begin(), block_bv->end());
-            EASY_END_BLOCK;
+        EASY_BLOCK("waiting");
+        for (uint64_t stub_id = 0; stub_id < stub_count; stub_id++)
+        {
+            spdlog::debug("VoteBlocks waiting for stub {}", stub_id);
+            stubs.at(stub_id)->async()->VoteBlocks(
+                &contexts[stub_id],
+                &request,
+                &responses[stub_id],
+                [&mu, &cv, &pending, &statuses, stub_id](grpc::Status s)
+                {
+                    statuses[stub_id] = std::move(s);
+                    std::lock_guard<std::mutex> lock(mu);
+                    pending--;
+                    cv.notify_one();
+                });
+        }
 
-            EASY_BLOCK("add voted blocks");
-            request.add_voted_blocks(block_ser);
-            EASY_END_BLOCK;
+        std::unique_lock<std::mutex> lock(mu);
+        while (pending > 0)
+        {
+            cv.wait(lock);
+        }
+        lock.unlock();
+        EASY_END_BLOCK;
 
-            for (uint64_t stub_id = 0; stub_id < 2; stub_id++)
+        grpc::Status status;
+        for (const grpc::Status &s : statuses)
+        {
+            if (!s.ok())
             {
-                VoteBlocksResponse response;
-
-                grpc::ClientContext context;
-                std::mutex mu;
-                std::condition_variable cv;
-                bool done = false;
-
-                EASY_BLOCK("waiting");
-                spdlog::debug("VoteBlocks waiting for stub {}", stub_id);
-                stubs.at(stub_id)->async()->VoteBlocks(
-                    &context,
-                    &request,
-                    &response,
-                    [&mu, &cv, &done, &status](grpc::Status s)
-                    {
-                        status = std::move(s);
-                        std::lock_guard<std::mutex> lock(mu);
-                        done = true;
-                        cv.notify_one();
-                    });
-
-                std::unique_lock<std::mutex> lock(mu);
-                while (!done)
-                {
-                    cv.wait(lock);
-                }
-                lock.unlock();
-                EASY_END_BLOCK;
-
-                EASY_BLOCK("unpack response");
-                spdlog::trace("gRPC(VoteBlocks): recv response");
-                // for (auto iter = pending_blks.begin(); iter != pending_blks.end(); iter++)
-                // {
-                //     voted_blks.insert(
-                //         std::make_pair(
-                //             iter->first,
-                //             iter->second
-                //         )
-                //     );
-                // }
-                // pending_blks.clear();
-                EASY_END_BLOCK;
+                status = s;
             }
         }
 
@@ -5,10 +5,15 @@
 
 #include "entity/block.hpp" 
 #include "entity/transaction.hpp" 
+#include "entity/vote_codec.hpp" 
+#include "entity/committee.hpp" 
+#include "client/vote_pipeline.hpp" 
+#include "client/vote_batcher.hpp" 
 
 #include "HashMap.h"
 #include <grpcpp/grpcpp.h>
 #include "tc-server.grpc.pb.h"
+#include "consensus.grpc.fb.h"
 #include "key.h"
 #include "oneapi/tbb/concurrent_hash_map.h"
 #include "oneapi/tbb/concurrent_queue.h"
@@ -94,20 +99,101 @@ public:
     grpc::Status GetBlocks(uint64_t stub_id); 
 
     /**
-     * @brief Vote for blocks by sending signature shares 
+     * @brief Send one batch of signature shares to the primary and the 
+     * shadow server at once. 
      * 
      * @return grpc::Status RPC status. 
      */
-    grpc::Status VoteBlocks(); 
+    grpc::Status VoteBlocks(const std::vector<std::shared_ptr<BlockVote>>& votes); 
+
+public: 
+    /**
+     * @brief FlatBuffers counterparts of the calls above, 
+     * used when "rpc-codec" is "flatbuffers". 
+     * 
+     * @return grpc::Status RPC status. 
+     */
+    grpc::Status FbRegister(uint64_t stub_id); 
+    grpc::Status FbHeartbeat(uint64_t stub_id); 
+    grpc::Status FbPullPendingBlocks(uint64_t stub_id); 
+    grpc::Status FbGetBlocks(uint64_t stub_id); 
+    grpc::Status FbVoteBlocks(const std::vector<std::shared_ptr<BlockVote>>& votes); 
+
+private: 
+    /**
+     * @brief Derive the threshold key pair from the secret key share 
+     * handed out by the server on registration. 
+     * 
+     * @param tss_sk_str Serialized secret key share. 
+     */
+    void init_tss_key(const std::string& tss_sk_str); 
+
+    /**
+     * @brief Check the transactions of a block against its header and 
+     * apply them to the local state. 
+     * 
+     * @return false if the transactions do not match the tx root. 
+     */
+    bool execute_block(std::shared_ptr<Block> sp_block); 
+
+    /**
+     * @brief Check a pending block against its digest and execute it 
+     * unless votes are cast on headers. 
+     * 
+     * @param sp_block Block to vote for. Its transactions are dropped afterwards. 
+     * @return false if the block must not be voted for. 
+     */
+    bool prepare_block(std::shared_ptr<Block> sp_block); 
+
+    /**
+     * @brief Sign a prepared block. 
+     * 
+     * @return std::shared_ptr<BlockVote> Vote of this client. 
+     */
+    std::shared_ptr<BlockVote> sign_block(std::shared_ptr<Block> sp_block); 
+
+    /**
+     * @brief Sign the Merkle root of a batch of prepared blocks. 
+     * 
+     * @return std::shared_ptr<BlockVote> Batch vote of this client. 
+     */
+    std::shared_ptr<BlockVote> sign_batch(const BatchCert& batch); 
+
+    /**
+     * @brief Record a header from PullPendingBlocks. With header votes, a 
+     * new header is queued for signing right away. 
+     * 
+     */
+    void accept_header(std::shared_ptr<BlockHeader> block_hdr); 
+
+    /**
+     * @brief Take a block body from GetBlocks: queue it for signing, or 
+     * execute it if its header was already voted on. 
+     * 
+     */
+    void accept_block(std::shared_ptr<Block> block); 
+
+    /**
+     * @brief Build the vote pipeline: execute (one thread, blocks apply 
+     * in order), sign ("vote-sign-threads"), then send in batches of at most 
+     * "vote-batch-max" votes signed within "vote-batch-window-ms". 
+     * Each stage buffers up to "vote-pipeline-depth" blocks. 
+     * 
+     * With "vote-batch-blocks" above one, a batch stage between execute 
+     * and sign groups blocks so that one share covers that many blocks, 
+     * see VoteBatcher. 
+     */
+    void init_pipeline(); 
 
 public: 
     std::shared_ptr<ecdsa::Key> ecc_skey;
     std::shared_ptr<ecdsa::PubKey> ecc_pkey;
     uint64_t client_id;
     AccountCHM accounts;
-    oneapi::tbb::concurrent_queue<
-        std::shared_ptr<Block>
-    > pending_blks;
+    // blocks on their way from fetch to vote 
+    std::unique_ptr<VotePipeline> vote_pipeline; 
+    // null unless blocks are signed in batches 
+    std::unique_ptr<VoteBatcher> vote_batcher; 
     BlockHeaderCHM pending_blkhdr;
     std::shared_ptr<std::pair<
         std::shared_ptr<BLSPrivateKeyShare>, 
@@ -129,6 +215,34 @@ private:
      * 
      */
     std::vector<std::unique_ptr<TcConsensus::Stub>> stubs; 
+    std::vector<std::unique_ptr<fb::Consensus::Stub>> fb_stubs; 
+
+    /**
+     * @brief Whether to talk FlatBuffers instead of protobuf. 
+     * 
+     */
+    bool use_fb_rpc; 
+
+    /**
+     * @brief Signature share encoding of VoteBlocks ("vote-encoding"). 
+     * 
+     */
+    vote_codec::encoding vote_encoding; 
+
+    /**
+     * @brief Whether to sign headers as they arrive and execute block 
+     * bodies in the background ("vote-mode" is "header"). 
+     * 
+     */
+    bool header_votes; 
+
+    /**
+     * @brief Per-block committees ("committee-size", 0 for all clients); 
+     * this client only votes for blocks whose committee it is on. 
+     * 
+     */
+    uint64_t committee_size; 
+    uint64_t committee_seed; 
 
 };
 
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef TC_VOTE_BATCHER
+#define TC_VOTE_BATCHER
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <easy/profiler.h>
+
+#include "client/vote_pipeline.hpp"
+#include "entity/block.hpp"
+#include "entity/merkle.hpp"
+
+namespace tomchain
+{
+
+    /**
+     * @brief Groups prepared blocks into the batches of
+     * Block::batch_first_id() so that one signature share covers a whole
+     * batch.
+     *
+     * A batch leaves as a single task carrying its BatchCert once all of
+     * its members are prepared. Members of a batch still incomplete after
+     * `timeout_ms` leave as plain per-block tasks, so a stalled lane
+     * (a proposer stopping mid-batch, a block that failed to verify)
+     * delays votes by at most the timeout. Not thread-safe: the stage
+     * running it has one worker.
+     */
+    class VoteBatcher
+    {
+    public:
+        /**
+         * @brief Votes produced since the last take_stats().
+         *
+         */
+        struct Stats
+        {
+            uint64_t batches;
+            uint64_t singles;
+            size_t open;
+        };
+
+        VoteBatcher(uint64_t batch_size, uint64_t server_count, uint64_t timeout_ms)
+            : batch_size_(batch_size),
+              server_count_(server_count),
+              timeout_(std::chrono::milliseconds(timeout_ms)),
+              batches_(0),
+              singles_(0)
+        {
+        }
+
+        /**
+         * @brief Replace the prepared blocks in `batch` with one task per
+         * batch completed by them, plus the blocks of batches that timed
+         * out. An empty `batch` only checks for timeouts.
+         */
+        void collect(std::vector<VotePipeline::Task> &batch)
+        {
+            EASY_FUNCTION("VoteBatcher::collect");
+            const auto now = std::chrono::steady_clock::now();
+
+            std::vector<VotePipeline::Task> out;
+            for (VotePipeline::Task &task : batch)
+            {
+                const uint64_t block_id = task.block->header_.id_;
+                const uint64_t first_id = Block::batch_first_id(block_id, batch_size_, server_count_);
+                auto iter = open_.find(first_id);
+                if (iter == open_.end())
+                {
+                    iter = open_.emplace(first_id, Open{std::vector<std::shared_ptr<Block>>(batch_size_), 0, now}).first;
+                }
+
+                Open &open = iter->second;
+                std::shared_ptr<Block> &slot =
+                    open.members[Block::batch_index(block_id, batch_size_, server_count_)];
+                if (slot != nullptr)
+                {
+                    continue;
+                }
+                slot = std::move(task.block);
+                open.count++;
+
+                if (open.count == batch_size_)
+                {
+                    out.push_back(this->close(first_id, open));
+                    open_.erase(iter);
+                }
+            }
+
+            for (auto iter = open_.begin(); iter != open_.end();)
+            {
+                if (now - iter->second.since < timeout_)
+                {
+                    iter++;
+                    continue;
+                }
+                for (std::shared_ptr<Block> &member : iter->second.members)
+                {
+                    if (member != nullptr)
+                    {
+                        out.push_back(VotePipeline::Task{std::move(member), nullptr, nullptr});
+                        singles_++;
+                    }
+                }
+                iter = open_.erase(iter);
+            }
+
+            batch = std::move(out);
+        }
+
+        Stats take_stats()
+        {
+            Stats stats{batches_, singles_, open_.size()};
+            batches_ = 0;
+            singles_ = 0;
+            return stats;
+        }
+
+    private:
+        struct Open
+        {
+            std::vector<std::shared_ptr<Block>> members;
+            uint64_t count;
+            std::chrono::steady_clock::time_point since;
+        };
+
+        VotePipeline::Task close(uint64_t first_id, Open &open)
+        {
+            std::vector<merkle::digest> digests;
+            digests.reserve(batch_size_);
+            for (const std::shared_ptr<Block> &member : open.members)
+            {
+                digests.push_back(member->header_.digest_);
+            }
+            auto cert = std::make_shared<BatchCert>();
+            cert->first_id = first_id;
+            cert->size = batch_size_;
+            cert->root = merkle::tree(digests).root();
+            batches_++;
+            return VotePipeline::Task{std::move(open.members.front()), nullptr, std::move(cert)};
+        }
+
+    private:
+        const uint64_t batch_size_;
+        const uint64_t server_count_;
+        const std::chrono::steady_clock::duration timeout_;
+        std::map<uint64_t, Open> open_;
+        // read by the stats timer; counts only
+        uint64_t batches_;
+        uint64_t singles_;
+    };
+
+}
+
+#endif /* TC_VOTE_BATCHER */
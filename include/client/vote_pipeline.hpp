@@ -0,0 +1,306 @@
+#pragma once
+#ifndef TC_VOTE_PIPELINE
+#define TC_VOTE_PIPELINE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "oneapi/tbb/concurrent_queue.h"
+#include <easy/profiler.h>
+
+#include "entity/block.hpp"
+
+namespace tomchain
+{
+
+    /**
+     * @brief Bounded multi-stage pipeline between fetched blocks and sent
+     * votes.
+     *
+     * Each stage owns a pool of worker threads and a bounded input queue.
+     * A worker takes a batch of up to `batch_max` tasks (waiting at most
+     * `window_ms` for the batch to fill once its first task arrived), runs
+     * the stage function on it and forwards whatever the function left in
+     * the batch to the next stage. A full queue blocks the stage feeding
+     * it, so a slow stage holds back the ones before it instead of
+     * buffering without bound.
+     *
+     * A stage with `idle_ms` set also runs on an empty batch whenever no
+     * task arrived for that long, so that it can release tasks it holds
+     * back.
+     */
+    class VotePipeline
+    {
+    public:
+        struct Task
+        {
+            std::shared_ptr<Block> block;
+            std::shared_ptr<BlockVote> vote;
+            // set for a vote on a whole batch, see VoteBatcher
+            std::shared_ptr<const BatchCert> batch;
+        };
+
+        /**
+         * @brief Processes a batch in place. Tasks removed from the batch
+         * are dropped.
+         */
+        using StageFn = std::function<void(std::vector<Task> &)>;
+
+        /**
+         * @brief Occupancy of a stage since the last take_stats().
+         *
+         */
+        struct StageStats
+        {
+            std::string name;
+            size_t workers;
+            size_t queued;
+            uint64_t processed;
+            // share of worker time spent inside the stage function
+            double busy;
+        };
+
+        explicit VotePipeline(size_t capacity)
+            : capacity_(capacity),
+              pushed_(0),
+              stats_since_(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~VotePipeline()
+        {
+            this->stop();
+        }
+
+        /**
+         * @brief Append a stage. Stages run in the order they were added.
+         *
+         */
+        void add_stage(
+            const std::string &name,
+            size_t workers,
+            size_t batch_max,
+            uint64_t window_ms,
+            StageFn fn,
+            uint64_t idle_ms = 0)
+        {
+            auto stage = std::make_unique<Stage>();
+            stage->name = name;
+            stage->workers = std::max<size_t>(1, workers);
+            stage->batch_max = std::max<size_t>(1, batch_max);
+            stage->window_ms = window_ms;
+            stage->idle_ms = idle_ms;
+            stage->fn = std::move(fn);
+            stage->input.set_capacity(capacity_);
+            stage->processed = 0;
+            stage->busy_ns = 0;
+            stages_.push_back(std::move(stage));
+        }
+
+        void start()
+        {
+            for (size_t i = 0; i < stages_.size(); i++)
+            {
+                for (size_t w = 0; w < stages_[i]->workers; w++)
+                {
+                    threads_.emplace_back([this, i]()
+                                          { this->work(i); });
+                }
+            }
+        }
+
+        /**
+         * @brief Let every stage finish what it holds and join the workers.
+         *
+         */
+        void stop()
+        {
+            if (threads_.empty())
+            {
+                return;
+            }
+
+            // a null block tells one worker to leave; stages drain in order
+            size_t begin = 0;
+            for (size_t i = 0; i < stages_.size(); i++)
+            {
+                for (size_t w = 0; w < stages_[i]->workers; w++)
+                {
+                    stages_[i]->input.push(Task{nullptr, nullptr, nullptr});
+                }
+                const size_t end = begin + stages_[i]->workers;
+                for (size_t t = begin; t < end && t < threads_.size(); t++)
+                {
+                    if (threads_[t].joinable())
+                    {
+                        threads_[t].join();
+                    }
+                }
+                begin = end;
+            }
+            threads_.clear();
+        }
+
+        /**
+         * @brief Feed a block into the first stage. Waits while the stage
+         * is full.
+         */
+        void push(std::shared_ptr<Block> sp_block)
+        {
+            EASY_BLOCK("pipeline push");
+            stages_.front()->input.push(Task{std::move(sp_block), nullptr, nullptr});
+            pushed_.fetch_add(1, std::memory_order_relaxed);
+            EASY_END_BLOCK;
+        }
+
+        /**
+         * @brief Blocks fed in so far.
+         *
+         */
+        uint64_t pushed() const
+        {
+            return pushed_.load(std::memory_order_relaxed);
+        }
+
+        std::vector<StageStats> take_stats()
+        {
+            const auto now = std::chrono::steady_clock::now();
+            const double elapsed_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          now - stats_since_)
+                                          .count();
+            stats_since_ = now;
+
+            std::vector<StageStats> stats;
+            for (auto &stage : stages_)
+            {
+                StageStats s;
+                s.name = stage->name;
+                s.workers = stage->workers;
+                s.queued = (size_t)std::max<std::ptrdiff_t>(0, stage->input.size());
+                s.processed = stage->processed.exchange(0, std::memory_order_relaxed);
+                const uint64_t busy_ns = stage->busy_ns.exchange(0, std::memory_order_relaxed);
+                s.busy = elapsed_ns <= 0 ? 0 : busy_ns / (elapsed_ns * stage->workers);
+                stats.push_back(s);
+            }
+            return stats;
+        }
+
+    private:
+        struct Stage
+        {
+            std::string name;
+            size_t workers;
+            size_t batch_max;
+            uint64_t window_ms;
+            uint64_t idle_ms;
+            StageFn fn;
+            oneapi::tbb::concurrent_bounded_queue<Task> input;
+            std::atomic<uint64_t> processed;
+            std::atomic<uint64_t> busy_ns;
+        };
+
+        void work(size_t index)
+        {
+            Stage &stage = *stages_[index];
+            std::vector<Task> batch;
+            bool leaving = false;
+            while (!leaving)
+            {
+                batch.clear();
+                Task task;
+                // an idle tick runs the stage on an empty batch
+                if (this->pop(stage, task))
+                {
+                    if (task.block == nullptr)
+                    {
+                        return;
+                    }
+                    batch.push_back(std::move(task));
+                }
+
+                // the window opens with the first task of the batch
+                const auto window_start = std::chrono::steady_clock::now();
+                while (!batch.empty() && batch.size() < stage.batch_max)
+                {
+                    if (stage.input.try_pop(task))
+                    {
+                        if (task.block == nullptr)
+                        {
+                            leaving = true;
+                            break;
+                        }
+                        batch.push_back(std::move(task));
+                        continue;
+                    }
+                    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - window_start);
+                    if ((uint64_t)(elapsed.count()) >= stage.window_ms)
+                    {
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+
+                const size_t taken = batch.size();
+                const auto fn_start = std::chrono::steady_clock::now();
+                stage.fn(batch);
+                stage.busy_ns.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - fn_start)
+                        .count(),
+                    std::memory_order_relaxed);
+                stage.processed.fetch_add(taken, std::memory_order_relaxed);
+
+                if (index + 1 < stages_.size())
+                {
+                    for (Task &out : batch)
+                    {
+                        stages_[index + 1]->input.push(std::move(out));
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Wait for the next task, or at most idle_ms if set.
+         *
+         * @return false if the wait timed out.
+         */
+        bool pop(Stage &stage, Task &task)
+        {
+            if (stage.idle_ms == 0)
+            {
+                stage.input.pop(task);
+                return true;
+            }
+            const auto idle_start = std::chrono::steady_clock::now();
+            while (!stage.input.try_pop(task))
+            {
+                const auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - idle_start);
+                if ((uint64_t)(idle.count()) >= stage.idle_ms)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            return true;
+        }
+
+    private:
+        const size_t capacity_;
+        std::vector<std::unique_ptr<Stage>> stages_;
+        std::vector<std::thread> threads_;
+        std::atomic<uint64_t> pushed_;
+        std::chrono::steady_clock::time_point stats_since_;
+    };
+
+}
+
+#endif /* TC_VOTE_PIPELINE */
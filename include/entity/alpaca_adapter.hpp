@@ -0,0 +1,172 @@
+#pragma once
+#ifndef TC_ALPACA_ADAPTER
+#define TC_ALPACA_ADAPTER
+
+#include <alpaca/alpaca.h>
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include "libBLS/libBLS.h"
+#include "libBLS/bls/BLSSigShare.h"
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+#include "block.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Wire layouts for alpaca_adapter.
+ *
+ * alpaca reflects over aggregates, which the entity classes are not
+ * (constructors, shared_ptr members), so each entity has a plain mirror
+ * here. The member order is the field list on the wire.
+ */
+namespace alpaca_wire {
+
+struct BlockHeader {
+    uint64_t id;
+    uint64_t base_id;
+    uint64_t proposal_ts;
+    uint64_t dist_ts;
+    uint64_t commit_ts;
+    uint64_t recv_ts;
+    uint64_t tx_count;
+    std::array<uint8_t, 32> tx_root;
+    std::array<uint8_t, 32> digest;
+};
+
+struct Transaction {
+    uint64_t id;
+    uint64_t sender;
+    uint64_t receiver;
+    uint64_t value;
+    uint64_t fee;
+};
+
+struct BLSSigShare {
+    std::array<uint8_t, 96> g1;
+    std::string hint;
+    uint64_t signer_index;
+    uint64_t t;
+    uint64_t n;
+};
+
+struct BlockVote {
+    uint64_t block_id;
+    uint64_t voter_id;
+    std::optional<BLSSigShare> sig_share;
+};
+
+struct Block {
+    BlockHeader header;
+    std::vector<Transaction> txs;
+    std::vector<BlockVote> votes;
+};
+
+}
+
+/**
+ * @brief Fixed-width integers, so encoding is a sequence of memcpy
+ * instead of varint packing.
+ */
+constexpr auto alpaca_options = alpaca::options::fixed_length_encoding;
+
+/**
+ * @brief Scratch buffer reused by every to_bytes() call on the current
+ * thread. Cleared before each use.
+ */
+std::vector<uint8_t>& alpaca_thread_buffer();
+
+/**
+ * @brief Byte-level entry points shared by all alpaca_adapter
+ * specializations, matching flexbuffers_codec.
+ *
+ * Each specialization supplies its Wire mirror and to_wire()/from_wire().
+ */
+template<typename Adapter, typename T>
+struct alpaca_codec {
+    static std::shared_ptr<T> from_bytes(std::span<const uint8_t> bytes)
+    {
+        std::error_code ec;
+        auto wire = alpaca::deserialize<alpaca_options, typename Adapter::Wire>(bytes, ec);
+        if (ec)
+        {
+            spdlog::error("alpaca decode failed: {}", ec.message());
+            return nullptr;
+        }
+        return Adapter::from_wire(wire);
+    }
+
+    static std::shared_ptr<T> from_bytes(std::string_view bytes)
+    {
+        return from_bytes(std::span<const uint8_t>(
+            (const uint8_t*)(bytes.data()), bytes.size()));
+    }
+
+    static std::shared_ptr<T> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    {
+        return from_bytes(std::span<const uint8_t>(*bytes));
+    }
+
+    static void to_bytes(const T& obj, std::string& out)
+    {
+        std::vector<uint8_t>& buf = alpaca_thread_buffer();
+        alpaca::serialize<alpaca_options>(Adapter::to_wire(obj), buf);
+        out.assign((const char*)(buf.data()), buf.size());
+    }
+
+    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const T& obj)
+    {
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
+        alpaca::serialize<alpaca_options>(Adapter::to_wire(obj), *bytes);
+        return bytes;
+    }
+};
+
+template<typename T>
+struct alpaca_adapter;
+
+template<>
+struct alpaca_adapter<BlockHeader> : alpaca_codec<alpaca_adapter<BlockHeader>, BlockHeader> {
+    using Wire = alpaca_wire::BlockHeader;
+    static Wire to_wire(const BlockHeader& bh);
+    static std::shared_ptr<BlockHeader> from_wire(const Wire& wire);
+};
+
+template<>
+struct alpaca_adapter<Transaction> : alpaca_codec<alpaca_adapter<Transaction>, Transaction> {
+    using Wire = alpaca_wire::Transaction;
+    static Wire to_wire(const Transaction& tx);
+    static std::shared_ptr<Transaction> from_wire(const Wire& wire);
+};
+
+template<>
+struct alpaca_adapter<BLSSigShare> : alpaca_codec<alpaca_adapter<BLSSigShare>, BLSSigShare> {
+    using Wire = alpaca_wire::BLSSigShare;
+    static Wire to_wire(const BLSSigShare& sig_share);
+    static std::shared_ptr<BLSSigShare> from_wire(const Wire& wire);
+};
+
+template<>
+struct alpaca_adapter<BlockVote> : alpaca_codec<alpaca_adapter<BlockVote>, BlockVote> {
+    using Wire = alpaca_wire::BlockVote;
+    static Wire to_wire(const BlockVote& vote);
+    static std::shared_ptr<BlockVote> from_wire(const Wire& wire);
+};
+
+template<>
+struct alpaca_adapter<Block> : alpaca_codec<alpaca_adapter<Block>, Block> {
+    using Wire = alpaca_wire::Block;
+    static Wire to_wire(const Block& block);
+    static std::shared_ptr<Block> from_wire(const Wire& wire);
+};
+
+}
+
+#endif /* TC_ALPACA_ADAPTER */
@@ -9,11 +9,16 @@
 
 #include <vector>
 #include <memory> 
+#include <atomic>
 #include <istream>
 #include <ostream>
 #include <string>
 
 #include "transaction.hpp"
+#include "sha256.hpp"
+#include "merkle.hpp"
+#include "lagrange.hpp"
+#include "msm.hpp"
 
 namespace tomchain {
 
@@ -32,6 +37,11 @@ public:
     uint64_t dist_ts_; 
     uint64_t commit_ts_; 
     uint64_t recv_ts_; 
+    // transaction count and Merkle root, see merkle.hpp 
+    uint64_t tx_count_; 
+    sha256::digest tx_root_; 
+    // canonical digest, see Block::seal(); all zero until sealed 
+    sha256::digest digest_; 
 
     MSGPACK_DEFINE(
         id_,
@@ -39,7 +49,10 @@ public:
         proposal_ts_, 
         dist_ts_, 
         commit_ts_, 
-        recv_ts_
+        recv_ts_, 
+        tx_count_, 
+        tx_root_, 
+        digest_
     );
 }; 
 
@@ -52,6 +65,22 @@ public:
     uint64_t block_id_; 
     uint64_t voter_id_; 
     std::shared_ptr<BLSSigShare> sig_share_; 
+    // non-zero for a batch vote: the share signs batch_root_ of the 
+    // batch_size_ blocks starting at block_id_, see Block::batch_first_id() 
+    uint64_t batch_size_; 
+    sha256::digest batch_root_; 
+}; 
+
+/**
+ * @brief Shared by the blocks committed through one batch vote. Their 
+ * tss_sig_ signs `root`, the Merkle root over the member digests in 
+ * batch order. 
+ * 
+ */
+struct BatchCert {
+    uint64_t first_id; 
+    uint64_t size; 
+    sha256::digest root; 
 }; 
 
 /**
@@ -66,21 +95,162 @@ public:
     virtual ~Block(); 
 
 public: 
-    void insert(std::shared_ptr<Transaction> tx);
+    void insert(const Transaction& tx);
+
+    /**
+     * @brief Digest signed by voters, sealing the block first if needed. 
+     * 
+     */
     std::shared_ptr<std::array<uint8_t, picosha2::k_digest_size>> get_sha256(); 
+
+    /**
+     * @brief Digest over the consensus fields of a header only: id, base 
+     * id, transaction count and Merkle root. Timestamps are left out so 
+     * that they can change without a rehash. 
+     * 
+     * Covering the root instead of the transactions lets a client check 
+     * and sign a header before the block body arrives. 
+     */
+    static sha256::digest compute_digest(const BlockHeader& header); 
+
+    /**
+     * @brief Build the Merkle tree, fill in tx_count_, tx_root_ and 
+     * digest_ of the header. Called once, when the transactions are final. 
+     * 
+     */
+    void seal(); 
+    bool is_sealed() const; 
+
+    /**
+     * @brief Whether a header is sealed and matches its digest. 
+     * 
+     */
+    static bool verify_header(const BlockHeader& header); 
+
+    /**
+     * @brief Whether tx_vec_ matches tx_count_ and tx_root_ of the header. 
+     * 
+     */
+    bool verify_body() const; 
+
+    /**
+     * @brief verify_header() and verify_body() together. 
+     * 
+     */
+    bool verify_digest() const; 
     bool is_vote_enough(const uint64_t target_num) const; 
-    void merge_votes(const uint64_t target_num); 
+
+    /**
+     * @brief Insert a vote and, once Lagrange coefficients are cached, 
+     * fold lambda_i * share_i into the running aggregate. 
+     * 
+     * @param key Key in votes_. 
+     * @return false if the key has already voted. 
+     */
+    bool add_vote(uint64_t key, std::shared_ptr<BlockVote> vote); 
+
+    /**
+     * @brief Drop a vote and take its share back out of the aggregate. 
+     * 
+     */
+    void remove_vote(uint64_t key); 
+
+    /**
+     * @brief Set tss_sig_ from `required` of the `total` signers. 
+     * 
+     * n-of-n uses the running aggregate if the coefficients for `total` 
+     * signers are cached. t-of-n interpolates the first `required` votes 
+     * with coefficients for that subset in one multi-scalar 
+     * multiplication. BLSSigShareSet is the fallback for both. 
+     * 
+     * @param merge_threads Threads BLSSigShareSet may use. 
+     */
+    void merge_votes(const uint64_t required, const uint64_t total, size_t merge_threads = 1); 
 
     // server id starts from one 
     std::set<uint64_t> get_server_id(uint64_t server_count) const; 
+    static std::set<uint64_t> get_server_id(uint64_t block_id, uint64_t server_count); 
+
+    /**
+     * @brief A batch is `batch_size` consecutive blocks of one server 
+     * lane (same id % server_count), so all members share their primary 
+     * and shadow server and every voter derives the same batches. 
+     * 
+     * @return Id of the first member of the batch holding `block_id`. 
+     */
+    static uint64_t batch_first_id(uint64_t block_id, uint64_t batch_size, uint64_t server_count); 
+    static uint64_t batch_member_id(uint64_t first_id, uint64_t index, uint64_t server_count); 
+    static uint64_t batch_index(uint64_t block_id, uint64_t batch_size, uint64_t server_count); 
+
+    /**
+     * @brief Whether batch_proof_ places header_.digest_ at leaf 
+     * batch_index_ under batch_->root. 
+     * 
+     */
+    bool verify_batch_proof() const; 
+
+public: 
+    /**
+     * @brief Encoded payload shared by every send of this block. 
+     * 
+     * @return Cached bytes, or nullptr if nothing was cached since the 
+     * last invalidate_payload(). 
+     */
+    std::shared_ptr<const std::string> get_payload() const; 
+
+    /**
+     * @brief Cache an encoding of this block. 
+     * 
+     * @param epoch Value of payload_epoch() read before encoding started; 
+     * an encoding raced by an invalidation is never served. 
+     * @param bytes Encoded block. 
+     * @return std::shared_ptr<const std::string> The cached bytes. 
+     */
+    std::shared_ptr<const std::string> set_payload(uint64_t epoch, std::string&& bytes) const; 
+    uint64_t payload_epoch() const; 
+
+    /**
+     * @brief Drop the cached payload. Must be called after any change to 
+     * header_, votes_ or tss_sig_ of a block that may have been sent. 
+     * 
+     */
+    void invalidate_payload(); 
 
 public: 
     BlockHeader header_; 
-    std::vector<
-        std::shared_ptr<Transaction>
-    > tx_vec_; 
+    // stored inline: one allocation per block 
+    std::vector<Transaction> tx_vec_; 
     std::map<uint64_t, std::shared_ptr<BlockVote>> votes_; 
     std::shared_ptr<BLSSignature> tss_sig_;
+    // set when committed through a batch vote; tss_sig_ then signs 
+    // batch_->root instead of header_.digest_ 
+    std::shared_ptr<const BatchCert> batch_; 
+    uint64_t batch_index_; 
+    std::vector<merkle::digest> batch_proof_; 
+    // a vote container of a batch rather than a block; header_.digest_ 
+    // holds the batch root 
+    bool is_batch_vote_; 
+    // set once the server appended the block to its AnnounceLog 
+    std::atomic<bool> announced_; 
+    // set while the block is out of the pending pool, so that clients 
+    // no longer pull it 
+    std::atomic<bool> finalized_; 
+
+private: 
+    bool fold_share(const BlockVote& vote, bool add);
+    void set_tss_sig(libff::alt_bn128_G1 sig, const uint64_t required, const uint64_t total); 
+
+    // sum of lambda_i * share_i over the first sig_acc_count_ votes 
+    libff::alt_bn128_G1 sig_acc_; 
+    size_t sig_acc_count_; 
+
+
+    struct EncodedPayload {
+        uint64_t epoch; 
+        std::string bytes; 
+    }; 
+    std::atomic<uint64_t> payload_epoch_; 
+    mutable std::atomic<std::shared_ptr<const EncodedPayload>> payload_; 
 };
 
 };
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef TC_BLOCK_VIEW
+#define TC_BLOCK_VIEW
+
+#include <memory>
+#include <string>
+
+#include "consensus_generated.h"
+#include "block.hpp"
+#include "tx_codec.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Read-in-place view over a FlatBuffers encoded block.
+ *
+ * The view does not own the buffer; the caller keeps it alive
+ * (e.g. the protobuf request or response message). Bytes from the
+ * network must pass verify() before any other accessor is called.
+ */
+class BlockView {
+public:
+    BlockView(const uint8_t* data, size_t size);
+    explicit BlockView(const std::string& bytes);
+    /**
+     * @brief Views a block nested in another message (e.g. GetBlocksResponse).
+     *
+     * The enclosing buffer is expected to be verified already.
+     */
+    explicit BlockView(const fb::Block* root);
+
+public:
+    /**
+     * @brief Runs the FlatBuffers verifier over the underlying buffer.
+     *
+     * @return true if the buffer holds a well-formed block with a header.
+     */
+    bool verify() const;
+
+    uint64_t id() const;
+    const fb::BlockHeader* header() const;
+    BlockHeader to_header() const;
+
+    size_t tx_count() const;
+    /**
+     * @brief Row access; only valid when has_tx_columns() is false.
+     *
+     */
+    const fb::Transaction& tx_at(size_t index) const;
+
+    bool has_tx_columns() const;
+    /**
+     * @brief Decodes the columnar transactions, see tx_codec.
+     *
+     * @return false if the block has no or malformed columns.
+     */
+    bool decode_tx_columns(tx_codec::columns& out) const;
+
+    size_t vote_count() const;
+    const fb::BlockVote* find_vote(uint64_t voter_id) const;
+    std::shared_ptr<BlockVote> get_vote(uint64_t voter_id) const;
+
+    /**
+     * @brief Copies the commit certificate (tss_sig_ and, for a batch
+     * commit, batch_, batch_index_ and batch_proof_) into `block`.
+     *
+     * @return false, leaving `block` alone, if the view carries no
+     * certificate or a malformed signature.
+     */
+    bool copy_commit(Block& block) const;
+
+    /**
+     * @brief Materializes an owning Block.
+     *
+     * Row transactions are copied into tx_vec_ with a single memcpy.
+     */
+    std::shared_ptr<Block> to_block() const;
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    const fb::Block* root_;
+};
+
+}
+
+#endif /* TC_BLOCK_VIEW */
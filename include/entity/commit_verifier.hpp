@@ -0,0 +1,49 @@
+#pragma once
+#ifndef TC_COMMIT_VERIFIER
+#define TC_COMMIT_VERIFIER
+
+#include <array>
+#include <cstdint>
+#include "libBLS/libBLS.h"
+
+#include "block.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Checks the aggregated signature of committed blocks against
+ * the group public key.
+ *
+ * A certificate sig over message m is valid if
+ *
+ *   e(sig, g2) * e(-H(m), pk) = 1
+ *
+ * Both G2 arguments are fixed for the lifetime of the key, so their
+ * Miller-loop line coefficients are computed once here. A check is then
+ * a hash to G1, one double Miller loop over the cached lines and one
+ * final exponentiation.
+ */
+class CommitVerifier {
+public:
+    explicit CommitVerifier(const libff::alt_bn128_G2& group_pkey);
+
+public:
+    bool verify(const std::array<uint8_t, 32>& hash, const libff::alt_bn128_G1& sig) const;
+
+    /**
+     * @brief Whether tss_sig_ signs header_.digest_, or batch_->root when
+     * the block was committed through a batch and verify_batch_proof()
+     * holds.
+     *
+     */
+    bool verify(const Block& block) const;
+
+private:
+    libff::alt_bn128_G2_precomp generator_lines_;
+    libff::alt_bn128_G2_precomp pkey_lines_;
+    bool pkey_valid_;
+};
+
+}
+
+#endif /* TC_COMMIT_VERIFIER */
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef TC_COMMITTEE
+#define TC_COMMITTEE
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tomchain {
+
+/**
+ * @brief Per-block voter committees drawn from the registered clients.
+ *
+ * members() picks `size` distinct client ids out of 1..client_count with
+ * Floyd's sampling algorithm, driven by splitmix64 seeded from `seed`
+ * and the block id. Clients and servers derive the same committee
+ * without exchanging it, and the work is O(size) whatever the client
+ * count.
+ *
+ * Any `vote-threshold` members of a committee still recover the group
+ * signature, so a committee only needs to be at least that large.
+ */
+struct committee {
+    /**
+     * @brief Committee of a block, sorted by client id. Everyone if
+     * `size` is zero or not below `client_count`.
+     *
+     */
+    static std::vector<uint64_t> members(
+        uint64_t block_id,
+        uint64_t seed,
+        uint64_t client_count,
+        uint64_t size);
+
+    static bool contains(
+        uint64_t block_id,
+        uint64_t seed,
+        uint64_t client_count,
+        uint64_t size,
+        uint64_t client_id);
+};
+
+/**
+ * @brief Sorted committees of recent blocks, so that checking the
+ * voters of a block samples its committee once rather than per vote.
+ *
+ * Direct-mapped: a block id hashes to one of `slots` slots and evicts
+ * the committee cached there.
+ */
+class committee_cache {
+public:
+    committee_cache(uint64_t seed, uint64_t client_count, uint64_t size, size_t slots = 4096);
+
+    /**
+     * @brief Same as committee::members().
+     *
+     */
+    std::shared_ptr<const std::vector<uint64_t>> members(uint64_t block_id);
+
+    /**
+     * @brief Same as committee::contains().
+     *
+     */
+    bool contains(uint64_t block_id, uint64_t client_id);
+
+private:
+    struct slot {
+        std::mutex mu;
+        uint64_t block_id = 0;
+        std::shared_ptr<const std::vector<uint64_t>> members;
+    };
+
+    const uint64_t seed_;
+    const uint64_t client_count_;
+    const uint64_t size_;
+    const size_t slot_count_;
+    std::unique_ptr<slot[]> slots_;
+};
+
+}
+
+#endif /* TC_COMMITTEE */
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef TC_FLATBUFFERS_ADAPTER
+#define TC_FLATBUFFERS_ADAPTER
+
+#include <flatbuffers/flatbuffers.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "libBLS/libBLS.h"
+#include "libBLS/bls/BLSSigShare.h"
+#include <easy/profiler.h>
+
+#include "consensus_generated.h"
+#include "block.hpp"
+#include "tx_codec.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Schema-based codec backed by fb_schema/consensus.fbs.
+ *
+ * Unlike flexbuffers_adapter, the encoded bytes can be read in place
+ * through the generated accessors (see BlockView).
+ */
+template<typename T>
+struct flatbuffers_adapter {
+    static std::shared_ptr<T> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes);
+    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const T& obj);
+};
+
+template<>
+struct flatbuffers_adapter<BLSSigShare> {
+    /**
+     * @return nullptr if the point or hint is missing or malformed.
+     */
+    static std::shared_ptr<BLSSigShare> from_fb(const fb::BLSSigShare* sig_share);
+    static flatbuffers::Offset<fb::BLSSigShare> build(flatbuffers::FlatBufferBuilder& fbb, const BLSSigShare& sig_share);
+};
+
+template<>
+struct flatbuffers_adapter<BLSSignature> {
+    /**
+     * @brief Throws like the BLSSignature constructor on a malformed
+     * point or hint.
+     */
+    static std::shared_ptr<BLSSignature> from_fb(const fb::BLSSignature* sig);
+    static flatbuffers::Offset<fb::BLSSignature> build(flatbuffers::FlatBufferBuilder& fbb, const BLSSignature& sig);
+};
+
+template<>
+struct flatbuffers_adapter<BlockVote> {
+    /**
+     * @return nullptr if the share is malformed or its signer index is
+     * not the voter id.
+     */
+    static std::shared_ptr<BlockVote> from_fb(const fb::BlockVote* vote);
+    static flatbuffers::Offset<fb::BlockVote> build(flatbuffers::FlatBufferBuilder& fbb, const BlockVote& vote);
+};
+
+template<>
+struct flatbuffers_adapter<BlockHeader> {
+    static std::shared_ptr<BlockHeader> from_fb(const fb::BlockHeader* bh);
+    static flatbuffers::Offset<fb::BlockHeader> build(flatbuffers::FlatBufferBuilder& fbb, const BlockHeader& bh);
+};
+
+template<>
+struct flatbuffers_adapter<Block> {
+    /**
+     * @brief Verifies and decodes a block.
+     *
+     * @return nullptr if the bytes are not a well-formed block.
+     */
+    static std::shared_ptr<Block> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes);
+    static std::shared_ptr<Block> from_bytes(std::string_view bytes);
+    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const Block& block);
+    /**
+     * @brief Encodes with the calling thread's builder straight into `out`
+     * (e.g. the string returned by a protobuf add_xxx()).
+     */
+    static void to_bytes(const Block& block, std::string& out);
+    /**
+     * @brief Encoded block shared by all sends, encoded at most once
+     * until the block invalidates it (see Block::invalidate_payload()).
+     */
+    static std::shared_ptr<const std::string> payload(const Block& block);
+    static flatbuffers::Offset<fb::Block> build(flatbuffers::FlatBufferBuilder& fbb, const Block& block);
+    /**
+     * @brief Selects how build() writes transactions. Readers accept
+     * either layout.
+     */
+    static void set_tx_layout(tx_codec::layout layout);
+    static tx_codec::layout tx_layout();
+};
+
+}
+
+#endif /* TC_FLATBUFFERS_ADAPTER */
@@ -4,6 +4,9 @@
 
 #include <flatbuffers/flexbuffers.h>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "libBLS/libBLS.h"
 #include "libBLS/bls/BLSSigShare.h"
@@ -13,46 +16,98 @@
 
 namespace tomchain {
 
+/**
+ * @brief Builder reused by every to_bytes() call on the current thread. 
+ * 
+ * Cleared before each use; its buffer keeps the capacity of the largest 
+ * object encoded so far. 
+ */
+flexbuffers::Builder& flexbuffers_thread_builder(); 
+
+/**
+ * @brief Byte-level entry points shared by all flexbuffers_adapter specializations. 
+ * 
+ * Decoding reads in place from the caller's buffer (e.g. a protobuf bytes 
+ * field as string_view); encoding writes into a caller-provided string. 
+ * Each specialization only supplies from_ref() and write(), which handle 
+ * nested objects as nested maps instead of separately encoded blobs. 
+ */
+template<typename Adapter, typename T> 
+struct flexbuffers_codec {
+    static std::shared_ptr<T> from_bytes(std::span<const uint8_t> bytes) 
+    {
+        return Adapter::from_ref(flexbuffers::GetRoot(bytes.data(), bytes.size())); 
+    }
+
+    static std::shared_ptr<T> from_bytes(std::string_view bytes) 
+    {
+        return from_bytes(std::span<const uint8_t>(
+            (const uint8_t*)(bytes.data()), bytes.size())); 
+    }
+
+    static std::shared_ptr<T> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes) 
+    {
+        return from_bytes(std::span<const uint8_t>(*bytes)); 
+    }
+
+    static void to_bytes(const T& obj, std::string& out) 
+    {
+        flexbuffers::Builder& fbb = flexbuffers_thread_builder(); 
+        Adapter::write(fbb, obj); 
+        fbb.Finish(); 
+        const std::vector<uint8_t>& buf = fbb.GetBuffer(); 
+        out.assign((const char*)(buf.data()), buf.size()); 
+    }
+
+    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const T& obj) 
+    {
+        flexbuffers::Builder& fbb = flexbuffers_thread_builder(); 
+        Adapter::write(fbb, obj); 
+        fbb.Finish(); 
+        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer()); 
+    }
+};
+
 template<typename T> 
-struct flexbuffers_adapter {
-    static std::shared_ptr<T> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const T& sig_share); 
+struct flexbuffers_adapter : flexbuffers_codec<flexbuffers_adapter<T>, T> {
+    static std::shared_ptr<T> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const T& obj); 
 };
 
 template<> 
-struct flexbuffers_adapter<BLSSigShare> {
-    static std::shared_ptr<BLSSigShare> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const BLSSigShare& sig_share); 
+struct flexbuffers_adapter<BLSSigShare> : flexbuffers_codec<flexbuffers_adapter<BLSSigShare>, BLSSigShare> {
+    static std::shared_ptr<BLSSigShare> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const BLSSigShare& sig_share); 
 };
 
 template<> 
-struct flexbuffers_adapter<BlockVote> {
-    static std::shared_ptr<BlockVote> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const BlockVote& vote); 
+struct flexbuffers_adapter<BlockVote> : flexbuffers_codec<flexbuffers_adapter<BlockVote>, BlockVote> {
+    static std::shared_ptr<BlockVote> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const BlockVote& vote); 
 };
 
 template<> 
-struct flexbuffers_adapter<BLSSignature> {
-    static std::shared_ptr<BLSSignature> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const BLSSignature& vote); 
+struct flexbuffers_adapter<BLSSignature> : flexbuffers_codec<flexbuffers_adapter<BLSSignature>, BLSSignature> {
+    static std::shared_ptr<BLSSignature> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const BLSSignature& sig); 
 };
 
 template<> 
-struct flexbuffers_adapter<BlockHeader> {
-    static std::shared_ptr<BlockHeader> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const BlockHeader& vote); 
+struct flexbuffers_adapter<BlockHeader> : flexbuffers_codec<flexbuffers_adapter<BlockHeader>, BlockHeader> {
+    static std::shared_ptr<BlockHeader> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const BlockHeader& bh); 
 };
 
 template<> 
-struct flexbuffers_adapter<Transaction> {
-    static std::shared_ptr<Transaction> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const Transaction& vote); 
+struct flexbuffers_adapter<Transaction> : flexbuffers_codec<flexbuffers_adapter<Transaction>, Transaction> {
+    static std::shared_ptr<Transaction> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const Transaction& tx); 
 };
 
 template<> 
-struct flexbuffers_adapter<Block> {
-    static std::shared_ptr<Block> from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes); 
-    static std::shared_ptr<std::vector<uint8_t>> to_bytes(const Block& vote); 
+struct flexbuffers_adapter<Block> : flexbuffers_codec<flexbuffers_adapter<Block>, Block> {
+    static std::shared_ptr<Block> from_ref(flexbuffers::Reference ref); 
+    static void write(flexbuffers::Builder& fbb, const Block& block); 
 };
 
 }
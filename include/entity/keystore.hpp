@@ -0,0 +1,99 @@
+#pragma once
+#ifndef TC_KEYSTORE
+#define TC_KEYSTORE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "libBLS/libBLS.h"
+
+namespace tomchain {
+
+/**
+ * @brief Threshold key material of the client committee, generated in
+ * parallel and kept in a binary file across server restarts.
+ *
+ * generate() draws a polynomial f of degree t - 1 and hands signer i
+ * the share f(i) and its public key f(i) * G2, like
+ * DKGBLSWrapper::createDKGSecretShares() but with the evaluations and
+ * the G2 multiplications spread over TBB workers. Servers agree on the
+ * keys by deriving f from the same "keystore-seed", whatever file they
+ * load or which of them writes it first.
+ *
+ * The file is a fixed header (magic, t, n, group public key), n records
+ * of one Fr and one affine G2 point as raw little-endian limbs, and a
+ * SHA-256 of everything before it. load() maps the file and only
+ * converts limbs back into field elements, so it costs microseconds per
+ * signer instead of a scalar multiplication.
+ */
+struct keystore {
+    struct share {
+        libff::alt_bn128_Fr skey;
+        libff::alt_bn128_G2 pkey;
+    };
+
+    struct keys {
+        size_t threshold;
+        // f(0) * G2
+        libff::alt_bn128_G2 group_pkey;
+        // share i - 1 belongs to signer i
+        std::vector<share> shares;
+    };
+
+    /**
+     * @brief Keys of a random polynomial.
+     *
+     */
+    static keys generate(size_t t, size_t n);
+
+    /**
+     * @brief Keys of the polynomial whose coefficients are derived from
+     * `seed`: every caller with the same (t, n, seed) gets the same keys.
+     *
+     */
+    static keys generate(size_t t, size_t n, uint64_t seed);
+
+    /**
+     * @brief Whether `ks` are the keys of generate(t, n, seed), judged by
+     * the group public key.
+     *
+     */
+    static bool matches_seed(const keys& ks, uint64_t seed);
+
+    /**
+     * @brief Write to a uniquely named temporary file and rename it over
+     * `path`.
+     *
+     * The file holds every secret share: it is created exclusively and
+     * readable by the owner only, and synced before the rename. A
+     * missing parent directory is created with mode 0700.
+     *
+     * @return false on I/O errors.
+     */
+    static bool save(const std::string& path, const keys& ks);
+
+    /**
+     * @brief Read keys written by save().
+     *
+     * @return false if the file is missing, corrupt, or holds a
+     * different (t, n).
+     */
+    static bool load(const std::string& path, size_t t, size_t n, keys& ks);
+
+    /**
+     * @brief Load `path`, or generate(t, n, seed) and save the keys if
+     * the file is missing or was derived from another seed. After a
+     * save the keys are read back, so that a server losing a concurrent
+     * save holds what is on disk.
+     *
+     */
+    static keys load_or_generate(const std::string& path, size_t t, size_t n, uint64_t seed);
+
+private:
+    static keys generate(const std::vector<libff::alt_bn128_Fr>& coeffs, size_t n);
+};
+
+}
+
+#endif /* TC_KEYSTORE */
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef TC_LAGRANGE
+#define TC_LAGRANGE
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "libBLS/libBLS.h"
+
+namespace tomchain {
+
+/**
+ * @brief Lagrange coefficients at x = 0 for the full signer set
+ * {1, ..., n}.
+ *
+ * lambda_i = prod_{j != i} j / (j - i) = n! / (i * (-1)^(i-1) * (i-1)! * (n-i)!)
+ *
+ * so all n coefficients cost O(n) multiplications and a single field
+ * inversion (batch_invert). With n-of-n signing the server's signer set
+ * is fixed at startup, so the coefficients are computed once and cached.
+ * A t-of-n quorum is only known once the block has its votes; its
+ * coefficients come from the subset overload.
+ */
+struct lagrange {
+    /**
+     * @brief Coefficients for signers 1..n; entry i - 1 belongs to signer i.
+     *
+     */
+    static std::vector<libff::alt_bn128_Fr> coefficients(size_t n);
+
+    /**
+     * @brief Coefficients for an arbitrary set of distinct signer indices,
+     * same order. O(t^2) multiplications and one inversion.
+     */
+    static std::vector<libff::alt_bn128_Fr> coefficients(const std::vector<uint64_t>& indices);
+
+    /**
+     * @brief Invert every element in place with one field inversion
+     * (Montgomery's trick). Elements must be non-zero.
+     */
+    static void batch_invert(std::vector<libff::alt_bn128_Fr>& values);
+
+    /**
+     * @brief Compute and cache the coefficients for n signers.
+     *
+     */
+    static void init_cache(size_t n);
+
+    /**
+     * @brief Cached coefficients, or nullptr before init_cache(). Check
+     * size() against the signer count before use.
+     */
+    static std::shared_ptr<const std::vector<libff::alt_bn128_Fr>> cached();
+};
+
+}
+
+#endif /* TC_LAGRANGE */
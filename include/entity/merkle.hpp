@@ -0,0 +1,88 @@
+#pragma once
+#ifndef TC_MERKLE
+#define TC_MERKLE
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "sha256.hpp"
+#include "transaction.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Binary Merkle tree over the transactions of a block, or over
+ * the digests of a batch of blocks.
+ *
+ * leaf = H(0x00 || tx or digest), node = H(0x01 || left || right). A node without
+ * a right sibling moves up a level unchanged. The root of an empty list
+ * is H("").
+ *
+ * Transactions are hashed as laid out in memory (little-endian
+ * fields). Each level is hashed with sha256::hash_many() in parallel
+ * chunks.
+ */
+struct merkle {
+    using digest = sha256::digest;
+
+    /**
+     * @brief All levels of the tree, leaves first. Kept by the proposer
+     * to answer proof requests without rehashing.
+     */
+    class tree {
+    public:
+        explicit tree(const std::vector<Transaction>& txs);
+        explicit tree(const std::vector<digest>& leaves);
+
+        const digest& root() const;
+        size_t leaf_count() const;
+
+        /**
+         * @brief Sibling hashes needed to recompute the root from the
+         * leaves in [begin, end), lowest level first.
+         *
+         * @return Empty if the range is empty or out of bounds.
+         */
+        std::vector<digest> prove(size_t begin, size_t end) const;
+
+    private:
+        template <typename LeafT>
+        void build(const LeafT* leaves, size_t count);
+
+        size_t leaf_count_;
+        std::vector<std::vector<digest>> levels_;
+    };
+
+    static digest root(const std::vector<Transaction>& txs);
+
+    /**
+     * @brief Check that `count` transactions starting at leaf `begin`
+     * belong to a tree of `leaf_count` leaves with root `root`.
+     *
+     * @param proof Output of tree::prove(begin, begin + count).
+     */
+    static bool verify(
+        const digest& root,
+        size_t leaf_count,
+        size_t begin,
+        const Transaction* txs,
+        size_t count,
+        const std::vector<digest>& proof);
+
+    /**
+     * @brief verify() for a tree over digests.
+     *
+     */
+    static bool verify(
+        const digest& root,
+        size_t leaf_count,
+        size_t begin,
+        const digest* leaves,
+        size_t count,
+        const std::vector<digest>& proof);
+};
+
+}
+
+#endif /* TC_MERKLE */
@@ -269,7 +269,7 @@ struct as<tomchain::Block> {
 
         block.header_ = m["header"].as<tomchain::BlockHeader>();
         block.tx_vec_ = m["tx_vec"].as<
-            std::vector<std::shared_ptr<tomchain::Transaction>>
+            std::vector<tomchain::Transaction>
         >();
         block.votes_ = m["votes"].as<
             std::map<uint64_t, std::shared_ptr<tomchain::BlockVote>>
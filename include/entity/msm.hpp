@@ -0,0 +1,48 @@
+#pragma once
+#ifndef TC_MSM
+#define TC_MSM
+
+#include <cstddef>
+#include <vector>
+#include "libBLS/libBLS.h"
+
+namespace tomchain {
+
+/**
+ * @brief Multi-scalar multiplication sum_i scalars[i] * points[i] on
+ * alt_bn128 G1, Pippenger's bucket method.
+ *
+ * Scalars are cut into windows of c bits. In each window every point is
+ * added once into the bucket selected by its c-bit digit, and the
+ * buckets are combined with a running sum, so a window costs about
+ * n + 2^(c+1) additions instead of one scalar multiplication per point.
+ * Windows are independent and run in parallel on TBB; the window sums
+ * are joined with c doublings each. c is chosen per call to minimize
+ * (n + 2^(c+1)) / c.
+ *
+ * Points are normalized to affine with one batch inversion first, so
+ * bucket accumulation uses mixed additions.
+ */
+struct msm {
+    static libff::alt_bn128_G1 multi_exp(
+        const std::vector<libff::alt_bn128_G1>& points,
+        const std::vector<libff::alt_bn128_Fr>& scalars);
+
+    /**
+     * @brief One scalar multiplication per point, as a reference.
+     *
+     */
+    static libff::alt_bn128_G1 naive(
+        const std::vector<libff::alt_bn128_G1>& points,
+        const std::vector<libff::alt_bn128_Fr>& scalars);
+
+    /**
+     * @brief Window width used by multi_exp() for n points.
+     *
+     */
+    static size_t window_bits(size_t n);
+};
+
+}
+
+#endif /* TC_MSM */
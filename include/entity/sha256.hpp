@@ -0,0 +1,74 @@
+#pragma once
+#ifndef TC_SHA256
+#define TC_SHA256
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "picosha2.h"
+
+namespace tomchain {
+
+/**
+ * @brief SHA-256 with runtime-selected backends.
+ *
+ * shani: x86 SHA extensions, used for single messages when available.
+ * avx2: eight equal-length messages hashed side by side, one per 32-bit
+ * lane; preferred by hash_many().
+ * portable: picosha2.
+ */
+struct sha256 {
+    static constexpr size_t digest_size = 32;
+    using digest = std::array<uint8_t, digest_size>;
+
+    enum class backend {
+        portable,
+        shani,
+        avx2
+    };
+
+    static bool supported(backend b);
+
+    /**
+     * @brief Fastest backend supported by this CPU for a single message.
+     *
+     */
+    static backend best_backend();
+
+    /**
+     * @brief Incremental hashing, for digests over several buffers.
+     *
+     */
+    class context {
+    public:
+        explicit context(backend b = best_backend());
+
+        void update(const uint8_t* data, size_t size);
+        digest finish();
+
+    private:
+        backend backend_;
+        uint32_t state_[8];
+        uint8_t buf_[64];
+        size_t buf_len_;
+        uint64_t total_len_;
+        picosha2::hash256_one_by_one portable_;
+    };
+
+    static digest hash(const uint8_t* data, size_t size);
+    static digest hash(const uint8_t* data, size_t size, backend b);
+
+    /**
+     * @brief Hash `count` messages of `size` bytes each, stored back to
+     * back starting at `data`.
+     *
+     * @param out Receives `count` digests.
+     */
+    static void hash_many(const uint8_t* data, size_t size, size_t count, digest* out);
+    static void hash_many(const uint8_t* data, size_t size, size_t count, digest* out, backend b);
+};
+
+}
+
+#endif /* TC_SHA256 */
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef TC_SHARE_VERIFIER
+#define TC_SHARE_VERIFIER
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "libBLS/libBLS.h"
+#include "libBLS/bls/BLSSigShare.h"
+
+namespace tomchain {
+
+/**
+ * @brief Batch verification of BLS signature shares over one message.
+ *
+ * A share s_i of voter i is valid if e(s_i, g2) = e(H(m), pk_i). With
+ * random 128-bit scalars r_i, all shares are checked at once by
+ *
+ *   e(sum r_i * s_i, g2) * e(-H(m), sum r_i * pk_i) = 1
+ *
+ * which is one double Miller loop and one final exponentiation instead
+ * of two pairings per share. A forged share passes only if it cancels
+ * against the unknown r_i, with probability about 2^-128. When the batch
+ * fails, it is split in halves until the bad shares are isolated.
+ */
+struct share_verifier {
+    /**
+     * @brief One share and the public key share of its signer.
+     *
+     */
+    struct item {
+        uint64_t voter_id;
+        libff::alt_bn128_G1 sig;
+        libff::alt_bn128_G2 pkey;
+    };
+
+    /**
+     * @brief Find the invalid shares among `items`, all over `hash`.
+     *
+     * @param checks If set, incremented by the number of batch checks run.
+     * @return Voter ids of the invalid shares; empty if all are valid.
+     */
+    static std::vector<uint64_t> find_invalid(
+        const std::array<uint8_t, 32>& hash,
+        const std::vector<item>& items,
+        size_t* checks = nullptr);
+
+    /**
+     * @brief One randomized check over items [0, count).
+     *
+     * @param hash_point The message hashed to G1.
+     */
+    static bool batch_check(
+        const libff::alt_bn128_G1& hash_point,
+        const item* items,
+        size_t count);
+};
+
+}
+
+#endif /* TC_SHARE_VERIFIER */
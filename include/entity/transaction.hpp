@@ -1,29 +1,40 @@
 #ifndef TC_TRNASACTION_HDR
 #define TC_TRNASACTION_HDR
 
+#include <cstdint>
 #include <istream>
 #include <ostream>
+#include <type_traits>
 
 #include "msgpack.hpp"
 #include <evmc/evmc.hpp>
 
+#include "sha256.hpp"
+
 namespace tomchain {
 
 /**
  * @brief Define the data structure of Transaction in TomChain. 
  * 
+ * Trivially copyable so that blocks store transactions inline and 
+ * codecs can copy them as plain memory. 
  */
 class Transaction {
 public: 
-    Transaction(); 
+    Transaction() = default; 
     Transaction(
         uint64_t id, 
         uint64_t sender, 
         uint64_t receiver, 
         uint64_t value, 
         uint64_t fee);
-    Transaction(const Transaction& tx); 
-    virtual ~Transaction();
+
+    /**
+     * @brief Digest the sender signs: SHA-256 over a domain tag and the 
+     * fields as laid out in memory. 
+     * 
+     */
+    sha256::digest signing_digest() const; 
 
 public: 
     /**
@@ -65,6 +76,10 @@ public:
     ); 
 };
 
+static_assert(std::is_trivially_copyable_v<Transaction>); 
+static_assert(std::is_standard_layout_v<Transaction>); 
+static_assert(sizeof(Transaction) == 5 * sizeof(uint64_t)); 
+
 }
 
 #endif /* TC_TRNASACTION_HDR */
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef TC_TX_CODEC
+#define TC_TX_CODEC
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "transaction.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Columnar encoding of the transactions of a block.
+ *
+ * Layout (little-endian): a version byte and the transaction count
+ * (u32), then one column per field in the order id, sender, receiver,
+ * value, fee. Each column is a mode byte, a byte width and a u64 base,
+ * followed by `count * width` bytes:
+ *
+ * frame: value = base + stored.
+ * delta: value[i] = value[i - 1] + stored[i], value[0] = base; only
+ * picked for non-decreasing columns such as ids.
+ *
+ * Widths are whole bytes so the decoder can widen them with plain
+ * zero-extending loads.
+ */
+struct tx_codec {
+    /**
+     * @brief How FlatBuffers blocks carry transactions; parsed from the
+     * "tx-encoding" config value.
+     *
+     * rows: `txs`, a vector of fb::Transaction structs.
+     * columns: `tx_columns`, bytes in the layout above.
+     */
+    enum class layout {
+        rows,
+        columns
+    };
+
+    static constexpr uint8_t version = 1;
+    static constexpr size_t column_count = 5;
+    // most transactions one encoding holds; bounds what decode() allocates
+    // for a count read off the wire, since columns may have zero width
+    static constexpr size_t max_count = size_t{1} << 20;
+
+    /**
+     * @brief Decoded transactions as one contiguous array per field.
+     *
+     */
+    struct columns {
+        std::vector<uint64_t> id;
+        std::vector<uint64_t> sender;
+        std::vector<uint64_t> receiver;
+        std::vector<uint64_t> value;
+        std::vector<uint64_t> fee;
+
+        size_t size() const { return id.size(); }
+    };
+
+    static layout parse_layout(const std::string& name);
+
+    /**
+     * @brief Encode transactions, replacing the contents of `out`.
+     *
+     * @param txs At most max_count transactions.
+     */
+    static void encode(
+        const std::vector<Transaction>& txs,
+        std::string& out);
+
+    /**
+     * @brief Transaction count stored in an encoding.
+     *
+     * @return size_t Zero if `size` is too short to hold a header.
+     */
+    static size_t count(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Decode all columns in one pass over the input.
+     *
+     * @param use_simd Allow the AVX2 path when the CPU supports it.
+     * @return false if the bytes are truncated or malformed, or hold more
+     * than max_count transactions.
+     */
+    static bool decode(
+        const uint8_t* data,
+        size_t size,
+        columns& out,
+        bool use_simd = true);
+
+    /**
+     * @brief Whether decode() can take the AVX2 path on this CPU.
+     *
+     */
+    static bool simd_supported();
+};
+
+}
+
+#endif /* TC_TX_CODEC */
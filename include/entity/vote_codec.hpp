@@ -0,0 +1,107 @@
+#pragma once
+#ifndef TC_VOTE_CODEC
+#define TC_VOTE_CODEC
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "libBLS/libBLS.h"
+#include "libBLS/bls/BLSSigShare.h"
+
+#include "block.hpp"
+
+namespace tomchain {
+
+/**
+ * @brief Wire format of a single vote: block id, voter id and the 
+ * signature share, without the block it votes for. 
+ * 
+ * The signer index equals the voter id, and t/n are known to both sides 
+ * from the configuration, so neither is sent. 
+ */
+struct vote_codec {
+    /**
+     * @brief Encoding of the signature share point. Values match the 
+     * ShareEncoding enum in grpc_proto/tc-server.proto. 
+     * 
+     * raw: the in-memory Jacobian point (96 bytes). 
+     * compressed: one flag byte (bit 0: parity of y, bit 1: infinity) 
+     * followed by the affine x coordinate, 32 bytes big-endian. 
+     */
+    enum class encoding : uint32_t {
+        raw = 0, 
+        compressed = 1
+    }; 
+
+    static constexpr size_t raw_share_size = 96; 
+    static constexpr size_t compressed_share_size = 33; 
+
+    /**
+     * @brief Fields of one vote as read from a request. The views point 
+     * into the request and must outlive decode_batch(). 
+     */
+    struct entry {
+        uint64_t block_id; 
+        uint64_t voter_id; 
+        std::string_view sig_share; 
+        std::string_view hint; 
+        // batch votes only, see BlockVote::batch_size_ 
+        uint64_t batch_size; 
+        std::string_view batch_root; 
+    }; 
+
+    /**
+     * @brief Parse the "vote-encoding"/"relay-vote-encoding" config value. 
+     * 
+     */
+    static encoding parse_encoding(const std::string& name); 
+
+    /**
+     * @brief Encode the signature shares of a batch of votes. Compression 
+     * normalizes the whole batch with a single field inversion. 
+     * 
+     * @return std::vector<std::string> One share per vote, same order. 
+     */
+    static std::vector<std::string> encode_sig_shares(
+        const std::vector<std::shared_ptr<BlockVote>>& votes, 
+        encoding enc); 
+
+    /**
+     * @brief Rebuild a batch of votes; compressed points are recovered in 
+     * parallel. 
+     * 
+     * @param batch_blocks Blocks per batch vote ("vote-batch-blocks"), 0 
+     * if batch votes are not accepted. 
+     * @param server_count Servers proposing, for Block::batch_first_id(). 
+     * @return std::vector<std::shared_ptr<BlockVote>> One vote per entry, 
+     * nullptr where the share is malformed or not on the curve, or where 
+     * a batch vote does not cover a whole batch as configured. 
+     */
+    static std::vector<std::shared_ptr<BlockVote>> decode_batch(
+        const std::vector<entry>& entries, 
+        encoding enc, 
+        size_t required_signers, 
+        size_t total_signers, 
+        uint64_t batch_blocks = 0, 
+        uint64_t server_count = 1); 
+
+    /**
+     * @brief Compress points, converting them to affine in place. 
+     * 
+     */
+    static void compress_points(
+        std::vector<libff::alt_bn128_G1>& points, 
+        std::vector<std::string>& out); 
+
+    /**
+     * @brief Recover a point from its compressed form. 
+     * 
+     * @return true if `bytes` encodes a point on the curve. 
+     */
+    static bool decompress_point(std::string_view bytes, libff::alt_bn128_G1& point); 
+};
+
+}
+
+#endif /* TC_VOTE_CODEC */
@@ -0,0 +1,308 @@
+#pragma once
+#ifndef TC_ANNOUNCE_LOG
+#define TC_ANNOUNCE_LOG
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+#include "block.hpp"
+
+namespace tomchain
+{
+
+    /**
+     * @brief Append-only log of pending blocks that clients may pull,
+     * numbered by sequence from zero.
+     *
+     * Each client keeps a cursor into the log and reads the entries
+     * between its cursor and tail() without any lock; append() only
+     * serializes against other appends. Entries are never rewritten, a
+     * reader skips the blocks whose finalized_ flag is set.
+     *
+     * The log is a list of fixed-size segments. trim() unlinks leading
+     * segments whose blocks are all finalized, or that filled up more
+     * than the expiry ago, so that a block stuck in the pending pool does
+     * not pin the log behind it. An unlinked segment is freed once no
+     * reader that might still walk it is inside read(), tracked with one
+     * epoch slot per concurrent reader.
+     */
+    class AnnounceLog
+    {
+    public:
+        static constexpr size_t segment_size = 1024;
+        static constexpr size_t reader_slots = 256;
+
+        /**
+         * @param expire_ms Age after which a full segment is trimmed
+         * whatever its blocks, 0 for never.
+         */
+        explicit AnnounceLog(uint64_t expire_ms = 0)
+            : tail_seq_(0),
+              expire_ms_(expire_ms),
+              global_epoch_(1)
+        {
+            Segment *first = new Segment(0);
+            head_.store(first, std::memory_order_relaxed);
+            tail_seg_ = first;
+            for (auto &slot : slots_)
+            {
+                slot.epoch.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        ~AnnounceLog()
+        {
+            Segment *seg = head_.load(std::memory_order_relaxed);
+            while (seg != nullptr)
+            {
+                Segment *next = seg->next.load(std::memory_order_relaxed);
+                delete seg;
+                seg = next;
+            }
+            for (const Retired &r : retired_)
+            {
+                delete r.seg;
+            }
+        }
+
+        AnnounceLog(const AnnounceLog &) = delete;
+        AnnounceLog &operator=(const AnnounceLog &) = delete;
+
+        /**
+         * @return Sequence number of the entry.
+         */
+        uint64_t append(std::shared_ptr<Block> block)
+        {
+            EASY_FUNCTION("AnnounceLog::append");
+            std::lock_guard<std::mutex> lock(append_mu_);
+            const uint64_t seq = tail_seq_.load(std::memory_order_relaxed);
+            if (seq == tail_seg_->base + segment_size)
+            {
+                tail_seg_->full_ms = now_ms();
+                Segment *seg = new Segment(seq);
+                tail_seg_->next.store(seg, std::memory_order_release);
+                tail_seg_ = seg;
+                this->trim_locked();
+            }
+            tail_seg_->entries[seq - tail_seg_->base] = std::move(block);
+            // publishes the entry to readers
+            tail_seq_.store(seq + 1, std::memory_order_release);
+            return seq;
+        }
+
+        /**
+         * @brief One past the last published entry.
+         *
+         */
+        uint64_t tail() const
+        {
+            return tail_seq_.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Entries not yet trimmed.
+         *
+         */
+        uint64_t size() const
+        {
+            return this->tail() - head_.load(std::memory_order_acquire)->base;
+        }
+
+        /**
+         * @brief Calls fn(seq, block) for the unfinalized entries in
+         * [begin, end), end being at most a tail() read before. Entries
+         * trimmed already are skipped.
+         */
+        void read(uint64_t begin, uint64_t end, const std::function<void(uint64_t, const std::shared_ptr<Block> &)> &fn)
+        {
+            EASY_FUNCTION("AnnounceLog::read");
+            if (begin >= end)
+            {
+                return;
+            }
+
+            ReaderSlot &slot = this->pin();
+            const Segment *seg = head_.load(std::memory_order_seq_cst);
+            uint64_t seq = std::max(begin, seg->base);
+            while (seg != nullptr && seq < end)
+            {
+                const uint64_t seg_end = seg->base + segment_size;
+                if (seq >= seg_end)
+                {
+                    seg = seg->next.load(std::memory_order_acquire);
+                    continue;
+                }
+                const uint64_t stop = std::min(end, seg_end);
+                for (; seq < stop; seq++)
+                {
+                    const std::shared_ptr<Block> &block = seg->entries[seq - seg->base];
+                    if (!block->finalized_.load(std::memory_order_acquire))
+                    {
+                        fn(seq, block);
+                    }
+                }
+            }
+            slot.epoch.store(0, std::memory_order_release);
+        }
+
+        /**
+         * @brief Unlink the leading segments whose blocks are all
+         * finalized or that expired, and free those no reader can still
+         * see.
+         */
+        void trim()
+        {
+            std::lock_guard<std::mutex> lock(append_mu_);
+            this->trim_locked();
+        }
+
+        /**
+         * @brief Set the segment expiry, see AnnounceLog().
+         *
+         */
+        void set_expire_ms(uint64_t expire_ms)
+        {
+            std::lock_guard<std::mutex> lock(append_mu_);
+            expire_ms_ = expire_ms;
+        }
+
+    private:
+        struct Segment
+        {
+            explicit Segment(uint64_t base_seq)
+                : base(base_seq),
+                  entries(segment_size),
+                  next(nullptr)
+            {
+            }
+
+            const uint64_t base;
+            std::vector<std::shared_ptr<Block>> entries;
+            std::atomic<Segment *> next;
+            // when the last entry was appended, appenders only
+            uint64_t full_ms = 0;
+        };
+
+        struct Retired
+        {
+            Segment *seg;
+            uint64_t epoch;
+        };
+
+        // 0 while free, else the epoch its reader entered in
+        struct alignas(64) ReaderSlot
+        {
+            std::atomic<uint64_t> epoch;
+        };
+
+        ReaderSlot &pin()
+        {
+            static thread_local size_t hint =
+                std::hash<std::thread::id>{}(std::this_thread::get_id());
+            while (true)
+            {
+                for (size_t i = 0; i < reader_slots; i++)
+                {
+                    ReaderSlot &slot = slots_[(hint + i) % reader_slots];
+                    uint64_t expected = 0;
+                    if (slot.epoch.load(std::memory_order_relaxed) == 0 &&
+                        slot.epoch.compare_exchange_strong(
+                            expected,
+                            global_epoch_.load(std::memory_order_seq_cst),
+                            std::memory_order_seq_cst))
+                    {
+                        hint = (hint + i) % reader_slots;
+                        return slot;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        static uint64_t now_ms()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        void trim_locked()
+        {
+            EASY_FUNCTION("AnnounceLog::trim");
+            const uint64_t tail = tail_seq_.load(std::memory_order_relaxed);
+            const uint64_t now = now_ms();
+            Segment *head = head_.load(std::memory_order_relaxed);
+            while (head != tail_seg_ && head->base + segment_size <= tail)
+            {
+                // blocks pending that long are dead, see remove_dead_blocks()
+                const bool expired = expire_ms_ > 0 && now - head->full_ms > expire_ms_;
+                const bool all_final = expired || std::all_of(
+                    head->entries.begin(),
+                    head->entries.end(),
+                    [](const std::shared_ptr<Block> &block)
+                    { return block->finalized_.load(std::memory_order_acquire); });
+                if (!all_final)
+                {
+                    break;
+                }
+                Segment *next = head->next.load(std::memory_order_relaxed);
+                head_.store(next, std::memory_order_seq_cst);
+                // readers entering from here on cannot reach `head`
+                retired_.push_back(Retired{head, global_epoch_.fetch_add(1, std::memory_order_seq_cst)});
+                head = next;
+            }
+
+            if (retired_.empty())
+            {
+                return;
+            }
+            uint64_t oldest = UINT64_MAX;
+            for (const auto &slot : slots_)
+            {
+                const uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+                if (epoch != 0)
+                {
+                    oldest = std::min(oldest, epoch);
+                }
+            }
+            auto keep = std::remove_if(
+                retired_.begin(),
+                retired_.end(),
+                [oldest](const Retired &r)
+                {
+                    if (r.epoch < oldest)
+                    {
+                        delete r.seg;
+                        return true;
+                    }
+                    return false;
+                });
+            retired_.erase(keep, retired_.end());
+        }
+
+    private:
+        std::atomic<Segment *> head_;
+        std::atomic<uint64_t> tail_seq_;
+        // appenders only
+        std::mutex append_mu_;
+        Segment *tail_seg_;
+        std::vector<Retired> retired_;
+        uint64_t expire_ms_;
+
+        std::atomic<uint64_t> global_epoch_;
+        std::array<ReaderSlot, reader_slots> slots_;
+    };
+
+}
+
+#endif /* TC_ANNOUNCE_LOG */
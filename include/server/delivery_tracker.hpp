@@ -0,0 +1,121 @@
+#pragma once
+#ifndef TC_DELIVERY_TRACKER
+#define TC_DELIVERY_TRACKER
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace tomchain
+{
+
+    /**
+     * @brief Blocks already handed to one client, in constant memory.
+     *
+     * Block ids are dense per proposer: proposer p numbers its blocks
+     * from p * stride on. For each proposer the tracker keeps a cursor
+     * `base`, below which every block counts as delivered, and a sliding
+     * bitmap of the `window` ids from there. Delivering the block at the
+     * cursor moves the cursor past the delivered run; a block beyond the
+     * window slides it forward, giving up on the ids it leaves behind.
+     * Blocks the client skips (e.g. of other committees) are gaps that
+     * the window slides over.
+     */
+    class DeliveryTracker
+    {
+    public:
+        static constexpr uint64_t window = 4096;
+
+        DeliveryTracker(size_t proposers, uint64_t stride)
+            : stride_(stride),
+              lanes_(proposers)
+        {
+        }
+
+        /**
+         * @brief Record a delivery.
+         *
+         * @return false if `block_id` was delivered before, or is so far
+         * behind the newest delivery of its proposer that it counts as
+         * delivered.
+         */
+        bool mark(uint64_t block_id)
+        {
+            const uint64_t proposer = block_id / stride_;
+            const uint64_t seq = block_id % stride_;
+            if (proposer >= lanes_.size())
+            {
+                // not a proposer we know of, cannot be tracked
+                return true;
+            }
+
+            std::lock_guard<std::mutex> lock(mu_);
+            Lane &lane = lanes_[proposer];
+            if (seq < lane.base)
+            {
+                return false;
+            }
+            if (seq >= lane.base + window)
+            {
+                advance(lane, seq - window + 1);
+            }
+            if (test(lane, seq))
+            {
+                return false;
+            }
+            set(lane, seq, true);
+            // the cursor moves past the delivered run
+            while (test(lane, lane.base))
+            {
+                set(lane, lane.base, false);
+                lane.base++;
+            }
+            return true;
+        }
+
+    private:
+        struct Lane
+        {
+            uint64_t base = 0;
+            std::array<uint64_t, window / 64> bits{};
+        };
+
+        static bool test(const Lane &lane, uint64_t seq)
+        {
+            const uint64_t pos = seq % window;
+            return (lane.bits[pos / 64] >> (pos % 64)) & 1;
+        }
+
+        static void set(Lane &lane, uint64_t seq, bool value)
+        {
+            const uint64_t pos = seq % window;
+            const uint64_t mask = uint64_t{1} << (pos % 64);
+            lane.bits[pos / 64] = value ? (lane.bits[pos / 64] | mask) : (lane.bits[pos / 64] & ~mask);
+        }
+
+        static void advance(Lane &lane, uint64_t new_base)
+        {
+            if (new_base - lane.base >= window)
+            {
+                lane.bits.fill(0);
+            }
+            else
+            {
+                for (uint64_t seq = lane.base; seq < new_base; seq++)
+                {
+                    set(lane, seq, false);
+                }
+            }
+            lane.base = new_base;
+        }
+
+    private:
+        const uint64_t stride_;
+        std::mutex mu_;
+        std::vector<Lane> lanes_;
+    };
+
+}
+
+#endif /* TC_DELIVERY_TRACKER */
@@ -0,0 +1,285 @@
+#pragma once
+#ifndef TC_MEMPOOL
+#define TC_MEMPOOL
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+#include "oneapi/tbb/concurrent_queue.h"
+#include "key.h"
+
+#include "transaction.hpp"
+
+namespace tomchain
+{
+
+    /**
+     * @brief Transactions and the ECDSA signatures of their senders, kept
+     * column-wise so that the transactions that verify can move on as one
+     * vector.
+     *
+     */
+    struct SignedTxBatch
+    {
+        std::vector<Transaction> txs;
+        // sigs[i] signs txs[i].signing_digest()
+        std::vector<std::vector<uint8_t>> sigs;
+    };
+
+    /**
+     * @brief Pending transactions of the proposer, behind a signature
+     * verification stage.
+     *
+     * submit() queues signed batches; `threads` verifier threads take one
+     * batch each, drop the transactions whose signature does not hold
+     * under the key of their sender, and hand the rest to packing. A
+     * sender account maps to signer key sender % keys.size().
+     *
+     * Verified transactions stay in the vector they were submitted in:
+     * take() moves the first vector into a block whole and appends the
+     * rest, so with batches of a block each ("tx-verify-batch" equal to
+     * "tx-per-block") a block is packed without copying.
+     */
+    class Mempool
+    {
+    public:
+        /**
+         * @brief Verification counters since the last take_stats().
+         *
+         */
+        struct Stats
+        {
+            size_t queued_batches;
+            size_t ready;
+            uint64_t verified;
+            uint64_t rejected;
+            double verify_per_sec;
+        };
+
+        Mempool(std::vector<ecdsa::PubKey> keys, size_t threads, size_t queue_limit)
+            : keys_(std::move(keys)),
+              threads_(std::max<size_t>(1, threads)),
+              ready_count_(0),
+              front_offset_(0),
+              verified_(0),
+              rejected_(0),
+              stats_since_(std::chrono::steady_clock::now())
+        {
+            input_.set_capacity(std::max<size_t>(1, queue_limit));
+            spdlog::info("Mempool: {} verifier threads, {} signer keys", threads_, keys_.size());
+        }
+
+        ~Mempool()
+        {
+            this->stop();
+        }
+
+        void start()
+        {
+            for (size_t i = 0; i < threads_; i++)
+            {
+                workers_.emplace_back([this]()
+                                      { this->verify_loop(); });
+            }
+        }
+
+        /**
+         * @brief Verify what is queued and join the verifiers.
+         *
+         */
+        void stop()
+        {
+            if (workers_.empty())
+            {
+                return;
+            }
+            // an empty batch tells one verifier to leave
+            for (size_t i = 0; i < workers_.size(); i++)
+            {
+                input_.push(std::make_shared<SignedTxBatch>());
+            }
+            for (std::thread &worker : workers_)
+            {
+                worker.join();
+            }
+            workers_.clear();
+        }
+
+        /**
+         * @brief Queue a batch for verification. Waits while
+         * `queue_limit` batches are queued.
+         */
+        void submit(SignedTxBatch &&batch)
+        {
+            if (batch.txs.empty())
+            {
+                return;
+            }
+            input_.push(std::make_shared<SignedTxBatch>(std::move(batch)));
+        }
+
+        /**
+         * @brief Verified transactions ready for packing.
+         *
+         */
+        size_t size() const
+        {
+            return ready_count_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Move `count` verified transactions, oldest first, to the
+         * end of `out`.
+         *
+         * @return false, leaving `out` alone, if fewer are ready.
+         */
+        bool take(size_t count, std::vector<Transaction> &out)
+        {
+            EASY_FUNCTION("Mempool::take");
+            std::lock_guard<std::mutex> lock(ready_mu_);
+            if (ready_count_.load(std::memory_order_relaxed) < count)
+            {
+                return false;
+            }
+
+            size_t needed = count;
+            while (needed > 0)
+            {
+                std::vector<Transaction> &front = ready_.front();
+                const size_t available = front.size() - front_offset_;
+                if (out.empty() && front_offset_ == 0 && available <= needed)
+                {
+                    // the verified vector becomes the block body, later
+                    // ones are appended to it
+                    out = std::move(front);
+                    needed -= available;
+                    if (needed > 0)
+                    {
+                        out.reserve(count);
+                    }
+                }
+                else
+                {
+                    const size_t n = std::min(needed, available);
+                    out.insert(out.end(),
+                               front.begin() + front_offset_,
+                               front.begin() + front_offset_ + n);
+                    front_offset_ += n;
+                    needed -= n;
+                    if (front_offset_ < front.size())
+                    {
+                        continue;
+                    }
+                }
+                ready_.pop_front();
+                front_offset_ = 0;
+            }
+            ready_count_.fetch_sub(count, std::memory_order_relaxed);
+            return true;
+        }
+
+        Stats take_stats()
+        {
+            const auto now = std::chrono::steady_clock::now();
+            const double elapsed_s = std::chrono::duration<double>(now - stats_since_).count();
+            stats_since_ = now;
+
+            Stats stats;
+            stats.queued_batches = (size_t)std::max<std::ptrdiff_t>(0, input_.size());
+            stats.ready = this->size();
+            stats.verified = verified_.exchange(0, std::memory_order_relaxed);
+            stats.rejected = rejected_.exchange(0, std::memory_order_relaxed);
+            stats.verify_per_sec = elapsed_s <= 0
+                                       ? 0
+                                       : (stats.verified + stats.rejected) / elapsed_s;
+            return stats;
+        }
+
+    private:
+        void verify_loop()
+        {
+            while (true)
+            {
+                std::shared_ptr<SignedTxBatch> batch;
+                input_.pop(batch);
+                if (batch->txs.empty())
+                {
+                    return;
+                }
+
+                EASY_BLOCK("verify txs");
+                // compact the valid transactions to the front in place
+                std::vector<Transaction> &txs = batch->txs;
+                size_t kept = 0;
+                for (size_t i = 0; i < txs.size(); i++)
+                {
+                    if (!this->verify(txs[i], batch->sigs[i]))
+                    {
+                        continue;
+                    }
+                    if (kept != i)
+                    {
+                        txs[kept] = txs[i];
+                    }
+                    kept++;
+                }
+                const size_t rejected = txs.size() - kept;
+                txs.resize(kept);
+                EASY_END_BLOCK;
+
+                verified_.fetch_add(kept, std::memory_order_relaxed);
+                rejected_.fetch_add(rejected, std::memory_order_relaxed);
+                if (kept == 0)
+                {
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(ready_mu_);
+                ready_.push_back(std::move(txs));
+                ready_count_.fetch_add(kept, std::memory_order_relaxed);
+            }
+        }
+
+        bool verify(const Transaction &tx, const std::vector<uint8_t> &sig) const
+        {
+            if (keys_.empty())
+            {
+                return false;
+            }
+            const sha256::digest digest = tx.signing_digest();
+            // Verify() takes a vector; reuse one per verifier thread
+            static thread_local std::vector<uint8_t> hash(sha256::digest_size);
+            std::memcpy(hash.data(), digest.data(), sha256::digest_size);
+            return keys_[tx.sender_ % keys_.size()].Verify(hash, sig);
+        }
+
+    private:
+        const std::vector<ecdsa::PubKey> keys_;
+        const size_t threads_;
+        oneapi::tbb::concurrent_bounded_queue<std::shared_ptr<SignedTxBatch>> input_;
+        std::vector<std::thread> workers_;
+
+        // verified vectors in arrival order; take() has consumed
+        // front_offset_ transactions of the first one
+        std::mutex ready_mu_;
+        std::deque<std::vector<Transaction>> ready_;
+        std::atomic<size_t> ready_count_;
+        size_t front_offset_;
+
+        std::atomic<uint64_t> verified_;
+        std::atomic<uint64_t> rejected_;
+        std::chrono::steady_clock::time_point stats_since_;
+    };
+
+}
+
+#endif /* TC_MEMPOOL */
@@ -0,0 +1,269 @@
+#pragma once
+#ifndef TC_MERGE_ENGINE
+#define TC_MERGE_ENGINE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+#include "oneapi/tbb/global_control.h"
+#include "oneapi/tbb/info.h"
+#include "oneapi/tbb/task_arena.h"
+
+#include "block.hpp"
+
+namespace tomchain
+{
+
+    /**
+     * @brief Merges blocks that reached quorum as soon as they are
+     * queued, several at a time.
+     *
+     * The `threads` worker threads are split into `concurrency` TBB
+     * arenas of threads / concurrency each. A dispatcher thread hands
+     * every queued block to a free arena, so up to `concurrency` blocks
+     * merge at once and parallel work inside one merge (MSM windows,
+     * libBLS merge threads) stays within its arena's share.
+     *
+     * push() blocks while `queue_limit` blocks are waiting, which holds
+     * back its caller instead of letting the backlog grow. Code that must
+     * not wait, such as gRPC callbacks, uses try_push() and hands what
+     * does not fit to a thread that may.
+     */
+    class MergeEngine
+    {
+    public:
+        using MergeFn = std::function<void(std::shared_ptr<Block>, size_t)>;
+
+        /**
+         * @brief Merge latency and queue counters since the last
+         * take_stats().
+         *
+         */
+        struct Stats
+        {
+            size_t queue_depth;
+            size_t in_flight;
+            uint64_t merged;
+            // enqueue to merge done
+            double avg_latency_ms;
+            double max_latency_ms;
+            uint64_t stalls;
+        };
+
+        /**
+         * @param merge Called once per block on an arena thread, with the
+         * number of threads it may use.
+         */
+        MergeEngine(size_t threads, size_t concurrency, size_t queue_limit, MergeFn merge)
+            : concurrency_(std::max<size_t>(1, std::min(concurrency, std::max<size_t>(1, threads)))),
+              threads_per_block_(std::max<size_t>(1, threads / concurrency_)),
+              queue_limit_(std::max<size_t>(1, queue_limit)),
+              merge_(std::move(merge)),
+              // TBB caps workers at hardware concurrency - 1 by default,
+              // which would leave arenas of a wide split unfilled
+              parallelism_(oneapi::tbb::global_control::max_allowed_parallelism,
+                           std::max<size_t>(concurrency_ * threads_per_block_ + 1,
+                                            (size_t)oneapi::tbb::info::default_concurrency())),
+              stopped_(false),
+              in_flight_(0),
+              merged_(0),
+              latency_sum_us_(0),
+              latency_max_us_(0),
+              stalls_(0)
+        {
+            for (size_t i = 0; i < concurrency_; i++)
+            {
+                // nobody joins these arenas; all slots go to workers
+                arenas_.push_back(std::make_unique<oneapi::tbb::task_arena>(
+                    (int)threads_per_block_, 0));
+                free_arenas_.push_back(i);
+            }
+            spdlog::info("MergeEngine: {} concurrent merges x {} threads, queue limit {}",
+                         concurrency_, threads_per_block_, queue_limit_);
+        }
+
+        ~MergeEngine()
+        {
+            this->stop();
+        }
+
+        void start()
+        {
+            dispatcher_ = std::thread([this]()
+                                      { this->dispatch(); });
+        }
+
+        /**
+         * @brief Stop dispatching and wait for running merges. Queued
+         * blocks are dropped.
+         */
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                if (stopped_)
+                {
+                    return;
+                }
+                stopped_ = true;
+            }
+            cv_.notify_all();
+            if (dispatcher_.joinable())
+            {
+                dispatcher_.join();
+            }
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [this]()
+                     { return in_flight_ == 0; });
+        }
+
+        /**
+         * @brief Queue a block for merging. Must not be called while
+         * holding a pending-block accessor: it may wait for room.
+         */
+        void push(std::shared_ptr<Block> sp_block)
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            if (queue_.size() >= queue_limit_)
+            {
+                EASY_BLOCK("merge backpressure");
+                stalls_.fetch_add(1, std::memory_order_relaxed);
+                cv_.wait(lock, [this]()
+                         { return stopped_ || queue_.size() < queue_limit_; });
+                EASY_END_BLOCK;
+            }
+            queue_.push_back({std::move(sp_block), std::chrono::steady_clock::now()});
+            lock.unlock();
+            cv_.notify_all();
+        }
+
+        /**
+         * @brief push() without waiting.
+         *
+         * @return false, leaving the block to the caller, if the queue is
+         * full.
+         */
+        bool try_push(const std::shared_ptr<Block> &sp_block)
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            if (queue_.size() >= queue_limit_)
+            {
+                stalls_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            queue_.push_back({sp_block, std::chrono::steady_clock::now()});
+            lock.unlock();
+            cv_.notify_all();
+            return true;
+        }
+
+        Stats take_stats()
+        {
+            Stats stats;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                stats.queue_depth = queue_.size();
+                stats.in_flight = in_flight_;
+            }
+            stats.merged = merged_.exchange(0, std::memory_order_relaxed);
+            const uint64_t sum_us = latency_sum_us_.exchange(0, std::memory_order_relaxed);
+            stats.avg_latency_ms = stats.merged == 0 ? 0 : (double)sum_us / stats.merged / 1000.0;
+            stats.max_latency_ms = latency_max_us_.exchange(0, std::memory_order_relaxed) / 1000.0;
+            stats.stalls = stalls_.exchange(0, std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Block> block;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        void dispatch()
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            while (true)
+            {
+                cv_.wait(lock, [this]()
+                         { return stopped_ || (!queue_.empty() && !free_arenas_.empty()); });
+                if (stopped_)
+                {
+                    return;
+                }
+
+                Entry entry = std::move(queue_.front());
+                queue_.pop_front();
+                const size_t slot = free_arenas_.back();
+                free_arenas_.pop_back();
+                in_flight_++;
+                lock.unlock();
+                // room for a blocked push()
+                cv_.notify_all();
+
+                arenas_[slot]->enqueue([this, slot, entry = std::move(entry)]()
+                                       { this->run(slot, entry); });
+                lock.lock();
+            }
+        }
+
+        void run(size_t slot, const Entry &entry)
+        {
+            EASY_BLOCK("merge block");
+            merge_(entry.block, threads_per_block_);
+            EASY_END_BLOCK;
+
+            const uint64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                            std::chrono::steady_clock::now() - entry.enqueued)
+                                            .count();
+            merged_.fetch_add(1, std::memory_order_relaxed);
+            latency_sum_us_.fetch_add(latency_us, std::memory_order_relaxed);
+            uint64_t prev_max = latency_max_us_.load(std::memory_order_relaxed);
+            while (latency_us > prev_max &&
+                   !latency_max_us_.compare_exchange_weak(prev_max, latency_us, std::memory_order_relaxed))
+            {
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                free_arenas_.push_back(slot);
+                in_flight_--;
+            }
+            cv_.notify_all();
+        }
+
+    private:
+        const size_t concurrency_;
+        const size_t threads_per_block_;
+        const size_t queue_limit_;
+        MergeFn merge_;
+        oneapi::tbb::global_control parallelism_;
+
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<Entry> queue_;
+        std::vector<std::unique_ptr<oneapi::tbb::task_arena>> arenas_;
+        std::vector<size_t> free_arenas_;
+        std::thread dispatcher_;
+        bool stopped_;
+        size_t in_flight_;
+
+        std::atomic<uint64_t> merged_;
+        std::atomic<uint64_t> latency_sum_us_;
+        std::atomic<uint64_t> latency_max_us_;
+        std::atomic<uint64_t> stalls_;
+    };
+
+}
+
+#endif /* TC_MERGE_ENGINE */
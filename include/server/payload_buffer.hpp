@@ -0,0 +1,90 @@
+#pragma once
+#ifndef TC_PAYLOAD_BUFFER
+#define TC_PAYLOAD_BUFFER
+
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/slice.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tomchain
+{
+
+    /**
+     * @brief Assembles a protobuf message as a gRPC ByteBuffer whose
+     * `bytes` fields point at shared payloads instead of copying them.
+     *
+     * Only the tag and length prefixes are written into small owned
+     * slices; each payload slice holds a reference on its string until
+     * gRPC has sent it. Fields must be added in field-number order to
+     * match what the protobuf serializer would produce.
+     */
+    class PayloadBufferBuilder
+    {
+    public:
+        void add_varint_field(uint32_t field_number, uint64_t value)
+        {
+            if (value == 0)
+            {
+                // proto3 omits default scalars
+                return;
+            }
+            std::string prefix;
+            put_varint(prefix, (uint64_t(field_number) << 3) | 0);
+            put_varint(prefix, value);
+            slices_.emplace_back(prefix.data(), prefix.size());
+        }
+
+        void add_bytes_field(uint32_t field_number, std::shared_ptr<const std::string> payload)
+        {
+            std::string prefix;
+            put_varint(prefix, (uint64_t(field_number) << 3) | 2);
+            put_varint(prefix, payload->size());
+            slices_.emplace_back(prefix.data(), prefix.size());
+            if (payload->empty())
+            {
+                return;
+            }
+
+            // the slice owns a reference until gRPC releases it
+            auto holder = new std::shared_ptr<const std::string>(std::move(payload));
+            slices_.emplace_back(
+                (void *)((*holder)->data()),
+                (*holder)->size(),
+                &PayloadBufferBuilder::release_payload,
+                (void *)holder);
+        }
+
+        grpc::ByteBuffer release()
+        {
+            grpc::ByteBuffer buffer(slices_.data(), slices_.size());
+            slices_.clear();
+            return buffer;
+        }
+
+    private:
+        static void put_varint(std::string &out, uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back((char)((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out.push_back((char)value);
+        }
+
+        static void release_payload(void *holder)
+        {
+            delete (std::shared_ptr<const std::string> *)(holder);
+        }
+
+    private:
+        std::vector<grpc::Slice> slices_;
+    };
+
+}
+
+#endif /* TC_PAYLOAD_BUFFER */
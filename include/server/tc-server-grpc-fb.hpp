@@ -2,8 +2,14 @@
 #include "consensus.grpc.fb.h"
 #include "consensus_generated.h"
 
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
 #include "libBLS/libBLS.h"
 
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+
 #include <memory>
 
 namespace tomchain
@@ -11,44 +17,238 @@ namespace tomchain
 
     class TcServer;
 
+    /**
+     * @brief FlatBuffers-over-gRPC counterpart of TcConsensusImpl.
+     *
+     * Messages are built with `flatbuffers::grpc::MessageBuilder`, whose
+     * allocator hands its buffer to gRPC as a slice, so responses are sent
+     * without an extra protobuf wrap.
+     */
     class TcConsensusFbImpl final : public fb::Consensus::Service
     {
 
-    public: 
+    public:
+        /**
+         * @brief Client registers when it connects to server.
+         *
+         * @param context RPC context.
+         * @param request_msg RPC request.
+         * @param response_msg RPC response.
+         * @return grpc::Status RPC status.
+         */
+        virtual grpc::Status Register(
+            grpc::ServerContext *context,
+            const flatbuffers::grpc::Message<fb::RegisterRequest> *request_msg,
+            flatbuffers::grpc::Message<fb::RegisterResponse> *response_msg) override
+        {
+            spdlog::trace("gRPC-fb(Register) starts");
+
+            // We call GetRoot to "parse" the message. Verification is already
+            // performed by default.
+            const fb::RegisterRequest *request = request_msg->GetRoot();
+            const uint32_t client_id = request->id();
+            std::vector<uint8_t> pkey_data_vec(
+                request->pkey()->begin(),
+                request->pkey()->end());
+
+            std::string tss_sk = tc_server_->register_client(client_id, pkey_data_vec);
+
+            flatbuffers::grpc::MessageBuilder mb_;
+            auto tss_sk_offset = mb_.CreateString(tss_sk);
+            mb_.Finish(fb::CreateRegisterResponse(mb_, 0, client_id, tss_sk_offset));
+
+            // The `ReleaseMessage<T>()` function detaches the message from the
+            // builder, so we can transfer the resopnse to gRPC while simultaneously
+            // detaching that memory buffer from the builer.
+            *response_msg = mb_.ReleaseMessage<fb::RegisterResponse>();
+            assert(response_msg->Verify());
+
+            return grpc::Status::OK;
+        }
+
+        /**
+         * @brief Client heartbeats by a given interval.
+         *
+         * @param context RPC context.
+         * @param request_msg RPC request.
+         * @param response_msg RPC response.
+         * @return grpc::Status RPC status.
+         */
+        virtual grpc::Status Heartbeat(
+            grpc::ServerContext *context,
+            const flatbuffers::grpc::Message<fb::HeartbeatRequest> *request_msg,
+            flatbuffers::grpc::Message<fb::HeartbeatResponse> *response_msg) override
+        {
+            spdlog::trace("gRPC-fb(Heartbeat) starts");
+
+            flatbuffers::grpc::MessageBuilder mb_;
+            mb_.Finish(fb::CreateHeartbeatResponse(mb_, 0));
+            *response_msg = mb_.ReleaseMessage<fb::HeartbeatResponse>();
+
+            return grpc::Status::OK;
+        }
+
+        /**
+         * @brief Client pulls pending blocks.
+         *
+         * @param context RPC context.
+         * @param request_msg RPC request.
+         * @param response_msg RPC response.
+         * @return grpc::Status RPC status.
+         */
+        virtual grpc::Status PullPendingBlocks(
+            grpc::ServerContext *context,
+            const flatbuffers::grpc::Message<fb::PullPendingBlocksRequest> *request_msg,
+            flatbuffers::grpc::Message<fb::PullPendingBlocksResponse> *response_msg) override
+        {
+            EASY_BLOCK("PullPendingBlocksResp");
+            spdlog::trace("gRPC-fb(PullPendingBlocks) starts");
 
+            const fb::PullPendingBlocksRequest *request = request_msg->GetRoot();
+            const uint64_t client_id = request->id();
+
+            std::vector<std::shared_ptr<Block>> new_blocks =
+                tc_server_->pull_pending_blocks(client_id);
+
+            EASY_BLOCK("serialize response");
+            flatbuffers::grpc::MessageBuilder mb_;
+            std::vector<flatbuffers::Offset<fb::BlockHeader>> hdr_vec;
+            hdr_vec.reserve(new_blocks.size());
+            for (auto blk : new_blocks)
+            {
+                hdr_vec.push_back(
+                    flatbuffers_adapter<BlockHeader>::build(mb_, blk->header_));
+            }
+            auto pb_hdrs = mb_.CreateVector(hdr_vec);
+            mb_.Finish(fb::CreatePullPendingBlocksResponse(mb_, 0, pb_hdrs));
+            *response_msg = mb_.ReleaseMessage<fb::PullPendingBlocksResponse>();
+            tc_server_->resp_bytes.fetch_add(response_msg->size(), std::memory_order_relaxed);
+            EASY_END_BLOCK;
+
+            spdlog::trace("gRPC-fb(PullPendingBlocks) ends");
+
+            EASY_END_BLOCK;
+
+            return grpc::Status::OK;
+        }
+
+        /**
+         * @brief Client gets blocks.
+         *
+         * @param context RPC context.
+         * @param request_msg RPC request.
+         * @param response_msg RPC response.
+         * @return grpc::Status RPC status.
+         */
+        virtual grpc::Status GetBlocks(
+            grpc::ServerContext *context,
+            const flatbuffers::grpc::Message<fb::GetBlocksRequest> *request_msg,
+            flatbuffers::grpc::Message<fb::GetBlocksResponse> *response_msg) override
+        {
+            EASY_BLOCK("GetBlocksResp");
+            spdlog::trace("gRPC-fb(GetBlocks) starts");
+
+            const fb::GetBlocksRequest *request = request_msg->GetRoot();
+
+            // blocks are built straight into the response buffer
+            flatbuffers::grpc::MessageBuilder mb_;
+            std::vector<flatbuffers::Offset<fb::Block>> blk_vec;
+            if (request->pb_hdrs() != nullptr)
+            {
+                for (auto req_hdr : *(request->pb_hdrs()))
+                {
+                    EASY_BLOCK("serialize response");
+                    tc_server_->visit_pending_block(
+                        req_hdr->id(),
+                        [&](const Block &block)
+                        {
+                            blk_vec.push_back(
+                                flatbuffers_adapter<Block>::build(mb_, block));
+                        });
+                    EASY_END_BLOCK;
+                }
+            }
+            auto pb = mb_.CreateVector(blk_vec);
+            mb_.Finish(fb::CreateGetBlocksResponse(mb_, 0, pb));
+            *response_msg = mb_.ReleaseMessage<fb::GetBlocksResponse>();
+            tc_server_->resp_bytes.fetch_add(response_msg->size(), std::memory_order_relaxed);
+
+            EASY_END_BLOCK;
+
+            return grpc::Status::OK;
+        }
+
+        /**
+         * @brief Client votes blocks.
+         *
+         * @param context RPC context.
+         * @param request_msg RPC request.
+         * @param response_msg RPC response.
+         * @return grpc::Status RPC status.
+         */
         virtual grpc::Status VoteBlocks(
             grpc::ServerContext *context,
             const flatbuffers::grpc::Message<fb::VoteBlocksRequest> *request_msg,
             flatbuffers::grpc::Message<fb::VoteBlocksResponse> *response_msg) override
         {
-            flatbuffers::grpc::MessageBuilder mb_;
+            EASY_BLOCK("VoteBlocksResp");
+            spdlog::trace("gRPC-fb(VoteBlocks) starts");
 
-            // We call GetRoot to "parse" the message. Verification is already
-            // performed by default. See the notes below for more details.
             const fb::VoteBlocksRequest *request = request_msg->GetRoot();
+            const uint32_t client_id = request->id();
 
-            // // Fields are retrieved as usual with FlatBuffers
-            // const std::string &name = request->name()->str();
-            const uint32_t &client_id = request->id(); 
-            auto votes = request->votes(); 
-            for (auto vote : *votes) {
-                auto limbs = vote->sigshare()->point()->limbs(); 
-                libff::alt_bn128_G1 *g1 = (libff::alt_bn128_G1*)limbs->data();
-            }
+            auto votes = request->votes();
+            if (votes != nullptr)
+            {
+                for (auto vote : *votes)
+                {
+                    // a client can only vote for itself
+                    if (vote->voterid() != client_id)
+                    {
+                        spdlog::trace("{}:vote not from client", client_id);
+                        continue;
+                    }
+                    if (tc_server_->is_vote_outside(vote->blockid(), vote->voterid()))
+                    {
+                        continue;
+                    }
+                    // the point limbs are the raw share encoding
+                    auto share = vote->sigshare();
+                    if (share != nullptr && share->point() != nullptr && share->point()->limbs() != nullptr)
+                    {
+                        vote_codec::entry e{vote->blockid(),
+                                            vote->voterid(),
+                                            std::string_view((const char *)(share->point()->limbs()->data()),
+                                                             share->point()->limbs()->size()),
+                                            share->hint() == nullptr ? std::string_view() : std::string_view(share->hint()->c_str(), share->hint()->size()),
+                                            0,
+                                            {}};
+                        if (tc_server_->is_vote_late(e, vote_codec::encoding::raw))
+                        {
+                            continue;
+                        }
+                    }
 
-            // // `flatbuffers::grpc::MessageBuilder` is a `FlatBufferBuilder` with a
-            // // special allocator for efficient gRPC buffer transfer, but otherwise
-            // // usage is the same as usual.
-            // auto msg_offset = mb_.CreateString("Hello, " + name);
-            // auto hello_offset = CreateHelloReply(mb_, msg_offset);
-            // mb_.Finish(hello_offset);
+                    EASY_BLOCK("deserialize request");
+                    std::shared_ptr<BlockVote> sp_vote =
+                        flatbuffers_adapter<BlockVote>::from_fb(vote);
+                    EASY_END_BLOCK;
+                    if (sp_vote == nullptr)
+                    {
+                        continue;
+                    }
 
-            // The `ReleaseMessage<T>()` function detaches the message from the
-            // builder, so we can transfer the resopnse to gRPC while simultaneously
-            // detaching that memory buffer from the builer.
+                    tc_server_->handle_client_vote(client_id, sp_vote);
+                }
+            }
+
+            flatbuffers::grpc::MessageBuilder mb_;
+            mb_.Finish(fb::CreateVoteBlocksResponse(mb_, 0));
             *response_msg = mb_.ReleaseMessage<fb::VoteBlocksResponse>();
             assert(response_msg->Verify());
 
+            EASY_END_BLOCK;
+
             // Return an OK status.
             return grpc::Status::OK;
         }
@@ -60,4 +260,4 @@ namespace tomchain
          */
         std::shared_ptr<TcServer> tc_server_;
     };
-}
\ No newline at end of file
+}
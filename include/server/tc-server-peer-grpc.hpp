@@ -1,12 +1,18 @@
+#include <cassert>
 #include <chrono>
+#include <string>
 
 #include "spdlog/spdlog.h"
 #include <easy/profiler.h>
 
+#include <google/protobuf/descriptor.h>
 #include <grpcpp/grpcpp.h>
 #include "tc-server-peer.grpc.pb.h"
 
 #include "tc-server.hpp"
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+#include "server/payload_buffer.hpp"
 
 namespace tomchain
 {
@@ -59,27 +65,49 @@ namespace tomchain
             spdlog::trace("gRPC(RelayVoteResp) starts");
 
             uint32_t peer_id = request->id();
-            auto req_votes = request->votes();
 
-            // for (auto iter = req_votes.begin(); iter != req_votes.end(); iter++)
+            // deserialize relayed votes
+            EASY_BLOCK("deserialize");
+            spdlog::trace("{} RelayVote: deserialize relayed votes", peer_id);
+            std::vector<vote_codec::entry> entries;
+            entries.reserve(request->entries_size());
+            for (const VoteEntry &rv : request->entries())
+            {
+                vote_codec::entry e{rv.block_id(),
+                                    rv.voter_id(),
+                                    rv.sig_share(),
+                                    rv.hint(),
+                                    rv.batch_size(),
+                                    rv.batch_root()};
+                // off the committee or past quorum: skip the point decompression
+                if (tc_server_->is_vote_outside(e.block_id, e.voter_id) ||
+                    tc_server_->is_vote_late(e, (vote_codec::encoding)(request->share_encoding())))
+                {
+                    continue;
+                }
+                entries.push_back(e);
+            }
+            const size_t client_count = (*::conf_data)["client-count"];
+            const size_t vote_threshold = (*::conf_data)["vote-threshold"];
+            std::vector<std::shared_ptr<BlockVote>> req_votes = vote_codec::decode_batch(
+                entries,
+                (vote_codec::encoding)(request->share_encoding()),
+                vote_threshold,
+                client_count,
+                tc_server_->vote_batch_blocks,
+                (*::conf_data)["server-count"]);
+            EASY_END_BLOCK;
+
             for (size_t rv_index = 0; rv_index < req_votes.size(); rv_index++)
             {
                 spdlog::trace("{} RelayVote: get relayed vote", peer_id);
-                auto rv = req_votes.Get(rv_index);
-
-                // deserialize relayed votes
-                EASY_BLOCK("deserialize");
-                spdlog::trace("{} RelayVote: deserialize relayed votes", peer_id);
-                // msgpack::sbuffer des_b = stringToSbuffer(rv);
-                // auto oh = msgpack::unpack(des_b.data(), des_b.size());
-                // auto vote = oh->as<std::shared_ptr<BlockVote>>();
-                std::vector<uint8_t> blkvote_ser(rv.begin(), rv.end());
-                auto vote =
-                    flexbuffers_adapter<BlockVote>::from_bytes(
-                        std::make_shared<std::vector<uint8_t>>(blkvote_ser));
+                std::shared_ptr<BlockVote> vote = req_votes[rv_index];
+                if (vote == nullptr)
+                {
+                    continue;
+                }
 
                 const uint64_t block_id = vote->block_id_;
-                EASY_END_BLOCK;
 
                 // check if died block
                 EASY_BLOCK("check if died block");
@@ -91,6 +119,12 @@ namespace tomchain
                 }
                 EASY_END_BLOCK;
 
+                if (vote->batch_size_ > 0)
+                {
+                    tc_server_->add_batch_vote(vote->voter_id_, vote);
+                    continue;
+                }
+
                 // add to local block vote vector
                 spdlog::trace("{} RelayVote: add to local block vote vector", peer_id);
                 BlockCHM::accessor pb_accessor;
@@ -114,10 +148,8 @@ namespace tomchain
                 EASY_BLOCK("insert vote");
                 std::shared_ptr<tomchain::Block> block_sp = pb_accessor->second;
                 assert(block_sp != nullptr);
-                block_sp->votes_.insert(
-                    std::make_pair(
-                        vote->voter_id_,
-                        vote));
+                block_sp->add_vote(vote->voter_id_, vote);
+                block_sp->invalidate_payload();
                 spdlog::debug("{}:push vote into {} relay queue, vote count={}",
                               vote->voter_id_,
                               block_id,
@@ -137,9 +169,10 @@ namespace tomchain
                 // check if vote enough
                 EASY_BLOCK("check vote enough");
                 spdlog::trace("{} RelayVote: check if vote enough", peer_id);
-                if (block_sp->is_vote_enough((*::conf_data)["client-count"]))
+                if (block_sp->is_vote_enough((*::conf_data)["vote-threshold"]))
                 {
                     spdlog::trace("{} RelayVote: vote enough", peer_id);
+                    tc_server_->merging_blks.insert(std::make_pair(block_id, block_sp));
 
                     // EASY_BLOCK("merge");
                     // block_sp->merge_votes((*::conf_data)["client-count"]);
@@ -182,8 +215,6 @@ namespace tomchain
                     // EASY_END_BLOCK;
                     // spdlog::trace("{} RelayVote: bcast commits", peer_id);
 
-                    spdlog::trace("push into pb_merge_queue");
-                    tc_server_->pb_merge_queue.push(block_sp);
                     // pb_accessor.release();
 
                     // EASY_BLOCK("bcast commits");
@@ -194,6 +225,7 @@ namespace tomchain
                     EASY_BLOCK("remove from pb");
                     spdlog::trace("{} RelayVote: remove block from pending", peer_id);
                     std::shared_lock<std::shared_mutex> pb_sl_1(tc_server_->pb_sm_1);
+                    pb_accessor->second->finalized_.store(true, std::memory_order_release);
                     bool is_erased = tc_server_->pending_blks.erase(pb_accessor);
                     pb_sl_1.unlock();
                     if (is_erased)
@@ -205,6 +237,9 @@ namespace tomchain
                         spdlog::error("{} RelayVote: block ({}) not erased", peer_id, block_id);
                     }
                     EASY_END_BLOCK;
+
+                    spdlog::trace("{} RelayVote: push into merge engine", peer_id);
+                    tc_server_->queue_merge(block_sp);
                 }
                 EASY_END_BLOCK;
 
@@ -255,25 +290,44 @@ namespace tomchain
                 // msgpack::sbuffer des_b = stringToSbuffer(*iter);
                 // auto oh = msgpack::unpack(des_b.data(), des_b.size());
                 // auto block = oh->as<std::shared_ptr<Block>>();
-                EASY_BLOCK("blk_ser");
-                std::vector<uint8_t> blk_ser((*iter).begin(), (*iter).end());
+                EASY_BLOCK("flatbuffers");
+                BlockView block_view(*iter);
+                if (!block_view.verify())
+                {
+                    EASY_END_BLOCK;
+                    EASY_END_BLOCK;
+                    spdlog::warn("{} RelayBlock: malformed block dropped", peer_id);
+                    continue;
+                }
+                auto block = block_view.to_block();
                 EASY_END_BLOCK;
-                EASY_BLOCK("flexbuffers");
-                auto block =
-                    flexbuffers_adapter<Block>::from_bytes(
-                        std::make_shared<std::vector<uint8_t>>(blk_ser));
                 EASY_END_BLOCK;
+
+                EASY_BLOCK("verify body");
+                const bool body_ok = block->verify_body();
                 EASY_END_BLOCK;
+                if (!body_ok)
+                {
+                    spdlog::warn("{} RelayBlock: block ({}) body does not match its header, dropped", peer_id, block->header_.id_);
+                    continue;
+                }
 
                 // store block locally
                 EASY_BLOCK("store");
                 spdlog::info("{} RelayBlock: store block ({}) locally", peer_id, block->header_.id_);
                 BlockCHM::accessor accessor;
                 std::shared_lock<std::shared_mutex> pb_sl_1(tc_server_->pb_sm_1);
-                tc_server_->pending_blks.insert(accessor, block->header_.id_);
+                const bool is_new = tc_server_->pending_blks.insert(accessor, block->header_.id_);
                 pb_sl_1.unlock();
+                if (!is_new && accessor->second != nullptr)
+                {
+                    // a replaced copy no longer holds back log trimming
+                    accessor->second->finalized_.store(true, std::memory_order_release);
+                }
                 accessor->second = block;
                 accessor.release();
+                // the sync signal may have come first
+                tc_server_->announce_pending(block->header_.id_);
                 EASY_END_BLOCK;
             }
 
@@ -318,49 +372,104 @@ namespace tomchain
 
             for (auto iter = req_blocks.begin(); iter != req_blocks.end(); iter++)
             {
-                // deserialize bcasted blocks
+                // read bcasted blocks in place
                 EASY_BLOCK("deserialize");
-                spdlog::trace("SPBcastCommit: deserialize bcasted blocks");
+                spdlog::trace("SPBcastCommit: read bcasted blocks");
                 // msgpack::sbuffer des_b = stringToSbuffer(*iter);
                 // auto oh = msgpack::unpack(des_b.data(), des_b.size());
                 // auto block = oh->as<std::shared_ptr<Block>>();
-                std::vector<uint8_t> blk_ser((*iter).begin(), (*iter).end());
-                auto block =
-                    flexbuffers_adapter<Block>::from_bytes(
-                        std::make_shared<std::vector<uint8_t>>(blk_ser));
+                BlockView block_view(*iter);
+                if (!block_view.verify())
+                {
+                    EASY_END_BLOCK;
+                    spdlog::warn("SPBcastCommit: malformed block dropped");
+                    continue;
+                }
+                const fb::BlockHeader *bcast_hdr = block_view.header();
+                const uint64_t block_id = bcast_hdr->id();
                 EASY_END_BLOCK;
 
                 // get latency by milliseconds
                 uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                uint64_t latency = now_ms - block->header_.proposal_ts_;
-                spdlog::info("SPBcastCommit blockid={}, latency={}", block->header_.id_, latency);
-
-                // record recv timestamp
-                block->header_.recv_ts_ = now_ms;
+                uint64_t latency = now_ms - bcast_hdr->proposal_ts();
+                spdlog::info("SPBcastCommit blockid={}, latency={}", block_id, latency);
 
                 // print committed block info in log
                 spdlog::info("SPBcastCommit block={}, proposal_ts={}, dist_ts={}, commit_ts={}, recv_ts={}",
-                             block->header_.id_,
-                             block->header_.proposal_ts_,
-                             block->header_.dist_ts_,
-                             block->header_.commit_ts_,
-                             block->header_.recv_ts_);
+                             block_id,
+                             bcast_hdr->proposal_ts(),
+                             bcast_hdr->dist_ts(),
+                             bcast_hdr->commit_ts(),
+                             now_ms);
+
+                // only the header of the local pending block is needed to
+                // check the certificate
+                EASY_BLOCK("find pb");
+                spdlog::trace("SPBcastCommit: find pending block");
+                Block scratch;
+                bool is_found = false;
+                {
+                    BlockCHM::const_accessor pb_caccessor;
+                    std::shared_lock<std::shared_mutex> pb_sl_1(tc_server_->pb_sm_1);
+                    is_found = tc_server_->pending_blks.find(pb_caccessor, block_id);
+                    pb_sl_1.unlock();
+                    if (is_found)
+                    {
+                        scratch.header_ = pb_caccessor->second->header_;
+                    }
+                }
+                EASY_END_BLOCK;
+                if (!is_found)
+                {
+                    spdlog::trace("SPBcastCommit: block not found");
+                    continue;
+                }
+
+                // the certificate is checked on a scratch block against the
+                // local digest, without holding the pending block
+                EASY_BLOCK("verify commit");
+                const bool has_cert = block_view.copy_commit(scratch);
+                const bool is_valid = tc_server_->commit_verifier == nullptr ||
+                                      (has_cert && tc_server_->commit_verifier->verify(scratch));
+                EASY_END_BLOCK;
+                if (!is_valid)
+                {
+                    spdlog::warn("SPBcastCommit: block {} from {} has no valid certificate", block_id, peer_id);
+                    tc_server_->bad_commits.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
 
                 // remove pending block
                 EASY_BLOCK("remove pb");
                 spdlog::trace("SPBcastCommit: remove pending block");
                 BlockCHM::accessor pb_accessor;
                 std::shared_lock<std::shared_mutex> pb_sl_1(tc_server_->pb_sm_1);
-                bool is_found = tc_server_->pending_blks.find(
-                    pb_accessor, block->header_.id_);
+                is_found = tc_server_->pending_blks.find(
+                    pb_accessor, block_id);
                 pb_sl_1.unlock();
+                EASY_END_BLOCK;
                 if (!is_found)
                 {
+                    // committed or dropped meanwhile
                     spdlog::trace("SPBcastCommit: block not found");
-                    pb_accessor.release();
                     continue;
                 }
-                EASY_END_BLOCK;
+
+                // the local pending block already holds the transactions,
+                // only the commit metadata is taken from the broadcast
+                std::shared_ptr<Block> block = pb_accessor->second;
+                if (has_cert)
+                {
+                    block->tss_sig_ = std::move(scratch.tss_sig_);
+                    block->batch_ = std::move(scratch.batch_);
+                    block->batch_index_ = scratch.batch_index_;
+                    block->batch_proof_ = std::move(scratch.batch_proof_);
+                }
+
+                block->header_.dist_ts_ = bcast_hdr->dist_ts();
+                block->header_.commit_ts_ = bcast_hdr->commit_ts();
+                block->header_.recv_ts_ = now_ms;
+                block->invalidate_payload();
 
                 // insert into committed blocks
                 EASY_BLOCK("insert cb");
@@ -368,7 +477,7 @@ namespace tomchain
                 BlockCHM::accessor cb_accessor;
                 tc_server_->committed_blks.insert(
                     cb_accessor,
-                    block->header_.id_);
+                    block_id);
                 cb_accessor->second = block;
                 EASY_END_BLOCK;
 
@@ -376,18 +485,16 @@ namespace tomchain
                 EASY_BLOCK("rocksdb");
                 if ((*::conf_data)["use-rocksdb"])
                 {
-                    // serialize
-                    auto blk_bv = flexbuffers_adapter<Block>::to_bytes(*block);
-                    std::string ser_blk(blk_bv->begin(), blk_bv->end());
-                    // put
+                    // the received bytes are already in the storage encoding
                     std::unique_lock<std::mutex> db_ul_1(tc_server_->db_mutex);
-                    std::string block_name = std::string{"block-"} + std::to_string(block->header_.id_);
-                    tc_server_->db->Put(rocksdb::WriteOptions(), block_name.c_str(), ser_blk);
+                    std::string block_name = std::string{"block-"} + std::to_string(block_id);
+                    tc_server_->db->Put(rocksdb::WriteOptions(), block_name.c_str(), *iter);
                     db_ul_1.unlock();
-                    EASY_END_BLOCK;
                 }
+                EASY_END_BLOCK;
 
                 EASY_BLOCK("erase");
+                block->finalized_.store(true, std::memory_order_release);
                 pb_sl_1.lock();
                 tc_server_->pending_blks.erase(pb_accessor);
                 pb_sl_1.unlock();
@@ -432,6 +539,7 @@ namespace tomchain
             EASY_BLOCK("insert signal");
             tc_server_->pb_sync_labels.insert(block_id);
             spdlog::trace("{} RelayBlockSync: block ({}) signaled", peer_id, block_id);
+            tc_server_->announce_pending(block_id);
             EASY_END_BLOCK;
 
             response->set_status(0);
@@ -447,6 +555,28 @@ namespace tomchain
         }
     };
 
+    /**
+     * @brief gRPC path "/<package>.<service>/<method>" of the peer RPC
+     * taking `request`, as the generated stubs use it, for GenericStub
+     * calls.
+     */
+    inline std::string peer_method_path(const google::protobuf::Descriptor *request)
+    {
+        const google::protobuf::ServiceDescriptor *service =
+            request->file()->FindServiceByName("TcPeerConsensus");
+        assert(service != nullptr);
+        for (int i = 0; i < service->method_count(); i++)
+        {
+            const google::protobuf::MethodDescriptor *method = service->method(i);
+            if (method->input_type() == request)
+            {
+                return "/" + std::string(service->full_name()) + "/" + std::string(method->name());
+            }
+        }
+        assert(false);
+        return std::string();
+    }
+
     grpc::Status TcServer::SPHeartbeat(uint64_t target_server_id)
     {
         SPHeartbeatRequest request;
@@ -500,28 +630,39 @@ namespace tomchain
         request.set_id(this->server_id);
 
         EASY_BLOCK("add votes");
+        std::vector<std::shared_ptr<BlockVote>> votes;
         std::shared_ptr<BlockVote> vote;
         spdlog::trace("{} gRPC(RelayVote) pop votes", target_server_id);
         while (relay_votes.find(target_server_id)->second->try_pop(vote))
         {
-            // serialize vote
-            // msgpack::sbuffer b;
-            // msgpack::pack(b, vote);
-            // std::string ser_vote = sbufferToString(b);
-            auto blk_bv = flexbuffers_adapter<BlockVote>::to_bytes(*vote);
-            std::string ser_vote(blk_bv->begin(), blk_bv->end());
-
-            // add to relayed vote vector
-            request.add_votes(ser_vote);
+            votes.push_back(vote);
         }
-        EASY_END_BLOCK;
 
         // if no votes, return
-        if (request.votes_size() == 0)
+        if (votes.empty())
         {
             return grpc::Status::OK;
         }
 
+        // serialize votes, sharing one normalization across the batch
+        std::vector<std::string> sig_shares =
+            vote_codec::encode_sig_shares(votes, this->relay_vote_encoding);
+        request.set_share_encoding((ShareEncoding)(this->relay_vote_encoding));
+        for (size_t i = 0; i < votes.size(); i++)
+        {
+            VoteEntry *entry = request.add_entries();
+            entry->set_block_id(votes[i]->block_id_);
+            entry->set_voter_id(votes[i]->voter_id_);
+            entry->set_sig_share(std::move(sig_shares[i]));
+            entry->set_hint(votes[i]->sig_share_->getHint());
+            if (votes[i]->batch_size_ > 0)
+            {
+                entry->set_batch_size(votes[i]->batch_size_);
+                entry->set_batch_root(votes[i]->batch_root_.data(), votes[i]->batch_root_.size());
+            }
+        }
+        EASY_END_BLOCK;
+
         RelayVoteResponse response;
 
         grpc::ClientContext context;
@@ -560,8 +701,10 @@ namespace tomchain
         EASY_BLOCK("RelayBlockReq");
         spdlog::trace("{} gRPC(RelayBlockReq) starts", target_server_id);
 
-        RelayBlockRequest request;
-        request.set_id(this->server_id);
+        // RelayBlockRequest { id = 1; repeated bytes blocks = 2; }
+        PayloadBufferBuilder request;
+        request.add_varint_field(1, this->server_id);
+        size_t block_count = 0;
 
         std::vector<uint64_t> tmp_sync_vec;
 
@@ -575,29 +718,25 @@ namespace tomchain
             // msgpack::sbuffer b;
             // msgpack::pack(b, block);
             // std::string ser_block = sbufferToString(b);
-            EASY_BLOCK("flexbuffers");
-            auto blk_bv = flexbuffers_adapter<Block>::to_bytes(*block);
-            EASY_END_BLOCK;
-            EASY_BLOCK("ser_blk");
-            std::string ser_block(blk_bv->begin(), blk_bv->end());
-            EASY_END_BLOCK;
+            // add to relayed block vector, sharing one encoding across peers
+            request.add_bytes_field(2, flatbuffers_adapter<Block>::payload(*block));
+            block_count++;
             EASY_END_BLOCK;
 
-            // add to relayed block vector
             EASY_BLOCK("add to relay");
-            request.add_blocks(ser_block);
             tmp_sync_vec.push_back(block->header_.id_);
             EASY_END_BLOCK;
         }
         EASY_END_BLOCK;
 
         // if no blocks, return
-        if (request.blocks_size() == 0)
+        if (block_count == 0)
         {
             return grpc::Status::OK;
         }
 
-        RelayBlockResponse response;
+        grpc::ByteBuffer request_buf = request.release();
+        grpc::ByteBuffer response_buf;
 
         grpc::ClientContext context;
         std::mutex mu;
@@ -607,12 +746,20 @@ namespace tomchain
         EASY_BLOCK("wait");
         spdlog::trace("{} gRPC(RelayBlock) waiting", target_server_id);
         grpc::Status status;
-        grpc_peer_client_stub_.find(target_server_id)->second->async()->RelayBlock(&context, &request, &response, [&mu, &cv, &done, &status](grpc::Status s)
-                                                                                   {
+        static const std::string method_path = peer_method_path(RelayBlockRequest::descriptor());
+        grpc_peer_generic_stub_.find(target_server_id)->second->UnaryCall(
+            &context,
+            method_path,
+            grpc::StubOptions(),
+            &request_buf,
+            &response_buf,
+            [&mu, &cv, &done, &status](grpc::Status s)
+            {
                 status = std::move(s);
                 std::lock_guard<std::mutex> lock(mu);
                 done = true;
-                cv.notify_one(); });
+                cv.notify_one();
+            });
 
         std::unique_lock<std::mutex> lock(mu);
         while (!done)
@@ -643,8 +790,10 @@ namespace tomchain
         EASY_BLOCK("SPBcastCommitReq");
         spdlog::trace("{} gRPC(SPBcastCommitReq) starts", target_server_id);
 
-        SPBcastCommitRequest request;
-        request.set_id(this->server_id);
+        // SPBcastCommitRequest { id = 1; repeated bytes blocks = 2; uint64 timestamp = 3; }
+        PayloadBufferBuilder request;
+        request.add_varint_field(1, this->server_id);
+        size_t block_count = 0;
 
         std::shared_ptr<Block> block;
         spdlog::trace("{} gRPC(SPBcastCommit) pops blocks", target_server_id);
@@ -663,12 +812,10 @@ namespace tomchain
                 // msgpack::sbuffer b;
                 // msgpack::pack(b, block);
                 // std::string ser_block = sbufferToString(b);
-                auto blk_bv = flexbuffers_adapter<Block>::to_bytes(*block);
-                std::string ser_block(blk_bv->begin(), blk_bv->end());
+                // add to bcast block vector, sharing one encoding across peers
+                request.add_bytes_field(2, flatbuffers_adapter<Block>::payload(*block));
+                block_count++;
                 EASY_END_BLOCK;
-
-                // add to bcast block vector
-                request.add_blocks(ser_block);
             }
             catch (const std::exception &e)
             {
@@ -678,12 +825,12 @@ namespace tomchain
         }
 
         // if no commits, return
-        if (request.blocks_size() == 0)
+        if (block_count == 0)
         {
             return grpc::Status::OK;
         }
 
-        SPBcastCommitResponse response;
+        grpc::ByteBuffer response_buf;
 
         grpc::ClientContext context;
         std::mutex mu;
@@ -694,15 +841,24 @@ namespace tomchain
         // get current timestamp
         uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
         spdlog::trace("{} gRPC(SPBcastCommit) send request to {} at {}", this->server_id, target_server_id, now_ms);
-        request.set_timestamp(now_ms);
+        request.add_varint_field(3, now_ms);
+        grpc::ByteBuffer request_buf = request.release();
         spdlog::trace("{} gRPC(SPBcastCommit) waiting", target_server_id);
         grpc::Status status;
-        grpc_peer_client_stub_.find(target_server_id)->second->async()->SPBcastCommit(&context, &request, &response, [&mu, &cv, &done, &status](grpc::Status s)
-                                                                                      {
+        static const std::string method_path = peer_method_path(SPBcastCommitRequest::descriptor());
+        grpc_peer_generic_stub_.find(target_server_id)->second->UnaryCall(
+            &context,
+            method_path,
+            grpc::StubOptions(),
+            &request_buf,
+            &response_buf,
+            [&mu, &cv, &done, &status](grpc::Status s)
+            {
                 status = std::move(s);
                 std::lock_guard<std::mutex> lock(mu);
                 done = true;
-                cv.notify_one(); });
+                cv.notify_one();
+            });
 
         std::unique_lock<std::mutex> lock(mu);
         while (!done)
@@ -1,9 +1,12 @@
 #ifndef TC_SERVER_HDR
 #define TC_SERVER_HDR
 
+#include <cstring>
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <functional>
 
 #include "spdlog/spdlog.h"
 #include "spdlog/fmt/bin_to_hex.h"
@@ -18,12 +21,22 @@
 #include <easy/profiler.h>
 
 #include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/generic_stub.h>
 #include "tc-server.grpc.pb.h"
 #include "tc-server-peer.grpc.pb.h"
 
 #include "block.hpp" 
 #include "transaction.hpp" 
 #include "msgpack_adapter.hpp"
+#include "vote_codec.hpp"
+#include "share_verifier.hpp"
+#include "commit_verifier.hpp"
+#include "keystore.hpp"
+#include "committee.hpp"
+#include "server/merge_engine.hpp"
+#include "server/mempool.hpp"
+#include "server/announce_log.hpp"
+#include "server/delivery_tracker.hpp"
 #include "rocksdb/db.h"
 
 extern std::shared_ptr<nlohmann::json> conf_data; 
@@ -31,15 +44,47 @@ extern std::shared_ptr<nlohmann::json> conf_data;
 namespace tomchain {
 
 typedef oneapi::tbb::concurrent_hash_map<
-    uint64_t, std::shared_ptr<Transaction>
+    uint64_t, Transaction
 > TransactionCHM; 
 typedef oneapi::tbb::concurrent_hash_map<
     uint64_t, std::shared_ptr<Block>
 > BlockCHM; 
+/**
+ * @brief A vote that arrived while its block was merging, kept 
+ * undecoded in case check_votes() sends the block back to the pending 
+ * pool. 
+ */
+struct HeldVote {
+    vote_codec::encoding enc; 
+    uint64_t voter_id; 
+    std::string sig_share; 
+    std::string hint; 
+}; 
 typedef oneapi::tbb::concurrent_hash_map<
-    uint64_t, std::shared_ptr<BlockHeader>
-> BlockHeaderCHM; 
-
+    uint64_t, std::vector<HeldVote>
+> HeldVoteCHM; 
+/**
+ * @brief What a batch vote signs. Votes count towards the same 
+ * container only if all three match. 
+ */
+struct BatchKey {
+    uint64_t first_id; 
+    uint64_t size; 
+    sha256::digest root; 
+}; 
+struct BatchKeyHashCompare {
+    static size_t hash(const BatchKey& key) {
+        uint64_t prefix; 
+        std::memcpy(&prefix, key.root.data(), sizeof(prefix)); 
+        return std::hash<uint64_t>{}(key.first_id ^ (key.size << 48) ^ prefix); 
+    }
+    static bool equal(const BatchKey& a, const BatchKey& b) {
+        return a.first_id == b.first_id && a.size == b.size && a.root == b.root; 
+    }
+}; 
+typedef oneapi::tbb::concurrent_hash_map<
+    BatchKey, std::shared_ptr<Block>, BatchKeyHashCompare
+> BatchCHM; 
 class ClientProfile {
 public: 
     uint64_t id;
@@ -48,7 +93,10 @@ public:
         std::shared_ptr<BLSPrivateKeyShare>, 
         std::shared_ptr<BLSPublicKeyShare>
     >> tss_key;
-    BlockHeaderCHM seen_blocks; 
+    // blocks pulled so far, see pull_pending_blocks() 
+    std::unique_ptr<DeliveryTracker> delivered; 
+    // next TcServer::announce_log entry to read 
+    std::atomic<uint64_t> announce_cursor{0}; 
 };
 
 typedef oneapi::tbb::concurrent_hash_map<
@@ -83,6 +131,85 @@ public:
     void generate_tx(uint64_t num_tx); 
     void pack_block(uint64_t num_tx, uint64_t num_block);
 
+public: 
+    /**
+     * @brief Codec-independent handlers shared by the protobuf and 
+     * FlatBuffers consensus services. 
+     * 
+     */
+    std::string register_client(uint64_t client_id, const std::vector<uint8_t>& pkey_data); 
+    /**
+     * @brief Pending blocks announced since the last pull of this 
+     * client, read from announce_log without copying pending_blks. 
+     * 
+     * A block announced more than DeliveryTracker::window ids behind 
+     * the newest block of its proposer already sent to this client 
+     * counts as delivered and is never sent to it. 
+     */
+    std::vector<std::shared_ptr<Block>> pull_pending_blocks(uint64_t client_id); 
+    bool visit_pending_block(uint64_t block_id, const std::function<void(const Block&)>& visitor); 
+    void handle_client_vote(uint64_t client_id, std::shared_ptr<BlockVote> vote); 
+
+    /**
+     * @brief Whether a block already has its quorum, so that a vote for 
+     * it needs no decoding. Votes for a committed block are dropped and 
+     * counted in late_votes; those for a merging block are copied to 
+     * held_votes. 
+     * 
+     */
+    bool is_vote_late(const vote_codec::entry& e, vote_codec::encoding enc); 
+
+    /**
+     * @brief Whether a client is on the committee of a block, see 
+     * committee.hpp. Always true without "committee-size". Looks the 
+     * committee up in `committees`. 
+     * 
+     */
+    bool is_committee_member(uint64_t block_id, uint64_t client_id) const; 
+
+    /**
+     * @brief Whether a vote comes from outside the committee of its block 
+     * and must be dropped. Counts outsider_votes. 
+     * 
+     */
+    bool is_vote_outside(uint64_t block_id, uint64_t voter_id); 
+
+    /**
+     * @brief Count a batch vote towards the container of its batch in 
+     * vote_batches, keyed by what the vote signs. certify_batch() checks 
+     * the root against the member digests. 
+     * 
+     */
+    void add_batch_vote(uint64_t client_id, std::shared_ptr<BlockVote> vote); 
+
+    /**
+     * @brief Drop the vote_batches containers older than 
+     * "block-die-threshold", certified or not. Until then a certified 
+     * container keeps its quorum and turns later votes away as late. 
+     * 
+     */
+    void expire_vote_batches(); 
+
+    /**
+     * @brief Queue the containers in batch_retries, that lacked a member 
+     * block, for another certify_batch() unless they expired. 
+     * 
+     */
+    void retry_vote_batches(); 
+
+    /**
+     * @brief Queue a block that reached quorum for merging without 
+     * waiting; if the merge engine is full it goes to merge_overflow. 
+     * 
+     */
+    void queue_merge(std::shared_ptr<Block> sp_block); 
+
+    /**
+     * @brief Move merge_overflow into the merge engine, waiting for room. 
+     * 
+     */
+    void drain_merge_overflow(); 
+
 public: 
     void send_relay_votes(); 
     void send_relay_blocks(); 
@@ -94,12 +221,59 @@ public:
     void bcast_commits(); 
     grpc::Status RelayBlockSync(uint64_t block_id, uint64_t target_server_id); 
     void send_relay_block_sync(uint64_t block_id);
-    void merge_votes(); 
+
+    /**
+     * @brief Append a block to announce_log once it is both pending and 
+     * synced (pb_sync_labels). Called after either of the two happens; 
+     * a block is announced at most once, and its dist_ts_ stamped then. 
+     * 
+     */
+    void announce_pending(uint64_t block_id); 
+
+    /**
+     * @brief Merge and commit one block that reached quorum. Runs on a 
+     * merge engine arena thread, concurrently with other blocks. 
+     * 
+     * @param merge_threads Threads this block's merge may use. 
+     */
+    void merge_votes(std::shared_ptr<Block> sp_block, size_t merge_threads); 
+
+    /**
+     * @brief merge_votes() for a batch vote container: merge the batch 
+     * signature, check the root against the member digests and commit 
+     * each pending member with the signature and its Merkle proof. While 
+     * a member is unknown the container goes to batch_retries. 
+     * 
+     */
+    void certify_batch(std::shared_ptr<Block> sp_batch, size_t merge_threads); 
+
+    /**
+     * @brief Record, store and broadcast a block whose tss_sig_ is set. 
+     * 
+     */
+    void commit_block(std::shared_ptr<Block> sp_block); 
+
+    /**
+     * @brief Batch-verify the signature shares of a block about to be 
+     * merged ("verify-sig-shares"). Runs on a merge engine thread. 
+     * 
+     * Invalid shares are dropped. If fewer than the threshold remain, 
+     * the block goes back to the pending pool (a batch container stays in 
+     * vote_batches) together with the votes held for it meanwhile. 
+     * 
+     * @return true if the block holds a quorum of valid shares. 
+     */
+    bool check_votes(std::shared_ptr<Block> sp_block); 
     void remove_dead_blocks(); 
     uint64_t get_shadow_peer_server_id(); 
 
 public: 
+    // server i numbers its blocks from i * block_id_stride 
+    static constexpr uint64_t block_id_stride = 1000000; 
+
     uint64_t server_id;
+    // signature share encoding on links to peers 
+    vote_codec::encoding relay_vote_encoding; 
     ClientCHM clients;
 
     // used to lock traversal operations 
@@ -107,6 +281,19 @@ public:
     // other concurrent operations: read lock 
     std::shared_mutex pb_sm_1; 
     BlockCHM pending_blks; 
+    // reached quorum, not committed yet 
+    BlockCHM merging_blks; 
+    // votes for merging_blks, see is_vote_late() 
+    HeldVoteCHM held_votes; 
+    // batch vote containers, see add_batch_vote() 
+    BatchCHM vote_batches; 
+    // containers in creation order, with their creation time in ms 
+    std::mutex batch_expiry_mutex; 
+    std::deque<std::pair<uint64_t, BatchKey>> batch_expiry; 
+    // merged containers waiting for a member block, see certify_batch() 
+    oneapi::tbb::concurrent_queue<std::shared_ptr<Block>> batch_retries; 
+    // blocks the merge engine had no room for, see queue_merge() 
+    oneapi::tbb::concurrent_queue<std::shared_ptr<Block>> merge_overflow; 
 
     oneapi::tbb::concurrent_queue<
         uint64_t
@@ -114,11 +301,15 @@ public:
     oneapi::tbb::concurrent_set<
         uint64_t
     > pb_sync_labels;
-    oneapi::tbb::concurrent_queue<
-        std::shared_ptr<Block>
-    > pb_merge_queue;
+    // pending blocks that are synced, in the order clients pull them 
+    AnnounceLog announce_log; 
+    // blocks with enough votes, merged as they arrive 
+    std::unique_ptr<MergeEngine> merge_engine; 
     BlockCHM committed_blks; 
-    TransactionCHM pending_txs;
+    // signed transactions, verified before packing 
+    std::unique_ptr<Mempool> mempool; 
+    // wallets behind the generated transactions, see generate_tx() 
+    std::vector<ecdsa::Key> tx_signers; 
     std::atomic<uint64_t> blk_seq_generator; 
     std::map<
         uint64_t, 
@@ -148,8 +339,40 @@ public:
     std::mutex db_mutex; 
     rocksdb::DB* db;
     std::vector<std::atomic<bool>> peer_status; 
+    // payload bytes sent in PullPendingBlocks and GetBlocks responses 
+    std::atomic<uint64_t> resp_bytes; 
+    // signature shares checked by check_votes(), and merged unchecked 
+    bool verify_shares; 
+    std::atomic<uint64_t> shares_verified; 
+    std::atomic<uint64_t> shares_rejected; 
+    std::atomic<uint64_t> shares_unverified; 
+    // votes dropped by is_vote_late() 
+    std::atomic<uint64_t> late_votes; 
+    // per-block committees ("committee-size", 0 for all clients) 
+    uint64_t committee_size; 
+    uint64_t committee_seed; 
+    // "vote-batch-blocks", 0 to reject batch votes 
+    uint64_t vote_batch_blocks; 
+    // sampled once per block for is_committee_member() 
+    std::unique_ptr<committee_cache> committees; 
+    // votes dropped by is_vote_outside() 
+    std::atomic<uint64_t> outsider_votes; 
+    // blocks committed through batch votes 
+    std::atomic<uint64_t> batch_commits; 
+    // checks SPBcastCommit certificates, null unless "verify-commits" 
+    std::unique_ptr<CommitVerifier> commit_verifier; 
+    // broadcast commits whose certificate did not verify 
+    std::atomic<uint64_t> bad_commits; 
 
 
+private: 
+    /**
+     * @brief Move the votes held for a block that left merging_blks 
+     * out of held_votes and decode them. 
+     * 
+     */
+    std::vector<std::shared_ptr<BlockVote>> take_held_votes(uint64_t block_id); 
+
 private: 
     std::unique_ptr<grpc::Server> grpc_server_; 
     std::unique_ptr<grpc::Server> grpc_peer_server_; 
@@ -157,6 +380,10 @@ private:
         uint64_t, 
         std::unique_ptr<TcPeerConsensus::Stub>
     > grpc_peer_client_stub_;
+    std::map<
+        uint64_t, 
+        std::unique_ptr<grpc::GenericStub>
+    > grpc_peer_generic_stub_;
 
 };
 
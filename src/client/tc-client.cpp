@@ -18,6 +18,7 @@ std::shared_ptr<nlohmann::json> conf_data;
 
 // gRPC implementations
 #include "client/tc-client-grpc.hpp"
+#include "client/tc-client-grpc-fb.hpp"
 
 namespace tomchain
 {
@@ -26,17 +27,31 @@ namespace tomchain
     {
         stubs.push_back(TcConsensus::NewStub(channel));
         stubs.push_back(TcConsensus::NewStub(shadow_channel));
+        fb_stubs.push_back(fb::Consensus::NewStub(channel));
+        fb_stubs.push_back(fb::Consensus::NewStub(shadow_channel));
 
         this->init();
     }
 
     TcClient::~TcClient()
     {
+        if (vote_pipeline != nullptr)
+        {
+            vote_pipeline->stop();
+        }
     }
 
     void TcClient::init()
     {
         this->client_id = (*::conf_data)["client-id"];
+        this->use_fb_rpc =
+            (*::conf_data)["rpc-codec"].template get<std::string>() == std::string{"flatbuffers"};
+        this->vote_encoding = vote_codec::parse_encoding(
+            (*::conf_data)["vote-encoding"].template get<std::string>());
+        this->header_votes =
+            (*::conf_data)["vote-mode"].template get<std::string>() == std::string{"header"};
+        this->committee_size = (*::conf_data)["committee-size"].template get<uint64_t>();
+        this->committee_seed = (*::conf_data)["committee-seed"].template get<uint64_t>();
         this->ecc_skey = std::make_shared<ecdsa::Key>(ecdsa::Key());
         this->ecc_pkey = std::make_shared<ecdsa::PubKey>(
             this->ecc_skey->CreatePubKey());
@@ -91,6 +106,87 @@ namespace tomchain
             exit(0);
         }
         spdlog::info("Init RocksDB finished");
+
+        this->init_pipeline();
+    }
+
+    void TcClient::init_pipeline()
+    {
+        this->vote_pipeline = std::make_unique<VotePipeline>(
+            (*::conf_data)["vote-pipeline-depth"].template get<size_t>());
+
+        // execution reuses the per-client key buffers, and state applies in order
+        this->vote_pipeline->add_stage(
+            "execute", 1, 1, 0,
+            [this](std::vector<VotePipeline::Task> &batch)
+            {
+                EASY_BLOCK("stage execute");
+                std::erase_if(batch, [this](const VotePipeline::Task &task)
+                              { return !this->prepare_block(task.block); });
+                EASY_END_BLOCK;
+            });
+
+        const uint64_t batch_blocks = (*::conf_data)["vote-batch-blocks"].template get<uint64_t>();
+        const bool has_committees =
+            this->committee_size > 0 &&
+            this->committee_size < (*::conf_data)["client-count"].template get<uint64_t>();
+        if (batch_blocks > 1 && this->use_fb_rpc)
+        {
+            // fb::BlockVote has no batch fields
+            spdlog::warn("vote-batch-blocks is not supported with flatbuffers, voting per block");
+        }
+        else if (batch_blocks > 1 && has_committees)
+        {
+            // members of a batch have different committees
+            spdlog::warn("vote-batch-blocks is not supported with committee-size, voting per block");
+        }
+        else if (batch_blocks > 1)
+        {
+            const uint64_t timeout_ms = (*::conf_data)["vote-batch-timeout-ms"].template get<uint64_t>();
+            this->vote_batcher = std::make_unique<VoteBatcher>(
+                batch_blocks,
+                (*::conf_data)["grpc-server-count"].template get<uint64_t>(),
+                timeout_ms);
+            this->vote_pipeline->add_stage(
+                "batch", 1, batch_blocks, 0,
+                [this](std::vector<VotePipeline::Task> &batch)
+                {
+                    this->vote_batcher->collect(batch);
+                },
+                timeout_ms);
+        }
+
+        this->vote_pipeline->add_stage(
+            "sign",
+            (*::conf_data)["vote-sign-threads"].template get<size_t>(), 1, 0,
+            [this](std::vector<VotePipeline::Task> &batch)
+            {
+                EASY_BLOCK("stage sign");
+                for (VotePipeline::Task &task : batch)
+                {
+                    task.vote = task.batch == nullptr
+                                    ? this->sign_block(task.block)
+                                    : this->sign_batch(*task.batch);
+                }
+                EASY_END_BLOCK;
+            });
+
+        this->vote_pipeline->add_stage(
+            "send", 1,
+            (*::conf_data)["vote-batch-max"].template get<size_t>(),
+            (*::conf_data)["vote-batch-window-ms"].template get<uint64_t>(),
+            [this](std::vector<VotePipeline::Task> &batch)
+            {
+                EASY_BLOCK("stage send");
+                std::vector<std::shared_ptr<BlockVote>> votes;
+                votes.reserve(batch.size());
+                for (const VotePipeline::Task &task : batch)
+                {
+                    votes.push_back(task.vote);
+                }
+                this->VoteBlocks(votes);
+                EASY_END_BLOCK;
+            });
     }
 
     void TcClient::start()
@@ -209,12 +305,19 @@ namespace tomchain
                         return;
                     }
                     pull_flag = true;
+                    const uint64_t fed = this->vote_pipeline->pushed();
                     this->PullPendingBlocks(0);
                     this->PullPendingBlocks(1);
                     this->GetBlocks(0);
                     this->GetBlocks(1);
                     pull_flag = false;
 
+                    // poll again right away while blocks keep coming
+                    if (this->vote_pipeline->pushed() != fed)
+                    {
+                        continue;
+                    }
+
                     // sleep ms
                     std::this_thread::sleep_for(
                         std::chrono::milliseconds(
@@ -254,60 +357,35 @@ namespace tomchain
         // );
         // get_thread.detach();
 
-        bool vote_flag = false;
-        // t.setInterval(
-        //     [&]()
-        //     {
-        //         if (vote_flag == true)
-        //         {
-        //             return;
-        //         }
-        //         vote_flag = true;
-        //         if (!this->pending_blks.empty())
-        //         {
-        //             this->VoteBlocks();
-        //         }
-        //         vote_flag = false;
-        //     },
-        //     (*::conf_data)["pull-pb-interval"]);
+        // execute, sign and send overlap across blocks
+        this->vote_pipeline->start();
 
-        std::mutex vote_mutex;
-        std::thread vote_thread_handle = std::thread(
+        t.setInterval(
             [&]()
             {
-                const auto processor_count = std::thread::hardware_concurrency();
-                const auto bind_core = (*::conf_data)["client-id"].template get<uint64_t>() % processor_count;
-                cpu_set_t cpuset;
-                CPU_ZERO(&cpuset);
-                CPU_SET(bind_core, &cpuset);
-                int rc = pthread_setaffinity_np(
-                    heartbeat_thread_handle.native_handle(),
-                    sizeof(cpu_set_t),
-                    &cpuset);
-                if (rc != 0)
+                std::vector<VotePipeline::StageStats> stats = this->vote_pipeline->take_stats();
+                std::string line;
+                for (const VotePipeline::StageStats &stage : stats)
                 {
-                    spdlog::error("Error calling pthread_setaffinity_np: {}", rc);
-                    exit(-1);
+                    line += fmt::format(
+                        " | {}:{} q:{} busy:{:.0f}%",
+                        stage.name,
+                        stage.processed,
+                        stage.queued,
+                        stage.busy * 100);
                 }
-
-                // sleep ms
-                std::this_thread::sleep_for(std::chrono::milliseconds(20));
-                while (true)
+                if (this->vote_batcher != nullptr)
                 {
-                    if (vote_flag == true)
-                    {
-                        return;
-                    }
-                    vote_flag = true;
-                    this->VoteBlocks();
-                    vote_flag = false;
-
-                    // sleep ms
-                    std::this_thread::sleep_for(
-                        std::chrono::milliseconds(
-                            (*::conf_data)["pull-pb-interval"].template get<uint64_t>()));
+                    VoteBatcher::Stats batcher = this->vote_batcher->take_stats();
+                    line += fmt::format(
+                        " | batches:{} singles:{} open:{}",
+                        batcher.batches,
+                        batcher.singles,
+                        batcher.open);
                 }
-            });
+                spdlog::info("pipeline{}", line);
+            },
+            (*::conf_data)["pipeline-stats-interval"]);
 
         // std::thread vote_thread(
         //     [&]() {
@@ -0,0 +1,187 @@
+#include "alpaca_adapter.hpp"
+
+#include <cstring>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    static_assert(sizeof(alpaca_wire::Transaction) == sizeof(Transaction));
+    static_assert(sizeof(libff::alt_bn128_G1) == 96);
+
+    std::vector<uint8_t> &alpaca_thread_buffer()
+    {
+        static thread_local std::vector<uint8_t> buf;
+        buf.clear();
+        return buf;
+    }
+
+    alpaca_wire::BlockHeader alpaca_adapter<BlockHeader>::to_wire(const BlockHeader &bh)
+    {
+        return alpaca_wire::BlockHeader{
+            bh.id_,
+            bh.base_id_,
+            bh.proposal_ts_,
+            bh.dist_ts_,
+            bh.commit_ts_,
+            bh.recv_ts_,
+            bh.tx_count_,
+            bh.tx_root_,
+            bh.digest_};
+    }
+
+    std::shared_ptr<BlockHeader> alpaca_adapter<BlockHeader>::from_wire(const Wire &wire)
+    {
+        auto bh = std::make_shared<BlockHeader>();
+        bh->id_ = wire.id;
+        bh->base_id_ = wire.base_id;
+        bh->proposal_ts_ = wire.proposal_ts;
+        bh->dist_ts_ = wire.dist_ts;
+        bh->commit_ts_ = wire.commit_ts;
+        bh->recv_ts_ = wire.recv_ts;
+        bh->tx_count_ = wire.tx_count;
+        bh->tx_root_ = wire.tx_root;
+        bh->digest_ = wire.digest;
+        return bh;
+    }
+
+    alpaca_wire::Transaction alpaca_adapter<Transaction>::to_wire(const Transaction &tx)
+    {
+        return alpaca_wire::Transaction{
+            tx.id_,
+            tx.sender_,
+            tx.receiver_,
+            tx.value_,
+            tx.fee_};
+    }
+
+    std::shared_ptr<Transaction> alpaca_adapter<Transaction>::from_wire(const Wire &wire)
+    {
+        return std::make_shared<Transaction>(
+            wire.id,
+            wire.sender,
+            wire.receiver,
+            wire.value,
+            wire.fee);
+    }
+
+    alpaca_wire::BLSSigShare alpaca_adapter<BLSSigShare>::to_wire(const BLSSigShare &sig_share)
+    {
+        alpaca_wire::BLSSigShare wire;
+        std::memcpy(wire.g1.data(), (const void *)(sig_share.getSigShare().get()), wire.g1.size());
+        wire.hint = sig_share.getHint();
+        wire.signer_index = sig_share.getSignerIndex();
+        wire.t = sig_share.getRequiredSigners();
+        wire.n = sig_share.getTotalSigners();
+        return wire;
+    }
+
+    std::shared_ptr<BLSSigShare> alpaca_adapter<BLSSigShare>::from_wire(const Wire &wire)
+    {
+        auto g1 = std::make_shared<libff::alt_bn128_G1>();
+        std::memcpy((void *)(g1.get()), wire.g1.data(), wire.g1.size());
+        // the raw limbs are whatever the sender put there
+        if (!g1->is_well_formed())
+        {
+            spdlog::warn("sig share of signer {} is not on the curve", wire.signer_index);
+            return nullptr;
+        }
+
+        try
+        {
+            return std::make_shared<BLSSigShare>(g1, wire.hint, wire.signer_index, wire.t, wire.n);
+        }
+        catch (const std::exception &e)
+        {
+            // e.g. a signer index out of range
+            spdlog::warn("malformed sig share: {}", e.what());
+            return nullptr;
+        }
+    }
+
+    alpaca_wire::BlockVote alpaca_adapter<BlockVote>::to_wire(const BlockVote &vote)
+    {
+        alpaca_wire::BlockVote wire{vote.block_id_, vote.voter_id_, std::nullopt};
+        if (vote.sig_share_ != nullptr)
+        {
+            wire.sig_share = alpaca_adapter<BLSSigShare>::to_wire(*(vote.sig_share_));
+        }
+        return wire;
+    }
+
+    std::shared_ptr<BlockVote> alpaca_adapter<BlockVote>::from_wire(const Wire &wire)
+    {
+        auto sp_vote = std::make_shared<BlockVote>();
+        sp_vote->block_id_ = wire.block_id;
+        sp_vote->voter_id_ = wire.voter_id;
+        if (wire.sig_share.has_value())
+        {
+            sp_vote->sig_share_ = alpaca_adapter<BLSSigShare>::from_wire(*(wire.sig_share));
+            if (sp_vote->sig_share_ == nullptr)
+            {
+                return nullptr;
+            }
+        }
+        return sp_vote;
+    }
+
+    alpaca_wire::Block alpaca_adapter<Block>::to_wire(const Block &block)
+    {
+        EASY_FUNCTION("alpaca_adapter<Block>::to_wire");
+
+        alpaca_wire::Block wire;
+        wire.header = alpaca_adapter<BlockHeader>::to_wire(block.header_);
+
+        // same five uint64 fields in the same order
+        wire.txs.resize(block.tx_vec_.size());
+        if (!block.tx_vec_.empty())
+        {
+            std::memcpy(
+                (void *)(wire.txs.data()),
+                (const void *)(block.tx_vec_.data()),
+                block.tx_vec_.size() * sizeof(Transaction));
+        }
+
+        wire.votes.reserve(block.votes_.size());
+        for (const auto &iter : block.votes_)
+        {
+            wire.votes.push_back(alpaca_adapter<BlockVote>::to_wire(*(iter.second)));
+        }
+
+        return wire;
+    }
+
+    std::shared_ptr<Block> alpaca_adapter<Block>::from_wire(const Wire &wire)
+    {
+        EASY_FUNCTION("alpaca_adapter<Block>::from_wire");
+
+        auto block = std::make_shared<Block>();
+        block->header_ = *(alpaca_adapter<BlockHeader>::from_wire(wire.header));
+
+        block->tx_vec_.resize(wire.txs.size());
+        if (!wire.txs.empty())
+        {
+            std::memcpy(
+                (void *)(block->tx_vec_.data()),
+                (const void *)(wire.txs.data()),
+                wire.txs.size() * sizeof(Transaction));
+        }
+
+        for (const auto &wire_vote : wire.votes)
+        {
+            auto sp_vote = alpaca_adapter<BlockVote>::from_wire(wire_vote);
+            if (sp_vote == nullptr)
+            {
+                continue;
+            }
+            block->votes_.insert(
+                std::make_pair(
+                    wire_vote.voter_id,
+                    sp_vote));
+        }
+
+        return block;
+    }
+
+}
@@ -9,55 +9,158 @@ extern std::shared_ptr<nlohmann::json> conf_data;
 namespace tomchain
 {
 
-    Block::Block() {}
+    Block::Block()
+        : batch_index_(0),
+          is_batch_vote_(false),
+          announced_(false),
+          finalized_(false),
+          sig_acc_(libff::alt_bn128_G1::zero()),
+          sig_acc_count_(0),
+          payload_epoch_(0)
+    {
+    }
 
     Block::Block(uint64_t id, uint64_t base_id, uint64_t proposal_ts)
-        : header_({id, base_id, proposal_ts})
+        : header_({id, base_id, proposal_ts}),
+          batch_index_(0),
+          is_batch_vote_(false),
+          announced_(false),
+          finalized_(false),
+          sig_acc_(libff::alt_bn128_G1::zero()),
+          sig_acc_count_(0),
+          payload_epoch_(0)
     {
-        this->tx_vec_ = std::vector<
-            std::shared_ptr<Transaction>>();
     }
 
+    // the copy starts without a cached payload
     Block::Block(const Block& block)
+        : batch_index_(block.batch_index_),
+          is_batch_vote_(block.is_batch_vote_),
+          announced_(false),
+          finalized_(false),
+          sig_acc_(block.sig_acc_),
+          sig_acc_count_(block.sig_acc_count_),
+          payload_epoch_(0)
     {
         this->header_ = block.header_;
         this->tx_vec_ = block.tx_vec_;
         this->tss_sig_ = block.tss_sig_; 
         this->votes_ = block.votes_; 
+        this->batch_ = block.batch_; 
+        this->batch_proof_ = block.batch_proof_; 
     }
 
     Block::~Block()
     {
     }
 
-    void Block::insert(std::shared_ptr<Transaction> tx)
+    void Block::insert(const Transaction &tx)
     {
         this->tx_vec_.push_back(tx);
     }
 
-    std::shared_ptr<std::array<uint8_t, picosha2::k_digest_size>> Block::get_sha256()
+    std::shared_ptr<const std::string> Block::get_payload() const
     {
-        EASY_FUNCTION("get_sha256");
-         
-        std::vector<unsigned char> hash(picosha2::k_digest_size);
+        std::shared_ptr<const EncodedPayload> payload = 
+            payload_.load(std::memory_order_acquire);
+        if (payload == nullptr || 
+            payload->epoch != payload_epoch_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        // aliasing constructor: keeps the whole entry alive
+        return std::shared_ptr<const std::string>(payload, &(payload->bytes));
+    }
 
-        msgpack::sbuffer b;
-        msgpack::pack(b, *this);
-        std::string ss_str = sbufferToString(b);
+    std::shared_ptr<const std::string> Block::set_payload(uint64_t epoch, std::string&& bytes) const
+    {
+        auto payload = std::make_shared<const EncodedPayload>(
+            EncodedPayload{epoch, std::move(bytes)});
+        payload_.store(payload, std::memory_order_release);
+        return std::shared_ptr<const std::string>(payload, &(payload->bytes));
+    }
 
-        picosha2::hash256(ss_str.begin(), ss_str.end(), hash.begin(), hash.end());
+    uint64_t Block::payload_epoch() const
+    {
+        return payload_epoch_.load(std::memory_order_acquire);
+    }
 
-        std::array<uint8_t, picosha2::k_digest_size> hash_arr;
-        std::copy_n(hash.begin(), picosha2::k_digest_size, hash_arr.begin());
+    void Block::invalidate_payload()
+    {
+        payload_epoch_.fetch_add(1, std::memory_order_acq_rel);
+        payload_.store(nullptr, std::memory_order_release);
+    }
+
+    std::shared_ptr<std::array<uint8_t, picosha2::k_digest_size>> Block::get_sha256()
+    {
+        EASY_FUNCTION("get_sha256");
+
+        if (!this->is_sealed())
+        {
+            this->seal();
+        }
 
         std::shared_ptr<std::array<uint8_t, picosha2::k_digest_size>> spHashArr =
-            std::make_shared<std::array<uint8_t, picosha2::k_digest_size>>(hash_arr);
+            std::make_shared<std::array<uint8_t, picosha2::k_digest_size>>(header_.digest_);
         return spHashArr;
     }
 
+    sha256::digest Block::compute_digest(const BlockHeader& header)
+    {
+        EASY_FUNCTION("compute_digest");
+
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, 
+            "fields are hashed as laid out in memory"); 
+        static const char domain[] = "tomchain/block/v2"; 
+
+        const uint64_t fields[3] = {header.id_, header.base_id_, header.tx_count_}; 
+
+        sha256::context ctx; 
+        ctx.update((const uint8_t*)domain, sizeof(domain)); 
+        ctx.update((const uint8_t*)fields, sizeof(fields)); 
+        ctx.update(header.tx_root_.data(), header.tx_root_.size()); 
+        return ctx.finish(); 
+    }
+
+    void Block::seal()
+    {
+        EASY_FUNCTION("seal");
+
+        header_.tx_count_ = tx_vec_.size(); 
+        header_.tx_root_ = merkle::root(tx_vec_); 
+        header_.digest_ = Block::compute_digest(header_); 
+    }
+
+    bool Block::is_sealed() const
+    {
+        return header_.digest_ != sha256::digest{}; 
+    }
+
+    bool Block::verify_header(const BlockHeader& header)
+    {
+        return header.digest_ != sha256::digest{} && 
+            Block::compute_digest(header) == header.digest_; 
+    }
+
+    bool Block::verify_body() const
+    {
+        return header_.tx_count_ == tx_vec_.size() && 
+            merkle::root(tx_vec_) == header_.tx_root_; 
+    }
+
+    bool Block::verify_digest() const
+    {
+        return Block::verify_header(header_) && this->verify_body(); 
+    }
+
     std::set<uint64_t> Block::get_server_id(uint64_t server_count) const
     {
-        uint64_t primary_id = (this->header_.id_ % server_count) + 1;
+        return Block::get_server_id(this->header_.id_, server_count);
+    }
+
+    std::set<uint64_t> Block::get_server_id(uint64_t block_id, uint64_t server_count)
+    {
+        uint64_t primary_id = (block_id % server_count) + 1;
         uint64_t shadow_id = primary_id + 1; 
         if (shadow_id > server_count)
         {
@@ -69,48 +172,229 @@ namespace tomchain
         return server_id_list;
     }
 
+    uint64_t Block::batch_first_id(uint64_t block_id, uint64_t batch_size, uint64_t server_count)
+    {
+        const uint64_t lane = block_id % server_count; 
+        const uint64_t step = block_id / server_count; 
+        return lane + server_count * (step - step % batch_size); 
+    }
+
+    uint64_t Block::batch_member_id(uint64_t first_id, uint64_t index, uint64_t server_count)
+    {
+        return first_id + index * server_count; 
+    }
+
+    uint64_t Block::batch_index(uint64_t block_id, uint64_t batch_size, uint64_t server_count)
+    {
+        return (block_id / server_count) % batch_size; 
+    }
+
+    bool Block::verify_batch_proof() const
+    {
+        if (this->batch_ == nullptr || this->batch_index_ >= this->batch_->size)
+        {
+            return false; 
+        }
+        return merkle::verify(
+            this->batch_->root, 
+            this->batch_->size, 
+            this->batch_index_, 
+            &this->header_.digest_, 
+            1, 
+            this->batch_proof_); 
+    }
+
     bool Block::is_vote_enough(const uint64_t target_num) const
     {
         spdlog::trace("{}: Block::is_vote_enough()", target_num); 
         return votes_.size() >= target_num;
     }
 
-    void Block::merge_votes(const uint64_t target_num)
+    bool Block::fold_share(const BlockVote& vote, bool add)
+    {
+        auto coeffs = lagrange::cached(); 
+        if (coeffs == nullptr || vote.sig_share_ == nullptr)
+        {
+            return false; 
+        }
+        // signer index starts from one
+        const size_t signer_index = vote.sig_share_->getSignerIndex(); 
+        if (signer_index == 0 || signer_index > coeffs->size())
+        {
+            return false; 
+        }
+
+        const libff::alt_bn128_G1 term = 
+            coeffs->at(signer_index - 1) * *(vote.sig_share_->getSigShare()); 
+        sig_acc_ = add ? sig_acc_ + term : sig_acc_ - term; 
+        return true; 
+    }
+
+    bool Block::add_vote(uint64_t key, std::shared_ptr<BlockVote> vote)
+    {
+        EASY_FUNCTION("add_vote");
+
+        // only extend an aggregate that covers every vote so far
+        const bool is_complete = sig_acc_count_ == votes_.size(); 
+        if (!votes_.insert(std::make_pair(key, vote)).second)
+        {
+            return false; 
+        }
+        if (is_complete && this->fold_share(*vote, true))
+        {
+            sig_acc_count_++; 
+        }
+        return true; 
+    }
+
+    void Block::remove_vote(uint64_t key)
+    {
+        auto iter = votes_.find(key); 
+        if (iter == votes_.end())
+        {
+            return; 
+        }
+        const bool is_complete = sig_acc_count_ == votes_.size(); 
+        if (is_complete && this->fold_share(*(iter->second), false))
+        {
+            sig_acc_count_--; 
+        }
+        else
+        {
+            // rebuilt at merge time
+            sig_acc_ = libff::alt_bn128_G1::zero(); 
+            sig_acc_count_ = 0; 
+        }
+        votes_.erase(iter); 
+    }
+
+    void Block::merge_votes(const uint64_t required, const uint64_t total, size_t merge_threads)
     {
         EASY_FUNCTION("merge_votes");
-        spdlog::trace("{}: merge votes", target_num); 
+        spdlog::trace("{}/{}: merge votes", required, total); 
+
+        if (!this->is_vote_enough(required))
+        {
+            return; 
+        }
+
+        auto coeffs = lagrange::cached(); 
+        if (required == total && coeffs != nullptr && coeffs->size() == total)
+        {
+            // votes decoded from a peer were not folded on arrival; 
+            // recover them in one multi-scalar multiplication 
+            if (sig_acc_count_ != votes_.size())
+            {
+                EASY_BLOCK("rebuild aggregate");
+                std::vector<libff::alt_bn128_G1> points; 
+                std::vector<libff::alt_bn128_Fr> scalars; 
+                points.reserve(votes_.size()); 
+                scalars.reserve(votes_.size()); 
+                for (auto vote_iter = votes_.begin(); vote_iter != votes_.end(); vote_iter++)
+                {
+                    const std::shared_ptr<BLSSigShare>& share = vote_iter->second->sig_share_; 
+                    if (share == nullptr || 
+                        share->getSignerIndex() == 0 || 
+                        share->getSignerIndex() > coeffs->size())
+                    {
+                        continue; 
+                    }
+                    points.push_back(*(share->getSigShare())); 
+                    scalars.push_back(coeffs->at(share->getSignerIndex() - 1)); 
+                }
+                sig_acc_ = msm::multi_exp(points, scalars); 
+                sig_acc_count_ = points.size(); 
+                EASY_END_BLOCK;
+            }
+
+            if (sig_acc_count_ == votes_.size())
+            {
+                this->set_tss_sig(sig_acc_, required, total); 
+                return; 
+            }
+        }
+        else if (required < total)
+        {
+            // the quorum is the first `required` votes in voter-id order 
+            EASY_BLOCK("interpolate quorum");
+            std::vector<libff::alt_bn128_G1> points; 
+            std::vector<uint64_t> indices; 
+            points.reserve(required); 
+            indices.reserve(required); 
+            for (auto vote_iter = votes_.begin(); 
+                 vote_iter != votes_.end() && indices.size() < required; 
+                 vote_iter++)
+            {
+                const std::shared_ptr<BLSSigShare>& share = vote_iter->second->sig_share_; 
+                if (share == nullptr || 
+                    share->getSignerIndex() == 0 || 
+                    share->getSignerIndex() > total)
+                {
+                    continue; 
+                }
+                points.push_back(*(share->getSigShare())); 
+                indices.push_back(share->getSignerIndex()); 
+            }
+            const bool is_complete = indices.size() == required; 
+            libff::alt_bn128_G1 sig = libff::alt_bn128_G1::zero(); 
+            if (is_complete)
+            {
+                sig = msm::multi_exp(points, lagrange::coefficients(indices)); 
+            }
+            EASY_END_BLOCK;
+
+            if (is_complete)
+            {
+                this->set_tss_sig(sig, required, total); 
+                return; 
+            }
+        }
 
         BLSSigShareSet sig_share_set(
-            target_num,
-            target_num);
+            required,
+            total);
 
         // unsafe iterations on concurrent hash map
         // but it is locked by pb_accessor
-        spdlog::trace("{}: iterate chm", target_num); 
+        spdlog::trace("{}/{}: iterate chm", required, total); 
         for (
             auto vote_iter = votes_.begin();
-            vote_iter != votes_.end();
+            vote_iter != votes_.end() && !sig_share_set.isEnough();
             vote_iter++)
         {
             sig_share_set.addSigShare(
                 vote_iter->second->sig_share_);
         }
 
-        spdlog::trace("{}: check sig enough", target_num); 
+        spdlog::trace("{}/{}: check sig enough", required, total); 
         if (sig_share_set.isEnough())
         {
             // merge signature
-            // size_t merge_threads = (*::conf_data)["merge-threads"]; 
-            spdlog::trace("{}: merge sigset", target_num); 
-            std::shared_ptr<BLSSignature> tss_sig = sig_share_set.merge(16);
-            spdlog::trace("{}: merge complete", target_num); 
+            spdlog::trace("{}/{}: merge sigset", required, total); 
+            std::shared_ptr<BLSSignature> tss_sig = sig_share_set.merge(merge_threads);
+            spdlog::trace("{}/{}: merge complete", required, total); 
             this->tss_sig_ = tss_sig;
+            this->invalidate_payload();
         }
     }
 
+    void Block::set_tss_sig(libff::alt_bn128_G1 sig, const uint64_t required, const uint64_t total)
+    {
+        sig.to_affine_coordinates(); 
+        std::string hint = votes_.begin()->second->sig_share_->getHint(); 
+        this->tss_sig_ = std::make_shared<BLSSignature>(
+            std::make_shared<libff::alt_bn128_G1>(sig), 
+            hint, 
+            required, 
+            total); 
+        this->invalidate_payload(); 
+    }
+
     BlockVote::BlockVote() {
         block_id_ = 0;
         voter_id_ = 0; 
+        batch_size_ = 0; 
+        batch_root_.fill(0); 
     }
 
     BlockVote::BlockVote(const BlockVote& bv)
@@ -118,6 +402,8 @@ namespace tomchain
         this->block_id_ = bv.block_id_;
         this->voter_id_ = bv.voter_id_;
         this->sig_share_ = bv.sig_share_;
+        this->batch_size_ = bv.batch_size_; 
+        this->batch_root_ = bv.batch_root_; 
     }
 
     BlockHeader::BlockHeader() {
@@ -127,6 +413,9 @@ namespace tomchain
         dist_ts_ = 0;
         commit_ts_ = 0;
         recv_ts_ = 0;
+        tx_count_ = 0; 
+        tx_root_.fill(0); 
+        digest_.fill(0); 
     }
 
     BlockHeader::BlockHeader(uint64_t id, uint64_t base_id, uint64_t proposal_ts)
@@ -135,6 +424,9 @@ namespace tomchain
         this->dist_ts_ = 0; 
         this->commit_ts_ = 0; 
         this->recv_ts_ = 0; 
+        this->tx_count_ = 0; 
+        this->tx_root_.fill(0); 
+        this->digest_.fill(0); 
     }
 
     BlockHeader::BlockHeader(const BlockHeader& bh)
@@ -145,6 +437,9 @@ namespace tomchain
         this->dist_ts_ = bh.dist_ts_;
         this->commit_ts_ = bh.commit_ts_;
         this->recv_ts_ = bh.recv_ts_; 
+        this->tx_count_ = bh.tx_count_; 
+        this->tx_root_ = bh.tx_root_; 
+        this->digest_ = bh.digest_; 
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "block_view.hpp"
+#include "flatbuffers_adapter.hpp"
+
+#include <cstring>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    BlockView::BlockView(const uint8_t *data, size_t size)
+        : data_(data), size_(size)
+    {
+        // too short to hold the root offset
+        root_ = size_ < sizeof(flatbuffers::uoffset_t) ? nullptr : flatbuffers::GetRoot<fb::Block>(data_);
+    }
+
+    BlockView::BlockView(const std::string &bytes)
+        : BlockView((const uint8_t *)(bytes.data()), bytes.size())
+    {
+    }
+
+    BlockView::BlockView(const fb::Block *root)
+        : data_(nullptr), size_(0), root_(root)
+    {
+    }
+
+    bool BlockView::verify() const
+    {
+        if (root_ == nullptr)
+        {
+            return false;
+        }
+        if (data_ != nullptr)
+        {
+            // a nested view is covered by the enclosing message
+            flatbuffers::Verifier verifier(data_, size_);
+            if (!verifier.VerifyBuffer<fb::Block>(nullptr))
+            {
+                return false;
+            }
+        }
+        // the accessors take the header for granted
+        return root_->header() != nullptr;
+    }
+
+    uint64_t BlockView::id() const
+    {
+        return root_->header()->id();
+    }
+
+    const fb::BlockHeader *BlockView::header() const
+    {
+        return root_->header();
+    }
+
+    BlockHeader BlockView::to_header() const
+    {
+        return *(flatbuffers_adapter<BlockHeader>::from_fb(root_->header()));
+    }
+
+    size_t BlockView::tx_count() const
+    {
+        auto tx_columns = root_->tx_columns();
+        if (tx_columns != nullptr)
+        {
+            return tx_codec::count(tx_columns->data(), tx_columns->size());
+        }
+        auto txs = root_->txs();
+        return txs == nullptr ? 0 : txs->size();
+    }
+
+    bool BlockView::has_tx_columns() const
+    {
+        return root_->tx_columns() != nullptr;
+    }
+
+    bool BlockView::decode_tx_columns(tx_codec::columns &out) const
+    {
+        auto tx_columns = root_->tx_columns();
+        if (tx_columns == nullptr)
+        {
+            return false;
+        }
+        return tx_codec::decode(tx_columns->data(), tx_columns->size(), out);
+    }
+
+    const fb::Transaction &BlockView::tx_at(size_t index) const
+    {
+        return *(root_->txs()->Get(index));
+    }
+
+    size_t BlockView::vote_count() const
+    {
+        auto votes = root_->votes();
+        return votes == nullptr ? 0 : votes->size();
+    }
+
+    const fb::BlockVote *BlockView::find_vote(uint64_t voter_id) const
+    {
+        auto votes = root_->votes();
+        if (votes == nullptr)
+        {
+            return nullptr;
+        }
+        // votes are written as a sorted vector keyed by voter id
+        return votes->LookupByKey(voter_id);
+    }
+
+    std::shared_ptr<BlockVote> BlockView::get_vote(uint64_t voter_id) const
+    {
+        auto vote = this->find_vote(voter_id);
+        if (vote == nullptr)
+        {
+            return nullptr;
+        }
+        return flatbuffers_adapter<BlockVote>::from_fb(vote);
+    }
+
+    bool BlockView::copy_commit(Block &block) const
+    {
+        auto tss_sig = root_->tss_sig();
+        if (tss_sig == nullptr || tss_sig->point() == nullptr ||
+            tss_sig->point()->limbs() == nullptr ||
+            tss_sig->point()->limbs()->size() != sizeof(libff::alt_bn128_G1))
+        {
+            return false;
+        }
+
+        std::shared_ptr<BLSSignature> sig;
+        try
+        {
+            sig = flatbuffers_adapter<BLSSignature>::from_fb(tss_sig);
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::warn("block {}: malformed tss_sig: {}", this->id(), e.what());
+            return false;
+        }
+
+        std::shared_ptr<const BatchCert> batch;
+        std::vector<merkle::digest> batch_proof;
+        auto fb_batch = root_->batch();
+        if (fb_batch != nullptr)
+        {
+            BatchCert cert{fb_batch->first_id(), fb_batch->size(), {}};
+            if (fb_batch->root() != nullptr)
+            {
+                std::memcpy(cert.root.data(), fb_batch->root()->bytes()->data(), sha256::digest_size);
+            }
+            batch = std::make_shared<const BatchCert>(cert);
+            auto fb_proof = root_->batch_proof();
+            if (fb_proof != nullptr)
+            {
+                batch_proof.resize(fb_proof->size());
+                std::memcpy(
+                    (void *)(batch_proof.data()),
+                    fb_proof->Data(),
+                    fb_proof->size() * sha256::digest_size);
+            }
+        }
+
+        block.tss_sig_ = std::move(sig);
+        block.batch_ = std::move(batch);
+        block.batch_index_ = root_->batch_index();
+        block.batch_proof_ = std::move(batch_proof);
+        block.invalidate_payload();
+        return true;
+    }
+
+    std::shared_ptr<Block> BlockView::to_block() const
+    {
+        EASY_FUNCTION("BlockView::to_block");
+
+        auto block = std::make_shared<Block>();
+        block->header_ = this->to_header();
+
+        EASY_BLOCK("tx_vec");
+        if (this->has_tx_columns())
+        {
+            static thread_local tx_codec::columns columns;
+            if (!this->decode_tx_columns(columns))
+            {
+                spdlog::error("block {}: malformed tx columns", this->id());
+                columns = tx_codec::columns();
+            }
+            const size_t tx_count = columns.size();
+            block->tx_vec_.resize(tx_count);
+            for (size_t i = 0; i < tx_count; i++)
+            {
+                Transaction &tx = block->tx_vec_[i];
+                tx.id_ = columns.id[i];
+                tx.sender_ = columns.sender[i];
+                tx.receiver_ = columns.receiver[i];
+                tx.value_ = columns.value[i];
+                tx.fee_ = columns.fee[i];
+            }
+        }
+        else
+        {
+            const size_t tx_count = this->tx_count();
+            block->tx_vec_.resize(tx_count);
+            if (tx_count > 0)
+            {
+                // fb::Transaction has the layout of Transaction (see
+                // flatbuffers_adapter.cpp), so the rows are one copy
+                std::memcpy(
+                    (void *)(block->tx_vec_.data()),
+                    root_->txs()->Data(),
+                    tx_count * sizeof(Transaction));
+            }
+        }
+        EASY_END_BLOCK;
+
+        EASY_BLOCK("votes");
+        auto votes = root_->votes();
+        if (votes != nullptr)
+        {
+            for (auto vote : *votes)
+            {
+                std::shared_ptr<BlockVote> sp_vote = flatbuffers_adapter<BlockVote>::from_fb(vote);
+                if (sp_vote == nullptr)
+                {
+                    continue;
+                }
+                block->votes_.insert(std::make_pair(vote->voterid(), sp_vote));
+            }
+        }
+        EASY_END_BLOCK;
+
+        this->copy_commit(*block);
+
+        return block;
+    }
+
+}
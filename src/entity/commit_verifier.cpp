@@ -0,0 +1,55 @@
+#include "commit_verifier.hpp"
+
+#include <memory>
+#include "libBLS/tools/utils.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    CommitVerifier::CommitVerifier(const libff::alt_bn128_G2 &group_pkey)
+    {
+        pkey_valid_ = !group_pkey.is_zero() && group_pkey.is_well_formed();
+        generator_lines_ = libff::alt_bn128_precompute_G2(libff::alt_bn128_G2::one());
+        if (pkey_valid_)
+        {
+            pkey_lines_ = libff::alt_bn128_precompute_G2(group_pkey);
+        }
+    }
+
+    bool CommitVerifier::verify(const std::array<uint8_t, 32> &hash, const libff::alt_bn128_G1 &sig) const
+    {
+        EASY_FUNCTION("CommitVerifier::verify");
+
+        if (!pkey_valid_ || sig.is_zero() || !sig.is_well_formed())
+        {
+            return false;
+        }
+
+        const libff::alt_bn128_G1 hash_point = ThresholdUtils::HashtoG1(
+            std::make_shared<std::array<uint8_t, 32>>(hash));
+
+        const libff::alt_bn128_Fq12 f = libff::alt_bn128_double_miller_loop(
+            libff::alt_bn128_precompute_G1(sig),
+            generator_lines_,
+            libff::alt_bn128_precompute_G1(-hash_point),
+            pkey_lines_);
+        return libff::alt_bn128_final_exponentiation(f) == libff::alt_bn128_GT::one();
+    }
+
+    bool CommitVerifier::verify(const Block &block) const
+    {
+        if (block.tss_sig_ == nullptr || block.tss_sig_->getSig() == nullptr)
+        {
+            return false;
+        }
+        if (block.batch_ != nullptr)
+        {
+            return block.verify_batch_proof() &&
+                   this->verify(block.batch_->root, *(block.tss_sig_->getSig()));
+        }
+        return block.is_sealed() &&
+               this->verify(block.header_.digest_, *(block.tss_sig_->getSig()));
+    }
+
+}
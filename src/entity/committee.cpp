@@ -0,0 +1,130 @@
+#include "committee.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    namespace
+    {
+        uint64_t splitmix64(uint64_t &state)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+    }
+
+    std::vector<uint64_t> committee::members(
+        uint64_t block_id,
+        uint64_t seed,
+        uint64_t client_count,
+        uint64_t size)
+    {
+        EASY_FUNCTION("committee::members");
+
+        std::vector<uint64_t> picked;
+        if (size == 0 || size >= client_count)
+        {
+            picked.resize(client_count);
+            for (uint64_t i = 0; i < client_count; i++)
+            {
+                picked[i] = i + 1;
+            }
+            return picked;
+        }
+
+        // mix the block id in once, so neighbouring ids diverge at once
+        uint64_t state = seed;
+        state ^= splitmix64(state) ^ block_id;
+        splitmix64(state);
+
+        // Floyd: for j in (n - k, n], take a random r in [1, j], or j
+        // itself if r was already taken
+        std::unordered_set<uint64_t> taken;
+        taken.reserve(size * 2);
+        picked.reserve(size);
+        for (uint64_t j = client_count - size + 1; j <= client_count; j++)
+        {
+            const uint64_t r = 1 + splitmix64(state) % j;
+            const uint64_t pick = taken.insert(r).second ? r : j;
+            if (pick == j)
+            {
+                taken.insert(j);
+            }
+            picked.push_back(pick);
+        }
+        std::sort(picked.begin(), picked.end());
+        return picked;
+    }
+
+    bool committee::contains(
+        uint64_t block_id,
+        uint64_t seed,
+        uint64_t client_count,
+        uint64_t size,
+        uint64_t client_id)
+    {
+        if (client_id == 0 || client_id > client_count)
+        {
+            return false;
+        }
+        if (size == 0 || size >= client_count)
+        {
+            return true;
+        }
+        const std::vector<uint64_t> picked =
+            committee::members(block_id, seed, client_count, size);
+        return std::binary_search(picked.begin(), picked.end(), client_id);
+    }
+
+    committee_cache::committee_cache(uint64_t seed, uint64_t client_count, uint64_t size, size_t slots)
+        : seed_(seed),
+          client_count_(client_count),
+          size_(size),
+          slot_count_(std::max<size_t>(1, slots)),
+          slots_(new slot[std::max<size_t>(1, slots)])
+    {
+    }
+
+    std::shared_ptr<const std::vector<uint64_t>> committee_cache::members(uint64_t block_id)
+    {
+        // block ids of one proposer are dense, spread them over the slots
+        uint64_t state = block_id;
+        slot &s = slots_[splitmix64(state) % slot_count_];
+
+        std::unique_lock<std::mutex> lock(s.mu);
+        if (s.members != nullptr && s.block_id == block_id)
+        {
+            return s.members;
+        }
+        lock.unlock();
+
+        // sample outside the lock; a racing miss just samples twice
+        auto picked = std::make_shared<const std::vector<uint64_t>>(
+            committee::members(block_id, seed_, client_count_, size_));
+
+        lock.lock();
+        s.block_id = block_id;
+        s.members = picked;
+        return picked;
+    }
+
+    bool committee_cache::contains(uint64_t block_id, uint64_t client_id)
+    {
+        if (client_id == 0 || client_id > client_count_)
+        {
+            return false;
+        }
+        if (size_ == 0 || size_ >= client_count_)
+        {
+            return true;
+        }
+        const std::shared_ptr<const std::vector<uint64_t>> picked = this->members(block_id);
+        return std::binary_search(picked->begin(), picked->end(), client_id);
+    }
+
+}
@@ -0,0 +1,340 @@
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    std::shared_ptr<BLSSigShare> flatbuffers_adapter<BLSSigShare>::from_fb(const fb::BLSSigShare *sig_share)
+    {
+        static_assert(sizeof(libff::alt_bn128_G1) == 96);
+        if (sig_share == nullptr || sig_share->point() == nullptr ||
+            sig_share->point()->limbs() == nullptr ||
+            sig_share->point()->limbs()->size() != sizeof(libff::alt_bn128_G1) ||
+            sig_share->hint() == nullptr)
+        {
+            return nullptr;
+        }
+        auto limbs = sig_share->point()->limbs();
+        auto g1 = std::make_shared<libff::alt_bn128_G1>();
+        std::memcpy((void *)(g1.get()), limbs->data(), sizeof(libff::alt_bn128_G1));
+
+        std::string hint = sig_share->hint()->str();
+
+        try
+        {
+            return std::make_shared<BLSSigShare>(
+                g1,
+                hint,
+                sig_share->signer_index(),
+                sig_share->t(),
+                sig_share->n());
+        }
+        catch (const std::exception &e)
+        {
+            // e.g. a signer index out of range
+            spdlog::warn("malformed sig share: {}", e.what());
+            return nullptr;
+        }
+    }
+
+    flatbuffers::Offset<fb::BLSSigShare> flatbuffers_adapter<BLSSigShare>::build(flatbuffers::FlatBufferBuilder &fbb, const BLSSigShare &sig_share)
+    {
+        std::shared_ptr<libff::alt_bn128_G1> g1 = sig_share.getSigShare();
+        static_assert(sizeof(libff::alt_bn128_G1) == 96);
+        auto limbs = fbb.CreateVector((const uint8_t *)(g1.get()), sizeof(libff::alt_bn128_G1));
+        auto point = fb::CreateAltBn128G1(fbb, limbs);
+        auto hint = fbb.CreateString(sig_share.getHint());
+
+        return fb::CreateBLSSigShare(
+            fbb,
+            point,
+            hint,
+            sig_share.getRequiredSigners(),
+            sig_share.getTotalSigners(),
+            sig_share.getSignerIndex());
+    }
+
+    std::shared_ptr<BLSSignature> flatbuffers_adapter<BLSSignature>::from_fb(const fb::BLSSignature *sig)
+    {
+        if (sig == nullptr || sig->point() == nullptr ||
+            sig->point()->limbs() == nullptr ||
+            sig->point()->limbs()->size() != sizeof(libff::alt_bn128_G1))
+        {
+            return nullptr;
+        }
+        auto limbs = sig->point()->limbs();
+        auto g1 = std::make_shared<libff::alt_bn128_G1>();
+        std::memcpy((void *)(g1.get()), limbs->data(), sizeof(libff::alt_bn128_G1));
+
+        std::string hint = sig->hint() == nullptr ? std::string() : sig->hint()->str();
+
+        return std::make_shared<BLSSignature>(g1, hint, sig->t(), sig->n());
+    }
+
+    flatbuffers::Offset<fb::BLSSignature> flatbuffers_adapter<BLSSignature>::build(flatbuffers::FlatBufferBuilder &fbb, const BLSSignature &sig)
+    {
+        std::shared_ptr<libff::alt_bn128_G1> g1 = sig.getSig();
+        static_assert(sizeof(libff::alt_bn128_G1) == 96);
+        auto limbs = fbb.CreateVector((const uint8_t *)(g1.get()), sizeof(libff::alt_bn128_G1));
+        auto point = fb::CreateAltBn128G1(fbb, limbs);
+        auto hint = fbb.CreateString(sig.getHint());
+
+        return fb::CreateBLSSignature(
+            fbb,
+            point,
+            hint,
+            sig.getRequiredSigners(),
+            sig.getTotalSigners());
+    }
+
+    std::shared_ptr<BlockVote> flatbuffers_adapter<BlockVote>::from_fb(const fb::BlockVote *vote)
+    {
+        auto sp_vote = std::make_shared<BlockVote>();
+        sp_vote->block_id_ = vote->blockid();
+        sp_vote->voter_id_ = vote->voterid();
+        if (vote->sigshare() != nullptr)
+        {
+            // Block::fold_share() weighs the share by its signer index
+            if (vote->sigshare()->signer_index() != vote->voterid())
+            {
+                spdlog::warn("vote {}:{} has signer index {}",
+                             vote->blockid(), vote->voterid(), vote->sigshare()->signer_index());
+                return nullptr;
+            }
+            sp_vote->sig_share_ = flatbuffers_adapter<BLSSigShare>::from_fb(vote->sigshare());
+            if (sp_vote->sig_share_ == nullptr)
+            {
+                return nullptr;
+            }
+        }
+        return sp_vote;
+    }
+
+    flatbuffers::Offset<fb::BlockVote> flatbuffers_adapter<BlockVote>::build(flatbuffers::FlatBufferBuilder &fbb, const BlockVote &vote)
+    {
+        flatbuffers::Offset<fb::BLSSigShare> sig_share = 0;
+        if (vote.sig_share_ != nullptr)
+        {
+            sig_share = flatbuffers_adapter<BLSSigShare>::build(fbb, *(vote.sig_share_));
+        }
+        return fb::CreateBlockVote(fbb, vote.block_id_, vote.voter_id_, sig_share);
+    }
+
+    std::shared_ptr<BlockHeader> flatbuffers_adapter<BlockHeader>::from_fb(const fb::BlockHeader *bh)
+    {
+        std::shared_ptr<BlockHeader> sp_bh = std::make_shared<BlockHeader>();
+        sp_bh->id_ = bh->id();
+        sp_bh->base_id_ = bh->base_id();
+        sp_bh->proposal_ts_ = bh->proposal_ts();
+        sp_bh->dist_ts_ = bh->dist_ts();
+        sp_bh->commit_ts_ = bh->commit_ts();
+        sp_bh->recv_ts_ = bh->recv_ts();
+        if (bh->digest() != nullptr)
+        {
+            std::memcpy(sp_bh->digest_.data(), bh->digest()->bytes()->data(), sha256::digest_size);
+        }
+        sp_bh->tx_count_ = bh->tx_count();
+        if (bh->tx_root() != nullptr)
+        {
+            std::memcpy(sp_bh->tx_root_.data(), bh->tx_root()->bytes()->data(), sha256::digest_size);
+        }
+        return sp_bh;
+    }
+
+    flatbuffers::Offset<fb::BlockHeader> flatbuffers_adapter<BlockHeader>::build(flatbuffers::FlatBufferBuilder &fbb, const BlockHeader &bh)
+    {
+        const fb::Digest digest(flatbuffers::make_span(bh.digest_));
+        const fb::Digest tx_root(flatbuffers::make_span(bh.tx_root_));
+        const bool sealed = bh.digest_ != sha256::digest{};
+        return fb::CreateBlockHeader(
+            fbb,
+            bh.id_,
+            bh.base_id_,
+            bh.proposal_ts_,
+            bh.dist_ts_,
+            bh.commit_ts_,
+            bh.recv_ts_,
+            sealed ? &digest : nullptr,
+            bh.tx_count_,
+            sealed ? &tx_root : nullptr);
+    }
+
+    flatbuffers::Offset<fb::Block> flatbuffers_adapter<Block>::build(flatbuffers::FlatBufferBuilder &fbb, const Block &block)
+    {
+        EASY_BLOCK("header");
+        auto header = flatbuffers_adapter<BlockHeader>::build(fbb, block.header_);
+        EASY_END_BLOCK;
+
+        EASY_BLOCK("tx_vec");
+        flatbuffers::Offset<flatbuffers::Vector<const fb::Transaction *>> txs;
+        flatbuffers::Offset<flatbuffers::Vector<uint8_t>> tx_columns;
+        if (flatbuffers_adapter<Block>::tx_layout() == tx_codec::layout::columns)
+        {
+            static thread_local std::string column_buf;
+            tx_codec::encode(block.tx_vec_, column_buf);
+            tx_columns = fbb.CreateVector(
+                (const uint8_t *)(column_buf.data()),
+                column_buf.size());
+        }
+        else
+        {
+            // same field order and width, so the rows are copied as is
+            txs = fbb.CreateVectorOfStructs(
+                reinterpret_cast<const fb::Transaction *>(block.tx_vec_.data()),
+                block.tx_vec_.size());
+        }
+        EASY_END_BLOCK;
+
+        EASY_BLOCK("votes");
+        std::vector<flatbuffers::Offset<fb::BlockVote>> vote_vec;
+        vote_vec.reserve(block.votes_.size());
+        for (auto iter : block.votes_)
+        {
+            vote_vec.push_back(
+                flatbuffers_adapter<BlockVote>::build(fbb, *(iter.second)));
+        }
+        auto votes = fbb.CreateVectorOfSortedTables(&vote_vec);
+        EASY_END_BLOCK;
+
+        // commit certificate
+        flatbuffers::Offset<fb::BLSSignature> tss_sig = 0;
+        if (block.tss_sig_ != nullptr)
+        {
+            tss_sig = flatbuffers_adapter<BLSSignature>::build(fbb, *(block.tss_sig_));
+        }
+        flatbuffers::Offset<fb::BatchCert> batch = 0;
+        flatbuffers::Offset<flatbuffers::Vector<const fb::Digest *>> batch_proof = 0;
+        if (block.batch_ != nullptr)
+        {
+            const fb::Digest root(flatbuffers::make_span(block.batch_->root));
+            batch = fb::CreateBatchCert(fbb, block.batch_->first_id, block.batch_->size, &root);
+            batch_proof = fbb.CreateVectorOfStructs(
+                reinterpret_cast<const fb::Digest *>(block.batch_proof_.data()),
+                block.batch_proof_.size());
+        }
+
+        return fb::CreateBlock(
+            fbb,
+            header,
+            txs,
+            votes,
+            tx_columns,
+            tss_sig,
+            batch,
+            block.batch_ == nullptr ? 0 : block.batch_index_,
+            batch_proof);
+    }
+
+    namespace
+    {
+        static_assert(FLATBUFFERS_LITTLEENDIAN,
+                      "fb::Transaction rows are copied without byte swapping");
+        static_assert(sizeof(fb::Transaction) == sizeof(Transaction));
+        static_assert(sizeof(fb::Digest) == sizeof(merkle::digest));
+        static_assert(offsetof(Transaction, id_) == 0 &&
+                      offsetof(Transaction, sender_) == 8 &&
+                      offsetof(Transaction, receiver_) == 16 &&
+                      offsetof(Transaction, value_) == 24 &&
+                      offsetof(Transaction, fee_) == 32);
+
+        std::atomic<tx_codec::layout> block_tx_layout{tx_codec::layout::rows};
+    }
+
+    void flatbuffers_adapter<Block>::set_tx_layout(tx_codec::layout layout)
+    {
+        block_tx_layout.store(layout, std::memory_order_relaxed);
+    }
+
+    tx_codec::layout flatbuffers_adapter<Block>::tx_layout()
+    {
+        return block_tx_layout.load(std::memory_order_relaxed);
+    }
+
+    namespace
+    {
+        flatbuffers::FlatBufferBuilder &thread_builder()
+        {
+            static thread_local flatbuffers::FlatBufferBuilder fbb(64 * 1024);
+            fbb.Clear();
+            return fbb;
+        }
+    }
+
+    void flatbuffers_adapter<Block>::to_bytes(const Block &block, std::string &out)
+    {
+        spdlog::trace("flatbuffers_adapter<Block>::to_bytes start");
+
+        flatbuffers::FlatBufferBuilder &fbb = thread_builder();
+        fbb.Finish(flatbuffers_adapter<Block>::build(fbb, block));
+        out.assign((const char *)(fbb.GetBufferPointer()), fbb.GetSize());
+
+        spdlog::trace("flatbuffers_adapter<Block>::to_bytes end");
+    }
+
+    std::shared_ptr<const std::string> flatbuffers_adapter<Block>::payload(const Block &block)
+    {
+        std::shared_ptr<const std::string> payload = block.get_payload();
+        if (payload != nullptr)
+        {
+            return payload;
+        }
+
+        EASY_BLOCK("encode payload");
+        const uint64_t epoch = block.payload_epoch();
+        std::string bytes;
+        flatbuffers_adapter<Block>::to_bytes(block, bytes);
+        payload = block.set_payload(epoch, std::move(bytes));
+        EASY_END_BLOCK;
+
+        return payload;
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> flatbuffers_adapter<Block>::to_bytes(const Block &block)
+    {
+        spdlog::trace("flatbuffers_adapter<Block>::to_bytes start");
+
+        flatbuffers::FlatBufferBuilder &fbb = thread_builder();
+        fbb.Finish(flatbuffers_adapter<Block>::build(fbb, block));
+
+        spdlog::trace("flatbuffers_adapter<Block>::to_bytes end");
+
+        return std::make_shared<std::vector<uint8_t>>(
+            fbb.GetBufferPointer(),
+            fbb.GetBufferPointer() + fbb.GetSize());
+    }
+
+    std::shared_ptr<Block> flatbuffers_adapter<Block>::from_bytes(std::string_view bytes)
+    {
+        BlockView view((const uint8_t *)(bytes.data()), bytes.size());
+        if (!view.verify())
+        {
+            return nullptr;
+        }
+        return view.to_block();
+    }
+
+    std::shared_ptr<Block> flatbuffers_adapter<Block>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    {
+        spdlog::trace("flatbuffers_adapter<Block>::from_bytes start");
+
+        BlockView view(bytes->data(), bytes->size());
+        if (!view.verify())
+        {
+            spdlog::warn("flatbuffers_adapter<Block>::from_bytes: malformed block");
+            return nullptr;
+        }
+        auto block = view.to_block();
+
+        spdlog::trace("flatbuffers_adapter<Block>::from_bytes end");
+
+        return block;
+    }
+
+}
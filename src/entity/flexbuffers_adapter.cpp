@@ -1,5 +1,6 @@
 #include "flexbuffers_adapter.hpp"
 
+#include <cstring>
 #include <string>
 #include "spdlog/spdlog.h"
 #include <easy/profiler.h>
@@ -7,18 +8,24 @@
 namespace tomchain
 {
 
-    std::shared_ptr<BLSSigShare> flexbuffers_adapter<BLSSigShare>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    flexbuffers::Builder &flexbuffers_thread_builder()
     {
-        spdlog::trace("flexbuffers_adapter<BLSSigShare>::from_bytes start");
+        static thread_local flexbuffers::Builder fbb(1024);
+        fbb.Clear();
+        return fbb;
+    }
+
+    std::shared_ptr<BLSSigShare> flexbuffers_adapter<BLSSigShare>::from_ref(flexbuffers::Reference ref)
+    {
+        spdlog::trace("flexbuffers_adapter<BLSSigShare>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
         auto g1_blob = map["g1"].AsBlob();
         assert(g1_blob.size() == 96);
-        auto g1_data = g1_blob.data();
-        std::vector<uint8_t> g1_bv(g1_data, g1_data + 96);
-        auto g1_rptr = (libff::alt_bn128_G1 *)(g1_bv.data());
-        auto g1 = std::make_shared<libff::alt_bn128_G1>(*g1_rptr);
+        static_assert(sizeof(libff::alt_bn128_G1) == 96);
+        auto g1 = std::make_shared<libff::alt_bn128_G1>();
+        std::memcpy((void *)(g1.get()), g1_blob.data(), sizeof(libff::alt_bn128_G1));
 
         auto hint = map["hint"].AsString().str();
         auto signer_index = map["signer_index"].AsUInt64();
@@ -27,46 +34,33 @@ namespace tomchain
 
         auto sig_share = std::make_shared<BLSSigShare>(g1, hint, signer_index, t, n);
 
-        spdlog::trace("flexbuffers_adapter<BLSSigShare>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<BLSSigShare>::from_ref end");
 
         return sig_share;
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<BLSSigShare>::to_bytes(const BLSSigShare &sig_share)
+    void flexbuffers_adapter<BLSSigShare>::write(flexbuffers::Builder &fbb, const BLSSigShare &sig_share)
     {
-        spdlog::trace("flexbuffers_adapter<BLSSigShare>::to_bytes start");
+        spdlog::trace("flexbuffers_adapter<BLSSigShare>::write start");
 
         std::shared_ptr<libff::alt_bn128_G1> g1 = sig_share.getSigShare();
-        std::vector<uint8_t> g1_bv((uint8_t *)(g1.get()), (uint8_t *)(g1.get()) + 96);
         static_assert(sizeof(libff::alt_bn128_G1) == 96);
-        assert(g1_bv.size() == 96);
 
-        std::string hint = sig_share.getHint();
-        uint64_t signer_index = sig_share.getSignerIndex();
-        uint64_t t = sig_share.getRequiredSigners();
-        uint64_t n = sig_share.getTotalSigners();
-
-        flexbuffers::Builder fbb;
         fbb.Map([&]()
                 {
-        fbb.Blob("g1", g1_bv); 
-        fbb.String("hint", hint); 
-        fbb.UInt("signer_index", signer_index);
-        fbb.UInt("t", t);
-        fbb.UInt("n", n); });
-
-        fbb.Finish();
+        fbb.Blob("g1", g1.get(), sizeof(libff::alt_bn128_G1));
+        fbb.String("hint", sig_share.getHint());
+        fbb.UInt("signer_index", sig_share.getSignerIndex());
+        fbb.UInt("t", sig_share.getRequiredSigners());
+        fbb.UInt("n", sig_share.getTotalSigners()); });
 
-        spdlog::trace("flexbuffers_adapter<BLSSigShare>::to_bytes end");
-
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<BLSSigShare>::write end");
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<BlockVote>::to_bytes(const BlockVote &vote)
+    void flexbuffers_adapter<BlockVote>::write(flexbuffers::Builder &fbb, const BlockVote &vote)
     {
-        spdlog::trace("flexbuffers_adapter<BlockVote>::to_bytes start");
+        spdlog::trace("flexbuffers_adapter<BlockVote>::write start");
 
-        flexbuffers::Builder fbb;
         fbb.Map([&]()
                 {
         fbb.UInt("block_id", vote.block_id_);
@@ -75,78 +69,62 @@ namespace tomchain
             fbb.Null("sig_share");
         }
         else {
-            fbb.Blob("sig_share", *flexbuffers_adapter<BLSSigShare>::to_bytes(*(vote.sig_share_)));
+            fbb.Key("sig_share");
+            flexbuffers_adapter<BLSSigShare>::write(fbb, *(vote.sig_share_));
         } });
-        fbb.Finish();
-
-        spdlog::trace("flexbuffers_adapter<BlockVote>::to_bytes end");
 
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<BlockVote>::write end");
     }
 
-    std::shared_ptr<BlockVote> flexbuffers_adapter<BlockVote>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    std::shared_ptr<BlockVote> flexbuffers_adapter<BlockVote>::from_ref(flexbuffers::Reference ref)
     {
-        spdlog::trace("flexbuffers_adapter<BlockVote>::from_bytes start");
+        spdlog::trace("flexbuffers_adapter<BlockVote>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
-        BlockVote vote;
+        std::shared_ptr<BlockVote> sp_vote = std::make_shared<BlockVote>();
 
-        vote.block_id_ = map["block_id"].AsUInt64();
-        vote.voter_id_ = map["voter_id"].AsUInt64();
+        sp_vote->block_id_ = map["block_id"].AsUInt64();
+        sp_vote->voter_id_ = map["voter_id"].AsUInt64();
 
         auto ss_ref = map["sig_share"];
         if (!ss_ref.IsNull())
         {
-            auto ss_blob = map["sig_share"].AsBlob();
-            std::vector<uint8_t> ss_bv(ss_blob.data(), ss_blob.data() + ss_blob.size());
-            auto sig_share = flexbuffers_adapter<BLSSigShare>::from_bytes(std::make_shared<std::vector<uint8_t>>(ss_bv));
-            vote.sig_share_ = sig_share;
+            sp_vote->sig_share_ = flexbuffers_adapter<BLSSigShare>::from_ref(ss_ref);
         }
 
-        std::shared_ptr<BlockVote> sp_vote = std::make_shared<BlockVote>(vote);
-
-        spdlog::trace("flexbuffers_adapter<BlockVote>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<BlockVote>::from_ref end");
 
         return sp_vote;
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<BLSSignature>::to_bytes(const BLSSignature &sig)
+    void flexbuffers_adapter<BLSSignature>::write(flexbuffers::Builder &fbb, const BLSSignature &sig)
     {
-        spdlog::trace("flexbuffers_adapter<BLSSignature>::to_bytes start");
-
-        flexbuffers::Builder fbb;
+        spdlog::trace("flexbuffers_adapter<BLSSignature>::write start");
 
         std::shared_ptr<libff::alt_bn128_G1> g1 = sig.getSig();
-        std::vector<uint8_t> g1_bv((uint8_t *)(g1.get()), (uint8_t *)(g1.get()) + 96);
         static_assert(sizeof(libff::alt_bn128_G1) == 96);
-        assert(g1_bv.size() == 96);
 
         fbb.Map([&]()
                 {
-        fbb.Blob("sig", g1_bv);
+        fbb.Blob("sig", g1.get(), sizeof(libff::alt_bn128_G1));
         fbb.String("hint", sig.getHint());
         fbb.UInt("t", sig.getRequiredSigners());
         fbb.UInt("n", sig.getTotalSigners()); });
-        fbb.Finish();
 
-        spdlog::trace("flexbuffers_adapter<BLSSignature>::to_bytes end");
-
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<BLSSignature>::write end");
     }
 
-    std::shared_ptr<BLSSignature> flexbuffers_adapter<BLSSignature>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    std::shared_ptr<BLSSignature> flexbuffers_adapter<BLSSignature>::from_ref(flexbuffers::Reference ref)
     {
-        spdlog::trace("flexbuffers_adapter<BLSSignature>::from_bytes start");
+        spdlog::trace("flexbuffers_adapter<BLSSignature>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
         auto g1_blob = map["sig"].AsBlob();
         assert(g1_blob.size() == 96);
-        auto g1_data = g1_blob.data();
-        std::vector<uint8_t> g1_bv(g1_data, g1_data + 96);
-        auto g1_rptr = (libff::alt_bn128_G1 *)(g1_bv.data());
-        auto g1 = std::make_shared<libff::alt_bn128_G1>(*g1_rptr);
+        auto g1 = std::make_shared<libff::alt_bn128_G1>();
+        std::memcpy((void *)(g1.get()), g1_blob.data(), sizeof(libff::alt_bn128_G1));
 
         auto hint = map["hint"].AsString().str();
         auto t = map["t"].AsUInt64();
@@ -154,16 +132,14 @@ namespace tomchain
 
         auto sig = std::make_shared<BLSSignature>(g1, hint, t, n);
 
-        spdlog::trace("flexbuffers_adapter<BLSSignature>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<BLSSignature>::from_ref end");
 
         return sig;
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<BlockHeader>::to_bytes(const BlockHeader &bh)
+    void flexbuffers_adapter<BlockHeader>::write(flexbuffers::Builder &fbb, const BlockHeader &bh)
     {
-        spdlog::trace("flexbuffers_adapter<BlockHeader>::to_bytes start");
-
-        flexbuffers::Builder fbb;
+        spdlog::trace("flexbuffers_adapter<BlockHeader>::write start");
 
         fbb.Map([&]()
                 {
@@ -172,19 +148,19 @@ namespace tomchain
         fbb.UInt("proposal_ts", bh.proposal_ts_);
         fbb.UInt("dist_ts", bh.dist_ts_);
         fbb.UInt("commit_ts", bh.commit_ts_);
-        fbb.UInt("recv_ts", bh.recv_ts_); });
-        fbb.Finish();
+        fbb.UInt("recv_ts", bh.recv_ts_);
+        fbb.UInt("tx_count", bh.tx_count_);
+        fbb.Blob("tx_root", bh.tx_root_.data(), bh.tx_root_.size());
+        fbb.Blob("digest", bh.digest_.data(), bh.digest_.size()); });
 
-        spdlog::trace("flexbuffers_adapter<BlockHeader>::to_bytes end");
-
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<BlockHeader>::write end");
     }
 
-    std::shared_ptr<BlockHeader> flexbuffers_adapter<BlockHeader>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    std::shared_ptr<BlockHeader> flexbuffers_adapter<BlockHeader>::from_ref(flexbuffers::Reference ref)
     {
-        spdlog::trace("flexbuffers_adapter<BlockHeader>::from_bytes start");
+        spdlog::trace("flexbuffers_adapter<BlockHeader>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
         std::shared_ptr<BlockHeader> bh = std::make_shared<BlockHeader>();
         bh->id_ = map["id"].AsUInt64();
@@ -193,17 +169,26 @@ namespace tomchain
         bh->dist_ts_ = map["dist_ts"].AsUInt64();
         bh->commit_ts_ = map["commit_ts"].AsUInt64();
         bh->recv_ts_ = map["recv_ts"].AsUInt64();
+        auto digest_blob = map["digest"].AsBlob();
+        if (digest_blob.size() == bh->digest_.size())
+        {
+            std::memcpy(bh->digest_.data(), digest_blob.data(), digest_blob.size());
+        }
+        bh->tx_count_ = map["tx_count"].AsUInt64();
+        auto tx_root_blob = map["tx_root"].AsBlob();
+        if (tx_root_blob.size() == bh->tx_root_.size())
+        {
+            std::memcpy(bh->tx_root_.data(), tx_root_blob.data(), tx_root_blob.size());
+        }
 
-        spdlog::trace("flexbuffers_adapter<BlockHeader>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<BlockHeader>::from_ref end");
 
         return bh;
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<Transaction>::to_bytes(const Transaction &tx)
+    void flexbuffers_adapter<Transaction>::write(flexbuffers::Builder &fbb, const Transaction &tx)
     {
-        spdlog::trace("flexbuffers_adapter<Transaction>::to_bytes start");
-
-        flexbuffers::Builder fbb;
+        spdlog::trace("flexbuffers_adapter<Transaction>::write start");
 
         fbb.Map([&]()
                 {
@@ -212,18 +197,15 @@ namespace tomchain
         fbb.UInt("receiver", tx.receiver_);
         fbb.UInt("value", tx.value_);
         fbb.UInt("fee", tx.fee_); });
-        fbb.Finish();
-
-        spdlog::trace("flexbuffers_adapter<Transaction>::to_bytes end");
 
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<Transaction>::write end");
     }
 
-    std::shared_ptr<Transaction> flexbuffers_adapter<Transaction>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    std::shared_ptr<Transaction> flexbuffers_adapter<Transaction>::from_ref(flexbuffers::Reference ref)
     {
-        spdlog::trace("flexbuffers_adapter<Transaction>::from_bytes start");
+        spdlog::trace("flexbuffers_adapter<Transaction>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
         std::shared_ptr<Transaction> tx = std::make_shared<Transaction>(
             map["id"].AsUInt64(),
@@ -232,123 +214,98 @@ namespace tomchain
             map["value"].AsUInt64(),
             map["fee"].AsUInt64());
 
-        spdlog::trace("flexbuffers_adapter<Transaction>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<Transaction>::from_ref end");
 
         return tx;
     }
 
-    std::shared_ptr<std::vector<uint8_t>> flexbuffers_adapter<Block>::to_bytes(const Block &block)
+    void flexbuffers_adapter<Block>::write(flexbuffers::Builder &fbb, const Block &block)
     {
-        spdlog::trace("flexbuffers_adapter<Block>::to_bytes start");
-
-        flexbuffers::Builder fbb;
-
-        auto bh_bv = flexbuffers_adapter<BlockHeader>::to_bytes(block.header_);
+        spdlog::trace("flexbuffers_adapter<Block>::write start");
 
         fbb.Map([&]()
                 {
                     EASY_BLOCK("header");
-                    fbb.Blob("header", *bh_bv);
+                    fbb.Key("header");
+                    flexbuffers_adapter<BlockHeader>::write(fbb, block.header_);
                     EASY_END_BLOCK;
                     EASY_BLOCK("tx_vec");
                     fbb.Vector("tx_vec", [&]()
                                {
-            for (auto tx : block.tx_vec_) {
-                // auto tx_bv = flexbuffers_adapter<Transaction>::to_bytes(*tx);
-                // fbb.Blob(*tx_bv);
+            for (const auto &tx : block.tx_vec_) {
                 fbb.Vector([&]() {
-                    fbb.UInt(tx->id_); 
-                    fbb.UInt(tx->sender_); 
-                    fbb.UInt(tx->receiver_); 
-                    fbb.UInt(tx->value_); 
-                    fbb.UInt(tx->fee_); 
+                    fbb.UInt(tx.id_);
+                    fbb.UInt(tx.sender_);
+                    fbb.UInt(tx.receiver_);
+                    fbb.UInt(tx.value_);
+                    fbb.UInt(tx.fee_);
                 });
             } });
                     EASY_END_BLOCK;
                     EASY_BLOCK("votes");
                     fbb.Map("votes", [&]()
                             {
-            for (auto iter : block.votes_) {
-                auto vote_bv = flexbuffers_adapter<BlockVote>::to_bytes(*(iter.second));
-                fbb.Blob(std::to_string(iter.first).c_str(), *vote_bv);
+            for (const auto &iter : block.votes_) {
+                fbb.Key(std::to_string(iter.first));
+                flexbuffers_adapter<BlockVote>::write(fbb, *(iter.second));
             } });
                     EASY_END_BLOCK;
-                    // if (block.tss_sig_ == nullptr)
-                    // {
-                    //     fbb.Null("tss_sig");
-                    // }
-                    // else {
-                    //     auto tss_sig_bv = flexbuffers_adapter<BLSSignature>::to_bytes(*(block.tss_sig_));
-                    //     fbb.Blob("tss_sig", *tss_sig_bv);
-                    // }
+                    if (block.tss_sig_ == nullptr)
+                    {
+                        fbb.Null("tss_sig");
+                    }
+                    else
+                    {
+                        fbb.Key("tss_sig");
+                        flexbuffers_adapter<BLSSignature>::write(fbb, *(block.tss_sig_));
+                    }
                 });
-        fbb.Finish();
 
-        spdlog::trace("flexbuffers_adapter<Block>::to_bytes end");
-
-        return std::make_shared<std::vector<uint8_t>>(fbb.GetBuffer());
+        spdlog::trace("flexbuffers_adapter<Block>::write end");
     }
 
-    std::shared_ptr<Block> flexbuffers_adapter<Block>::from_bytes(std::shared_ptr<std::vector<uint8_t>> bytes)
+    std::shared_ptr<Block> flexbuffers_adapter<Block>::from_ref(flexbuffers::Reference ref)
     {
-        spdlog::trace("flexbuffers_adapter<Block>::from_bytes start");
+        spdlog::trace("flexbuffers_adapter<Block>::from_ref start");
 
-        auto map = flexbuffers::GetRoot(*bytes).AsMap();
+        auto map = ref.AsMap();
 
-        auto bh_blob = map["header"].AsBlob();
-        std::vector<uint8_t> bh_bv(bh_blob.data(), bh_blob.data() + bh_blob.size());
-        auto bh = flexbuffers_adapter<BlockHeader>::from_bytes(std::make_shared<std::vector<uint8_t>>(bh_bv));
+        auto block = std::make_shared<Block>();
+        block->header_ = *(flexbuffers_adapter<BlockHeader>::from_ref(map["header"]));
 
         auto tx_vec_fb = map["tx_vec"].AsVector();
-        std::vector<std::shared_ptr<Transaction>> tx_vec(tx_vec_fb.size());
-        for (size_t i = 0; i < tx_vec_fb.size(); i++)
+        const size_t tx_count = tx_vec_fb.size();
+        block->tx_vec_.resize(tx_count);
+        for (size_t i = 0; i < tx_count; i++)
         {
-            tx_vec[i] = std::make_shared<Transaction>();
-        }
-
-        for (size_t i = 0; i < tx_vec_fb.size(); i++)
-        {
-            // auto tx_blob = tx_vec_fb[i].AsBlob();
-            // auto tx_bv = std::vector<uint8_t>(tx_blob.data(), tx_blob.data() + tx_blob.size());
-            // auto tx = flexbuffers_adapter<Transaction>::from_bytes(std::make_shared<std::vector<uint8_t>>(tx_bv));
-            // tx_vec.push_back(tx);
             auto curr_tx_datavec = tx_vec_fb[i].AsVector();
-            tx_vec[i]->id_ = curr_tx_datavec[0].AsUInt64();
-            tx_vec[i]->sender_ = curr_tx_datavec[1].AsUInt64();
-            tx_vec[i]->receiver_ = curr_tx_datavec[2].AsUInt64();
-            tx_vec[i]->value_ = curr_tx_datavec[3].AsUInt64();
-            tx_vec[i]->fee_ = curr_tx_datavec[4].AsUInt64();
+            Transaction &tx = block->tx_vec_[i];
+            tx.id_ = curr_tx_datavec[0].AsUInt64();
+            tx.sender_ = curr_tx_datavec[1].AsUInt64();
+            tx.receiver_ = curr_tx_datavec[2].AsUInt64();
+            tx.value_ = curr_tx_datavec[3].AsUInt64();
+            tx.fee_ = curr_tx_datavec[4].AsUInt64();
         }
 
-        std::map<uint64_t, std::shared_ptr<BlockVote>> votes;
         auto votes_fb = map["votes"].AsMap();
         auto keys = votes_fb.Keys();
+        auto values = votes_fb.Values();
         for (size_t i = 0; i < keys.size(); i++)
         {
-            auto key = keys[i].AsString();
-            auto vote_blob = votes_fb[key.c_str()].AsBlob();
-            std::vector<uint8_t> vote_bv(vote_blob.data(), vote_blob.data() + vote_blob.size());
-            auto vote = flexbuffers_adapter<BlockVote>::from_bytes(std::make_shared<std::vector<uint8_t>>(vote_bv));
-            votes.insert(std::make_pair(std::stoi(key.str()), vote));
+            auto vote = flexbuffers_adapter<BlockVote>::from_ref(values[i]);
+            block->votes_.insert(std::make_pair(std::stoull(keys[i].AsKey()), vote));
         }
 
-        auto block = std::make_shared<Block>();
-        block->header_ = *bh;
-        block->tx_vec_ = tx_vec;
-        block->votes_ = votes;
-
-        // auto tss_sig_ref = map["tss_sig"];
-        // if (!tss_sig_ref.IsNull())
-        // {
-        //     auto tss_sig_blob = tss_sig_ref.AsBlob();
-        //     std::vector<uint8_t> tss_sig_bv(tss_sig_blob.data(), tss_sig_blob.data() + tss_sig_blob.size());
-        //     auto tss_sig = flexbuffers_adapter<BLSSignature>::from_bytes(std::make_shared<std::vector<uint8_t>>(tss_sig_bv));
-        //     block->tss_sig_ = tss_sig;
-        // };
+        // absent in blocks encoded before commit
+        auto sig_ref = map["tss_sig"];
+        if (!sig_ref.IsNull())
+        {
+            block->tss_sig_ = flexbuffers_adapter<BLSSignature>::from_ref(sig_ref);
+        }
 
-        spdlog::trace("flexbuffers_adapter<Block>::from_bytes end");
+        spdlog::trace("flexbuffers_adapter<Block>::from_ref end");
 
         return block;
     }
 
-}
\ No newline at end of file
+}
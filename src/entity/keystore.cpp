@@ -0,0 +1,313 @@
+#include "keystore.hpp"
+#include "sha256.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+#include "oneapi/tbb/parallel_for.h"
+
+namespace tomchain
+{
+
+    namespace
+    {
+        constexpr char magic[8] = {'T', 'C', 'K', 'E', 'Y', 'S', '0', '1'};
+        constexpr size_t fr_size = libff::alt_bn128_r_limbs * sizeof(mp_limb_t);
+        constexpr size_t fq_size = libff::alt_bn128_q_limbs * sizeof(mp_limb_t);
+        constexpr size_t g2_size = 4 * fq_size;
+        constexpr size_t header_size = sizeof(magic) + 2 * sizeof(uint64_t) + g2_size;
+        constexpr size_t record_size = fr_size + g2_size;
+
+        size_t file_size(size_t n)
+        {
+            return header_size + n * record_size + sha256::digest_size;
+        }
+
+        template <typename FieldT>
+        uint8_t *put_field(uint8_t *out, const FieldT &value)
+        {
+            const auto repr = value.as_bigint();
+            std::memcpy(out, repr.data, sizeof(repr.data));
+            return out + sizeof(repr.data);
+        }
+
+        template <typename FieldT>
+        const uint8_t *get_field(const uint8_t *in, FieldT &value)
+        {
+            decltype(value.as_bigint()) repr;
+            std::memcpy(repr.data, in, sizeof(repr.data));
+            value = FieldT(repr);
+            return in + sizeof(repr.data);
+        }
+
+        // affine X.c0, X.c1, Y.c0, Y.c1
+        uint8_t *put_g2(uint8_t *out, libff::alt_bn128_G2 point)
+        {
+            point.to_affine_coordinates();
+            out = put_field(out, point.X.c0);
+            out = put_field(out, point.X.c1);
+            out = put_field(out, point.Y.c0);
+            return put_field(out, point.Y.c1);
+        }
+
+        const uint8_t *get_g2(const uint8_t *in, libff::alt_bn128_G2 &point)
+        {
+            libff::alt_bn128_Fq x0, x1, y0, y1;
+            in = get_field(in, x0);
+            in = get_field(in, x1);
+            in = get_field(in, y0);
+            in = get_field(in, y1);
+            point = libff::alt_bn128_G2(
+                libff::alt_bn128_Fq2(x0, x1),
+                libff::alt_bn128_Fq2(y0, y1),
+                libff::alt_bn128_Fq2::one());
+            return in;
+        }
+
+        // SHA-256 of (domain, seed, k) with the top bits cleared, below r
+        libff::alt_bn128_Fr seeded_coeff(uint64_t seed, uint64_t k)
+        {
+            static_assert(libff::alt_bn128_r_limbs * sizeof(mp_limb_t) == sha256::digest_size);
+            constexpr char domain[8] = {'T', 'C', 'K', 'E', 'Y', 'G', 'E', 'N'};
+            uint8_t input[sizeof(domain) + 2 * sizeof(uint64_t)];
+            std::memcpy(input, domain, sizeof(domain));
+            std::memcpy(input + sizeof(domain), &seed, sizeof(seed));
+            std::memcpy(input + sizeof(domain) + sizeof(seed), &k, sizeof(k));
+            const sha256::digest digest = sha256::hash(input, sizeof(input));
+
+            libff::bigint<libff::alt_bn128_r_limbs> repr;
+            std::memcpy(repr.data, digest.data(), digest.size());
+            repr.data[libff::alt_bn128_r_limbs - 1] &= (mp_limb_t(1) << (8 * sizeof(mp_limb_t) - 3)) - 1;
+            return libff::alt_bn128_Fr(repr);
+        }
+
+        std::vector<libff::alt_bn128_Fr> seeded_coeffs(size_t t, uint64_t seed)
+        {
+            std::vector<libff::alt_bn128_Fr> coeffs(t);
+            for (size_t k = 0; k < t; k++)
+            {
+                coeffs[k] = seeded_coeff(seed, k);
+            }
+            return coeffs;
+        }
+    }
+
+    keystore::keys keystore::generate(size_t t, size_t n)
+    {
+        std::vector<libff::alt_bn128_Fr> coeffs(t);
+        for (size_t k = 0; k < t; k++)
+        {
+            coeffs[k] = libff::alt_bn128_Fr::random_element();
+        }
+        return keystore::generate(coeffs, n);
+    }
+
+    keystore::keys keystore::generate(size_t t, size_t n, uint64_t seed)
+    {
+        return keystore::generate(seeded_coeffs(t, seed), n);
+    }
+
+    bool keystore::matches_seed(const keys &ks, uint64_t seed)
+    {
+        return ks.group_pkey == seeded_coeff(seed, 0) * libff::alt_bn128_G2::one();
+    }
+
+    keystore::keys keystore::generate(const std::vector<libff::alt_bn128_Fr> &coeffs, size_t n)
+    {
+        EASY_FUNCTION("keystore::generate");
+        spdlog::info("Generating threshold keys for {} signers", n);
+
+        // f(x) = coeffs[0] + coeffs[1] x + ... + coeffs[t - 1] x^(t - 1)
+        const size_t t = coeffs.size();
+        keys ks;
+        ks.threshold = t;
+        ks.group_pkey = coeffs[0] * libff::alt_bn128_G2::one();
+        ks.group_pkey.to_affine_coordinates();
+        ks.shares.resize(n);
+        oneapi::tbb::parallel_for(
+            oneapi::tbb::blocked_range<size_t>(0, n),
+            [&](const oneapi::tbb::blocked_range<size_t> &range)
+            {
+                for (size_t i = range.begin(); i < range.end(); i++)
+                {
+                    // Horner at x = i + 1
+                    const libff::alt_bn128_Fr x((long)(i + 1));
+                    libff::alt_bn128_Fr y = libff::alt_bn128_Fr::zero();
+                    for (size_t k = t; k-- > 0;)
+                    {
+                        y = y * x + coeffs[k];
+                    }
+                    ks.shares[i].skey = y;
+                    ks.shares[i].pkey = y * libff::alt_bn128_G2::one();
+                    ks.shares[i].pkey.to_affine_coordinates();
+                }
+            });
+        return ks;
+    }
+
+    bool keystore::save(const std::string &path, const keys &ks)
+    {
+        EASY_FUNCTION("keystore::save");
+        const size_t n = ks.shares.size();
+        std::vector<uint8_t> buf(file_size(n));
+
+        uint8_t *out = buf.data();
+        std::memcpy(out, magic, sizeof(magic));
+        out += sizeof(magic);
+        const uint64_t t64 = ks.threshold;
+        const uint64_t n64 = n;
+        std::memcpy(out, &t64, sizeof(t64));
+        out += sizeof(t64);
+        std::memcpy(out, &n64, sizeof(n64));
+        out += sizeof(n64);
+        out = put_g2(out, ks.group_pkey);
+        for (const share &s : ks.shares)
+        {
+            out = put_field(out, s.skey);
+            out = put_g2(out, s.pkey);
+        }
+        const sha256::digest checksum = sha256::hash(buf.data(), out - buf.data());
+        std::memcpy(out, checksum.data(), checksum.size());
+
+        const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+        if (!dir.empty() && ::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+        {
+            spdlog::error("keystore: cannot create {}: {}", dir.string(), std::strerror(errno));
+            return false;
+        }
+
+        // readers never see a half-written file; a unique name per save,
+        // as servers sharing the file may save at once
+        std::string tmp_buf = path + ".XXXXXX";
+        // mode 0600, O_EXCL
+        const int fd = ::mkostemp(tmp_buf.data(), O_CLOEXEC);
+        if (fd < 0)
+        {
+            spdlog::error("keystore: cannot create {}: {}", tmp_buf, std::strerror(errno));
+            return false;
+        }
+        const std::string tmp_path = tmp_buf;
+        size_t written = 0;
+        while (written < buf.size())
+        {
+            const ssize_t ret = ::write(fd, buf.data() + written, buf.size() - written);
+            if (ret < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ret <= 0)
+            {
+                break;
+            }
+            written += ret;
+        }
+        const bool synced = written == buf.size() && ::fsync(fd) == 0;
+        if (::close(fd) != 0 || !synced)
+        {
+            spdlog::error("keystore: cannot write {}: {}", tmp_path, std::strerror(errno));
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            spdlog::error("keystore: cannot rename {} to {}", tmp_path, path);
+            ::unlink(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool keystore::load(const std::string &path, size_t t, size_t n, keys &ks)
+    {
+        EASY_FUNCTION("keystore::load");
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || (size_t)st.st_size != file_size(n))
+        {
+            ::close(fd);
+            spdlog::warn("keystore: {} does not hold {} signers", path, n);
+            return false;
+        }
+        void *addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            return false;
+        }
+        const uint8_t *base = (const uint8_t *)addr;
+
+        bool ok = std::memcmp(base, magic, sizeof(magic)) == 0;
+        uint64_t t64 = 0;
+        uint64_t n64 = 0;
+        std::memcpy(&t64, base + sizeof(magic), sizeof(t64));
+        std::memcpy(&n64, base + sizeof(magic) + sizeof(t64), sizeof(n64));
+        ok = ok && t64 == t && n64 == n;
+        const size_t body_size = file_size(n) - sha256::digest_size;
+        ok = ok && sha256::hash(base, body_size) == *(const sha256::digest *)(base + body_size);
+        if (!ok)
+        {
+            ::munmap(addr, st.st_size);
+            spdlog::warn("keystore: {} is corrupt or for another committee", path);
+            return false;
+        }
+
+        ks.threshold = t;
+        get_g2(base + sizeof(magic) + 2 * sizeof(uint64_t), ks.group_pkey);
+        ks.shares.resize(n);
+        oneapi::tbb::parallel_for(
+            oneapi::tbb::blocked_range<size_t>(0, n),
+            [&](const oneapi::tbb::blocked_range<size_t> &range)
+            {
+                for (size_t i = range.begin(); i < range.end(); i++)
+                {
+                    const uint8_t *in = base + header_size + i * record_size;
+                    in = get_field(in, ks.shares[i].skey);
+                    get_g2(in, ks.shares[i].pkey);
+                }
+            });
+        ::munmap(addr, st.st_size);
+        return true;
+    }
+
+    keystore::keys keystore::load_or_generate(const std::string &path, size_t t, size_t n, uint64_t seed)
+    {
+        keys ks;
+        if (keystore::load(path, t, n, ks))
+        {
+            if (keystore::matches_seed(ks, seed))
+            {
+                spdlog::info("Loaded threshold keys for {} signers from {}", n, path);
+                return ks;
+            }
+            spdlog::warn("keystore: {} was generated from another seed", path);
+        }
+        ks = keystore::generate(t, n, seed);
+        if (keystore::save(path, ks))
+        {
+            spdlog::info("Saved threshold keys to {}", path);
+        }
+
+        // the file that won a concurrent save is the one that lasts
+        keys on_disk;
+        if (keystore::load(path, t, n, on_disk) && keystore::matches_seed(on_disk, seed))
+        {
+            return on_disk;
+        }
+        spdlog::warn("keystore: {} does not hold the generated keys", path);
+        return ks;
+    }
+
+}
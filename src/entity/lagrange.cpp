@@ -0,0 +1,111 @@
+#include "lagrange.hpp"
+
+#include <atomic>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    namespace
+    {
+        std::atomic<std::shared_ptr<const std::vector<libff::alt_bn128_Fr>>> coefficient_cache;
+    }
+
+    void lagrange::batch_invert(std::vector<libff::alt_bn128_Fr> &values)
+    {
+        if (values.empty())
+        {
+            return;
+        }
+
+        // prefix[i] = values[0] * ... * values[i - 1]
+        std::vector<libff::alt_bn128_Fr> prefix(values.size());
+        libff::alt_bn128_Fr acc = libff::alt_bn128_Fr::one();
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            prefix[i] = acc;
+            acc = acc * values[i];
+        }
+
+        libff::alt_bn128_Fr inv = acc.inverse();
+        for (size_t i = values.size(); i-- > 0;)
+        {
+            const libff::alt_bn128_Fr value = values[i];
+            values[i] = inv * prefix[i];
+            inv = inv * value;
+        }
+    }
+
+    std::vector<libff::alt_bn128_Fr> lagrange::coefficients(size_t n)
+    {
+        EASY_FUNCTION("lagrange::coefficients");
+
+        // fact[k] = k!
+        std::vector<libff::alt_bn128_Fr> fact(n + 1);
+        fact[0] = libff::alt_bn128_Fr::one();
+        for (size_t k = 1; k <= n; k++)
+        {
+            fact[k] = fact[k - 1] * libff::alt_bn128_Fr((long)k);
+        }
+
+        // denominators i * (-1)^(i-1) * (i-1)! * (n-i)!
+        std::vector<libff::alt_bn128_Fr> coeffs(n);
+        for (size_t i = 1; i <= n; i++)
+        {
+            libff::alt_bn128_Fr d = libff::alt_bn128_Fr((long)i) * fact[i - 1] * fact[n - i];
+            coeffs[i - 1] = (i % 2 == 1) ? d : -d;
+        }
+        lagrange::batch_invert(coeffs);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            coeffs[i] = fact[n] * coeffs[i];
+        }
+        return coeffs;
+    }
+
+    std::vector<libff::alt_bn128_Fr> lagrange::coefficients(const std::vector<uint64_t> &indices)
+    {
+        EASY_FUNCTION("lagrange::coefficients(subset)");
+
+        // lambda_i = (prod_j x_j) / (x_i * prod_{j != i} (x_j - x_i))
+        libff::alt_bn128_Fr numerator = libff::alt_bn128_Fr::one();
+        std::vector<libff::alt_bn128_Fr> coeffs(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            const libff::alt_bn128_Fr x_i((long)indices[i]);
+            numerator = numerator * x_i;
+            libff::alt_bn128_Fr d = x_i;
+            for (size_t j = 0; j < indices.size(); j++)
+            {
+                if (j != i)
+                {
+                    d = d * (libff::alt_bn128_Fr((long)indices[j]) - x_i);
+                }
+            }
+            coeffs[i] = d;
+        }
+        lagrange::batch_invert(coeffs);
+
+        for (size_t i = 0; i < coeffs.size(); i++)
+        {
+            coeffs[i] = numerator * coeffs[i];
+        }
+        return coeffs;
+    }
+
+    void lagrange::init_cache(size_t n)
+    {
+        spdlog::info("Caching Lagrange coefficients for {} signers", n);
+        coefficient_cache.store(
+            std::make_shared<const std::vector<libff::alt_bn128_Fr>>(lagrange::coefficients(n)),
+            std::memory_order_release);
+    }
+
+    std::shared_ptr<const std::vector<libff::alt_bn128_Fr>> lagrange::cached()
+    {
+        return coefficient_cache.load(std::memory_order_acquire);
+    }
+
+}
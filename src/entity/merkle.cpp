@@ -0,0 +1,244 @@
+#include "merkle.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <easy/profiler.h>
+#include "oneapi/tbb/parallel_for.h"
+
+namespace tomchain
+{
+
+    namespace
+    {
+        constexpr uint8_t leaf_prefix = 0x00;
+        constexpr uint8_t node_prefix = 0x01;
+        constexpr size_t node_record = 1 + 2 * sha256::digest_size;
+        // hashes per hash_many() call; also the parallel grain
+        constexpr size_t chunk = 256;
+
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+            "transactions are hashed as laid out in memory");
+
+        template <typename LeafT>
+        void hash_leaves(const LeafT *leaves, size_t count, merkle::digest *out)
+        {
+            constexpr size_t leaf_record = 1 + sizeof(LeafT);
+            oneapi::tbb::parallel_for(
+                oneapi::tbb::blocked_range<size_t>(0, count, chunk),
+                [&](const oneapi::tbb::blocked_range<size_t> &range)
+                {
+                    uint8_t records[chunk * leaf_record];
+                    for (size_t base = range.begin(); base < range.end(); base += chunk)
+                    {
+                        const size_t n = std::min(chunk, range.end() - base);
+                        for (size_t i = 0; i < n; i++)
+                        {
+                            records[i * leaf_record] = leaf_prefix;
+                            std::memcpy(&records[i * leaf_record + 1], &leaves[base + i], sizeof(LeafT));
+                        }
+                        sha256::hash_many(records, leaf_record, n, out + base);
+                    }
+                });
+        }
+
+        // hashes pairs of `in` into `out`, which holds (count + 1) / 2 entries
+        void hash_nodes(const merkle::digest *in, size_t count, merkle::digest *out)
+        {
+            const size_t pairs = count / 2;
+            oneapi::tbb::parallel_for(
+                oneapi::tbb::blocked_range<size_t>(0, pairs, chunk),
+                [&](const oneapi::tbb::blocked_range<size_t> &range)
+                {
+                    uint8_t records[chunk * node_record];
+                    for (size_t base = range.begin(); base < range.end(); base += chunk)
+                    {
+                        const size_t n = std::min(chunk, range.end() - base);
+                        for (size_t i = 0; i < n; i++)
+                        {
+                            records[i * node_record] = node_prefix;
+                            std::memcpy(&records[i * node_record + 1], in[2 * (base + i)].data(), 2 * sha256::digest_size);
+                        }
+                        sha256::hash_many(records, node_record, n, out + base);
+                    }
+                });
+            if (count % 2 == 1)
+            {
+                out[pairs] = in[count - 1];
+            }
+        }
+
+        merkle::digest hash_node(const merkle::digest &left, const merkle::digest &right)
+        {
+            uint8_t record[node_record];
+            record[0] = node_prefix;
+            std::memcpy(&record[1], left.data(), sha256::digest_size);
+            std::memcpy(&record[1 + sha256::digest_size], right.data(), sha256::digest_size);
+            return sha256::hash(record, node_record);
+        }
+
+        // nodes holds the hashed leaves [begin, begin + nodes.size())
+        bool verify_nodes(
+            const merkle::digest &root,
+            size_t leaf_count,
+            size_t begin,
+            std::vector<merkle::digest> nodes,
+            const std::vector<merkle::digest> &proof)
+        {
+            size_t end = begin + nodes.size();
+            size_t width = leaf_count;
+            size_t used = 0;
+            while (width > 1)
+            {
+                // widen [begin, end) to whole pairs with the proof siblings
+                if (begin % 2 == 1)
+                {
+                    if (used == proof.size())
+                    {
+                        return false;
+                    }
+                    nodes.insert(nodes.begin(), proof[used++]);
+                }
+                if (end % 2 == 1 && end < width)
+                {
+                    if (used == proof.size())
+                    {
+                        return false;
+                    }
+                    nodes.push_back(proof[used++]);
+                }
+
+                std::vector<merkle::digest> above((nodes.size() + 1) / 2);
+                for (size_t i = 0; i + 1 < nodes.size(); i += 2)
+                {
+                    above[i / 2] = hash_node(nodes[i], nodes[i + 1]);
+                }
+                if (nodes.size() % 2 == 1)
+                {
+                    above.back() = nodes.back();
+                }
+                nodes = std::move(above);
+
+                begin /= 2;
+                end = (end + 1) / 2;
+                width = (width + 1) / 2;
+            }
+
+            return used == proof.size() && nodes.size() == 1 && nodes[0] == root;
+        }
+    }
+
+    merkle::tree::tree(const std::vector<Transaction> &txs)
+        : leaf_count_(txs.size())
+    {
+        EASY_FUNCTION("merkle::tree");
+        this->build(txs.data(), txs.size());
+    }
+
+    merkle::tree::tree(const std::vector<digest> &leaves)
+        : leaf_count_(leaves.size())
+    {
+        EASY_FUNCTION("merkle::tree(digests)");
+        this->build(leaves.data(), leaves.size());
+    }
+
+    template <typename LeafT>
+    void merkle::tree::build(const LeafT *leaves, size_t count)
+    {
+        if (count == 0)
+        {
+            levels_.push_back({sha256::hash(nullptr, 0)});
+            return;
+        }
+
+        levels_.emplace_back(count);
+        hash_leaves(leaves, count, levels_.back().data());
+        while (levels_.back().size() > 1)
+        {
+            const std::vector<digest> &below = levels_.back();
+            std::vector<digest> above((below.size() + 1) / 2);
+            hash_nodes(below.data(), below.size(), above.data());
+            levels_.push_back(std::move(above));
+        }
+    }
+
+    const merkle::digest &merkle::tree::root() const
+    {
+        return levels_.back().front();
+    }
+
+    size_t merkle::tree::leaf_count() const
+    {
+        return leaf_count_;
+    }
+
+    std::vector<merkle::digest> merkle::tree::prove(size_t begin, size_t end) const
+    {
+        std::vector<digest> proof;
+        if (begin >= end || end > this->leaf_count())
+        {
+            return proof;
+        }
+
+        for (size_t level = 0; level + 1 < levels_.size(); level++)
+        {
+            const std::vector<digest> &nodes = levels_[level];
+            if (begin % 2 == 1)
+            {
+                proof.push_back(nodes[begin - 1]);
+            }
+            if (end % 2 == 1 && end < nodes.size())
+            {
+                proof.push_back(nodes[end]);
+            }
+            begin /= 2;
+            end = (end + 1) / 2;
+        }
+        return proof;
+    }
+
+    merkle::digest merkle::root(const std::vector<Transaction> &txs)
+    {
+        return tree(txs).root();
+    }
+
+    bool merkle::verify(
+        const digest &root,
+        size_t leaf_count,
+        size_t begin,
+        const Transaction *txs,
+        size_t count,
+        const std::vector<digest> &proof)
+    {
+        EASY_FUNCTION("merkle::verify");
+
+        if (count == 0 || begin >= leaf_count || count > leaf_count - begin)
+        {
+            return false;
+        }
+
+        std::vector<digest> nodes(count);
+        hash_leaves(txs, count, nodes.data());
+        return verify_nodes(root, leaf_count, begin, std::move(nodes), proof);
+    }
+
+    bool merkle::verify(
+        const digest &root,
+        size_t leaf_count,
+        size_t begin,
+        const digest *leaves,
+        size_t count,
+        const std::vector<digest> &proof)
+    {
+        EASY_FUNCTION("merkle::verify(digests)");
+
+        if (count == 0 || begin >= leaf_count || count > leaf_count - begin)
+        {
+            return false;
+        }
+
+        std::vector<digest> nodes(count);
+        hash_leaves(leaves, count, nodes.data());
+        return verify_nodes(root, leaf_count, begin, std::move(nodes), proof);
+    }
+
+}
@@ -0,0 +1,150 @@
+#include "msm.hpp"
+
+#include <cassert>
+#include <easy/profiler.h>
+#include "oneapi/tbb/parallel_for.h"
+
+namespace tomchain
+{
+
+    namespace
+    {
+        using scalar_repr = libff::bigint<libff::alt_bn128_r_limbs>;
+
+        constexpr size_t limb_bits = 8 * sizeof(mp_limb_t);
+
+        // bits [offset, offset + width) of a scalar
+        size_t digit(const scalar_repr &s, size_t offset, size_t width)
+        {
+            const size_t limb = offset / limb_bits;
+            const size_t shift = offset % limb_bits;
+            if (limb >= libff::alt_bn128_r_limbs)
+            {
+                return 0;
+            }
+            mp_limb_t bits = s.data[limb] >> shift;
+            if (shift + width > limb_bits && limb + 1 < libff::alt_bn128_r_limbs)
+            {
+                bits |= s.data[limb + 1] << (limb_bits - shift);
+            }
+            return (size_t)(bits & (((mp_limb_t)1 << width) - 1));
+        }
+
+        libff::alt_bn128_G1 window_sum(
+            const std::vector<libff::alt_bn128_G1> &points,
+            const std::vector<scalar_repr> &scalars,
+            size_t offset,
+            size_t width)
+        {
+            // bucket d - 1 collects the points whose digit is d
+            std::vector<libff::alt_bn128_G1> buckets(
+                ((size_t)1 << width) - 1, libff::alt_bn128_G1::zero());
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                const size_t d = digit(scalars[i], offset, width);
+                if (d != 0)
+                {
+                    buckets[d - 1] = buckets[d - 1].mixed_add(points[i]);
+                }
+            }
+
+            // sum_d d * bucket[d] as a running sum from the top
+            libff::alt_bn128_G1 running = libff::alt_bn128_G1::zero();
+            libff::alt_bn128_G1 sum = libff::alt_bn128_G1::zero();
+            for (size_t d = buckets.size(); d-- > 0;)
+            {
+                running = running + buckets[d];
+                sum = sum + running;
+            }
+            return sum;
+        }
+    }
+
+    size_t msm::window_bits(size_t n)
+    {
+        // set by init_alt_bn128_params(), not a constant
+        const size_t scalar_bits = libff::alt_bn128_Fr::num_bits;
+        size_t best = 1;
+        double best_cost = 0;
+        for (size_t c = 1; c <= 16; c++)
+        {
+            const double windows = (double)((scalar_bits + c - 1) / c);
+            const double cost = windows * ((double)n + (double)((size_t)2 << c));
+            if (c == 1 || cost < best_cost)
+            {
+                best = c;
+                best_cost = cost;
+            }
+        }
+        return best;
+    }
+
+    libff::alt_bn128_G1 msm::multi_exp(
+        const std::vector<libff::alt_bn128_G1> &points,
+        const std::vector<libff::alt_bn128_Fr> &scalars)
+    {
+        EASY_FUNCTION("msm::multi_exp");
+        assert(points.size() == scalars.size());
+
+        // mixed addition needs affine points; zeros contribute nothing
+        std::vector<libff::alt_bn128_G1> affine;
+        std::vector<scalar_repr> reprs;
+        affine.reserve(points.size());
+        reprs.reserve(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (points[i].is_zero() || scalars[i].is_zero())
+            {
+                continue;
+            }
+            affine.push_back(points[i]);
+            reprs.push_back(scalars[i].as_bigint());
+        }
+        if (affine.empty())
+        {
+            return libff::alt_bn128_G1::zero();
+        }
+        libff::alt_bn128_G1::batch_to_special_all_non_zeros(affine);
+
+        const size_t scalar_bits = libff::alt_bn128_Fr::num_bits;
+        const size_t width = msm::window_bits(affine.size());
+        const size_t window_count = (scalar_bits + width - 1) / width;
+        std::vector<libff::alt_bn128_G1> sums(window_count);
+        oneapi::tbb::parallel_for(
+            oneapi::tbb::blocked_range<size_t>(0, window_count),
+            [&](const oneapi::tbb::blocked_range<size_t> &range)
+            {
+                for (size_t w = range.begin(); w < range.end(); w++)
+                {
+                    sums[w] = window_sum(affine, reprs, w * width, width);
+                }
+            });
+
+        // sum_w 2^(w * width) * sums[w], Horner from the top window
+        libff::alt_bn128_G1 result = sums[window_count - 1];
+        for (size_t w = window_count - 1; w-- > 0;)
+        {
+            for (size_t b = 0; b < width; b++)
+            {
+                result = result.dbl();
+            }
+            result = result + sums[w];
+        }
+        return result;
+    }
+
+    libff::alt_bn128_G1 msm::naive(
+        const std::vector<libff::alt_bn128_G1> &points,
+        const std::vector<libff::alt_bn128_Fr> &scalars)
+    {
+        assert(points.size() == scalars.size());
+
+        libff::alt_bn128_G1 result = libff::alt_bn128_G1::zero();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            result = result + scalars[i] * points[i];
+        }
+        return result;
+    }
+
+}
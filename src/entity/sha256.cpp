@@ -0,0 +1,352 @@
+#include "sha256.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <immintrin.h>
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    namespace
+    {
+        alignas(16) constexpr uint32_t round_k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+        constexpr uint32_t initial_state[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+        void store_be32(uint8_t *out, uint32_t value)
+        {
+            out[0] = (uint8_t)(value >> 24);
+            out[1] = (uint8_t)(value >> 16);
+            out[2] = (uint8_t)(value >> 8);
+            out[3] = (uint8_t)(value);
+        }
+
+        /**
+         * @brief Final blocks of a message: the tail, 0x80, zeros and the
+         * bit length. Writes one or two blocks into `out`.
+         *
+         * @return size_t Number of 64-byte blocks written.
+         */
+        size_t pad_tail(const uint8_t *tail, size_t tail_len, uint64_t total_len, uint8_t out[128])
+        {
+            const size_t blocks = tail_len < 56 ? 1 : 2;
+            std::memset(out, 0, blocks * 64);
+            std::memcpy(out, tail, tail_len);
+            out[tail_len] = 0x80;
+            const uint64_t bits = total_len * 8;
+            for (size_t i = 0; i < 8; i++)
+            {
+                out[blocks * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+            }
+            return blocks;
+        }
+
+        // Intel SHA extensions. The state is kept as ABEF/CDGH pairs, the
+        // layout sha256rnds2 expects.
+        __attribute__((target("sha,sse4.1,ssse3"))) void compress_shani(uint32_t state[8], const uint8_t *data, size_t blocks)
+        {
+            const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+            __m128i tmp = _mm_loadu_si128((const __m128i *)(&state[0]));
+            __m128i state1 = _mm_loadu_si128((const __m128i *)(&state[4]));
+            tmp = _mm_shuffle_epi32(tmp, 0xB1);
+            state1 = _mm_shuffle_epi32(state1, 0x1B);
+            __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+            state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+            for (size_t b = 0; b < blocks; b++, data += 64)
+            {
+                const __m128i abef_save = state0;
+                const __m128i cdgh_save = state1;
+                __m128i msg[4];
+
+                // 16 groups of four rounds; the schedule runs three
+                // groups ahead in msg[]
+                for (size_t i = 0; i < 16; i++)
+                {
+                    if (i < 4)
+                    {
+                        msg[i] = _mm_shuffle_epi8(
+                            _mm_loadu_si128((const __m128i *)(data + 16 * i)), byte_swap);
+                    }
+                    __m128i rounds = _mm_add_epi32(
+                        msg[i % 4], _mm_load_si128((const __m128i *)(&round_k[4 * i])));
+                    state1 = _mm_sha256rnds2_epu32(state1, state0, rounds);
+                    if (i >= 3 && i <= 14)
+                    {
+                        __m128i next = _mm_add_epi32(
+                            msg[(i + 1) % 4], _mm_alignr_epi8(msg[i % 4], msg[(i + 3) % 4], 4));
+                        msg[(i + 1) % 4] = _mm_sha256msg2_epu32(next, msg[i % 4]);
+                    }
+                    rounds = _mm_shuffle_epi32(rounds, 0x0E);
+                    state0 = _mm_sha256rnds2_epu32(state0, state1, rounds);
+                    if (i >= 1 && i <= 12)
+                    {
+                        msg[(i + 3) % 4] = _mm_sha256msg1_epu32(msg[(i + 3) % 4], msg[i % 4]);
+                    }
+                }
+
+                state0 = _mm_add_epi32(state0, abef_save);
+                state1 = _mm_add_epi32(state1, cdgh_save);
+            }
+
+            tmp = _mm_shuffle_epi32(state0, 0x1B);
+            state1 = _mm_shuffle_epi32(state1, 0xB1);
+            state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+            state1 = _mm_alignr_epi8(state1, tmp, 8);
+            _mm_storeu_si128((__m128i *)(&state[0]), state0);
+            _mm_storeu_si128((__m128i *)(&state[4]), state1);
+        }
+
+        __attribute__((target("avx2"))) inline __m256i rotr8(__m256i x, int n)
+        {
+            return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+        }
+
+        /**
+         * @brief Eight independent compressions, lane j reading its blocks
+         * at `base + j * stride`.
+         */
+        __attribute__((target("avx2"))) void compress_avx2(__m256i state[8], const uint8_t *base, size_t stride, size_t blocks)
+        {
+            const __m256i byte_swap = _mm256_set_epi8(
+                12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+            const __m256i lane_offset = _mm256_mullo_epi32(
+                _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0),
+                _mm256_set1_epi32((int)stride));
+
+            for (size_t b = 0; b < blocks; b++)
+            {
+                __m256i w[16];
+                for (size_t t = 0; t < 16; t++)
+                {
+                    const __m256i index = _mm256_add_epi32(
+                        lane_offset, _mm256_set1_epi32((int)(b * 64 + t * 4)));
+                    w[t] = _mm256_shuffle_epi8(
+                        _mm256_i32gather_epi32((const int *)base, index, 1), byte_swap);
+                }
+
+                __m256i a = state[0], bb = state[1], c = state[2], d = state[3];
+                __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+                for (size_t t = 0; t < 64; t++)
+                {
+                    if (t >= 16)
+                    {
+                        const __m256i w15 = w[(t - 15) % 16];
+                        const __m256i w2 = w[(t - 2) % 16];
+                        const __m256i s0 = _mm256_xor_si256(
+                            _mm256_xor_si256(rotr8(w15, 7), rotr8(w15, 18)), _mm256_srli_epi32(w15, 3));
+                        const __m256i s1 = _mm256_xor_si256(
+                            _mm256_xor_si256(rotr8(w2, 17), rotr8(w2, 19)), _mm256_srli_epi32(w2, 10));
+                        w[t % 16] = _mm256_add_epi32(
+                            _mm256_add_epi32(w[t % 16], s0),
+                            _mm256_add_epi32(w[(t - 7) % 16], s1));
+                    }
+                    const __m256i sigma1 = _mm256_xor_si256(
+                        _mm256_xor_si256(rotr8(e, 6), rotr8(e, 11)), rotr8(e, 25));
+                    const __m256i ch = _mm256_xor_si256(
+                        _mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                    const __m256i t1 = _mm256_add_epi32(
+                        _mm256_add_epi32(_mm256_add_epi32(h, sigma1), ch),
+                        _mm256_add_epi32(_mm256_set1_epi32((int)round_k[t]), w[t % 16]));
+                    const __m256i sigma0 = _mm256_xor_si256(
+                        _mm256_xor_si256(rotr8(a, 2), rotr8(a, 13)), rotr8(a, 22));
+                    const __m256i maj = _mm256_xor_si256(
+                        _mm256_xor_si256(_mm256_and_si256(a, bb), _mm256_and_si256(a, c)),
+                        _mm256_and_si256(bb, c));
+                    const __m256i t2 = _mm256_add_epi32(sigma0, maj);
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = _mm256_add_epi32(d, t1);
+                    d = c;
+                    c = bb;
+                    bb = a;
+                    a = _mm256_add_epi32(t1, t2);
+                }
+                state[0] = _mm256_add_epi32(state[0], a);
+                state[1] = _mm256_add_epi32(state[1], bb);
+                state[2] = _mm256_add_epi32(state[2], c);
+                state[3] = _mm256_add_epi32(state[3], d);
+                state[4] = _mm256_add_epi32(state[4], e);
+                state[5] = _mm256_add_epi32(state[5], f);
+                state[6] = _mm256_add_epi32(state[6], g);
+                state[7] = _mm256_add_epi32(state[7], h);
+            }
+        }
+
+        /**
+         * @brief Hash eight messages of `size` bytes at `data + j * size`.
+         *
+         */
+        __attribute__((target("avx2"))) void hash8_avx2(const uint8_t *data, size_t size, sha256::digest *out)
+        {
+            __m256i state[8];
+            for (size_t i = 0; i < 8; i++)
+            {
+                state[i] = _mm256_set1_epi32((int)initial_state[i]);
+            }
+
+            const size_t full_blocks = size / 64;
+            compress_avx2(state, data, size, full_blocks);
+
+            // every lane has the same length, hence the same padding
+            const size_t tail_len = size % 64;
+            alignas(32) uint8_t tails[8][128];
+            size_t tail_blocks = 0;
+            for (size_t j = 0; j < 8; j++)
+            {
+                tail_blocks = pad_tail(data + j * size + full_blocks * 64, tail_len, size, tails[j]);
+            }
+            compress_avx2(state, &tails[0][0], 128, tail_blocks);
+
+            alignas(32) uint32_t words[8][8];
+            for (size_t i = 0; i < 8; i++)
+            {
+                _mm256_store_si256((__m256i *)(words[i]), state[i]);
+            }
+            for (size_t j = 0; j < 8; j++)
+            {
+                for (size_t i = 0; i < 8; i++)
+                {
+                    store_be32(out[j].data() + 4 * i, words[i][j]);
+                }
+            }
+        }
+    }
+
+    bool sha256::supported(backend b)
+    {
+        static const bool has_shani = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        switch (b)
+        {
+        case backend::shani:
+            return has_shani;
+        case backend::avx2:
+            return has_avx2;
+        default:
+            return true;
+        }
+    }
+
+    sha256::backend sha256::best_backend()
+    {
+        return supported(backend::shani) ? backend::shani : backend::portable;
+    }
+
+    sha256::context::context(backend b)
+        : backend_(b == backend::shani ? b : backend::portable),
+          buf_len_(0),
+          total_len_(0)
+    {
+        assert(supported(backend_));
+        std::memcpy(state_, initial_state, sizeof(state_));
+    }
+
+    void sha256::context::update(const uint8_t *data, size_t size)
+    {
+        if (backend_ == backend::portable)
+        {
+            portable_.process(data, data + size);
+            return;
+        }
+
+        total_len_ += size;
+        if (buf_len_ > 0)
+        {
+            const size_t take = std::min(size, sizeof(buf_) - buf_len_);
+            std::memcpy(buf_ + buf_len_, data, take);
+            buf_len_ += take;
+            data += take;
+            size -= take;
+            if (buf_len_ < sizeof(buf_))
+            {
+                return;
+            }
+            compress_shani(state_, buf_, 1);
+            buf_len_ = 0;
+        }
+        const size_t blocks = size / 64;
+        if (blocks > 0)
+        {
+            compress_shani(state_, data, blocks);
+        }
+        buf_len_ = size % 64;
+        std::memcpy(buf_, data + blocks * 64, buf_len_);
+    }
+
+    sha256::digest sha256::context::finish()
+    {
+        digest out;
+        if (backend_ == backend::portable)
+        {
+            portable_.finish();
+            portable_.get_hash_bytes(out.begin(), out.end());
+            return out;
+        }
+
+        uint8_t tail[128];
+        const size_t blocks = pad_tail(buf_, buf_len_, total_len_, tail);
+        compress_shani(state_, tail, blocks);
+        for (size_t i = 0; i < 8; i++)
+        {
+            store_be32(out.data() + 4 * i, state_[i]);
+        }
+        return out;
+    }
+
+    sha256::digest sha256::hash(const uint8_t *data, size_t size)
+    {
+        return sha256::hash(data, size, best_backend());
+    }
+
+    sha256::digest sha256::hash(const uint8_t *data, size_t size, backend b)
+    {
+        context ctx(b);
+        ctx.update(data, size);
+        return ctx.finish();
+    }
+
+    void sha256::hash_many(const uint8_t *data, size_t size, size_t count, digest *out)
+    {
+        // eight AVX2 lanes outrun one SHA-NI stream on short messages
+        const backend b = supported(backend::avx2) ? backend::avx2 : best_backend();
+        sha256::hash_many(data, size, count, out, b);
+    }
+
+    void sha256::hash_many(const uint8_t *data, size_t size, size_t count, digest *out, backend b)
+    {
+        EASY_FUNCTION("sha256::hash_many");
+
+        size_t i = 0;
+        if (b == backend::avx2)
+        {
+            // gather offsets are 32-bit
+            assert(size * 8 < INT32_MAX);
+            for (; i + 8 <= count; i += 8)
+            {
+                hash8_avx2(data + i * size, size, out + i);
+            }
+            b = best_backend();
+        }
+        for (; i < count; i++)
+        {
+            out[i] = sha256::hash(data + i * size, size, b);
+        }
+    }
+
+}
@@ -0,0 +1,135 @@
+#include "share_verifier.hpp"
+
+#include <random>
+#include "libBLS/tools/utils.h"
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    namespace
+    {
+        // 128-bit scalars keep the forgery bound at 2^-128 while halving
+        // the cost of each scalar multiplication
+        constexpr mp_size_t scalar_limbs = 2;
+
+        libff::bigint<scalar_limbs> random_scalar(std::random_device &rd)
+        {
+            libff::bigint<scalar_limbs> r;
+            for (mp_size_t i = 0; i < scalar_limbs; i++)
+            {
+                r.data[i] = ((mp_limb_t)(rd()) << 32) | (mp_limb_t)(rd());
+            }
+            return r;
+        }
+
+        void bisect(
+            const libff::alt_bn128_G1 &hash_point,
+            const share_verifier::item *items,
+            size_t count,
+            bool known_bad,
+            std::vector<uint64_t> &bad,
+            size_t &checks)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+            if (!known_bad)
+            {
+                checks++;
+                if (share_verifier::batch_check(hash_point, items, count))
+                {
+                    return;
+                }
+            }
+            if (count == 1)
+            {
+                bad.push_back(items[0].voter_id);
+                return;
+            }
+
+            const size_t half = count / 2;
+            checks++;
+            if (share_verifier::batch_check(hash_point, items, half))
+            {
+                // the failure is in the right half
+                bisect(hash_point, items + half, count - half, true, bad, checks);
+                return;
+            }
+            bisect(hash_point, items, half, true, bad, checks);
+            bisect(hash_point, items + half, count - half, false, bad, checks);
+        }
+    }
+
+    bool share_verifier::batch_check(
+        const libff::alt_bn128_G1 &hash_point,
+        const item *items,
+        size_t count)
+    {
+        EASY_FUNCTION("batch_check");
+
+        std::random_device rd;
+        libff::alt_bn128_G1 sig_sum = libff::alt_bn128_G1::zero();
+        libff::alt_bn128_G2 pkey_sum = libff::alt_bn128_G2::zero();
+        for (size_t i = 0; i < count; i++)
+        {
+            const libff::bigint<scalar_limbs> r = random_scalar(rd);
+            sig_sum = sig_sum + r * items[i].sig;
+            pkey_sum = pkey_sum + r * items[i].pkey;
+        }
+
+        // the Miller loop needs affine points
+        if (sig_sum.is_zero() || pkey_sum.is_zero())
+        {
+            return sig_sum.is_zero() && pkey_sum.is_zero();
+        }
+
+        const libff::alt_bn128_Fq12 f = libff::alt_bn128_double_miller_loop(
+            libff::alt_bn128_precompute_G1(sig_sum),
+            libff::alt_bn128_precompute_G2(libff::alt_bn128_G2::one()),
+            libff::alt_bn128_precompute_G1(-hash_point),
+            libff::alt_bn128_precompute_G2(pkey_sum));
+        return libff::alt_bn128_final_exponentiation(f) == libff::alt_bn128_GT::one();
+    }
+
+    std::vector<uint64_t> share_verifier::find_invalid(
+        const std::array<uint8_t, 32> &hash,
+        const std::vector<item> &items,
+        size_t *checks)
+    {
+        EASY_FUNCTION("find_invalid");
+
+        std::vector<uint64_t> bad;
+        std::vector<item> candidates;
+        candidates.reserve(items.size());
+        for (const item &it : items)
+        {
+            if (!it.sig.is_well_formed() || !it.pkey.is_well_formed())
+            {
+                bad.push_back(it.voter_id);
+                continue;
+            }
+            candidates.push_back(it);
+        }
+
+        const libff::alt_bn128_G1 hash_point = ThresholdUtils::HashtoG1(
+            std::make_shared<std::array<uint8_t, 32>>(hash));
+
+        size_t check_count = 0;
+        bisect(hash_point, candidates.data(), candidates.size(), false, bad, check_count);
+        if (checks != nullptr)
+        {
+            *checks += check_count;
+        }
+
+        if (!bad.empty())
+        {
+            spdlog::debug("share_verifier: {} of {} shares invalid, {} checks",
+                          bad.size(), items.size(), check_count);
+        }
+        return bad;
+    }
+
+}
@@ -17,23 +17,14 @@ Transaction::Transaction(
 
 }
 
-Transaction::Transaction(const Transaction& tx)
+sha256::digest Transaction::signing_digest() const
 {
-    this->id_ = tx.id_; 
-    this->sender_ = tx.sender_; 
-    this->receiver_ = tx.receiver_; 
-    this->value_ = tx.value_; 
-    this->fee_ = tx.fee_;
-}
+    static const char domain[] = "tomchain/tx/v1"; 
 
-Transaction::Transaction()
-{
-    
-}
-
-Transaction::~Transaction()
-{
-    
+    sha256::context ctx; 
+    ctx.update((const uint8_t*)domain, sizeof(domain) - 1); 
+    ctx.update((const uint8_t*)this, sizeof(Transaction)); 
+    return ctx.finish(); 
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "tx_codec.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <immintrin.h>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+
+namespace tomchain
+{
+
+    namespace
+    {
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                      "tx_codec stores columns little-endian");
+
+        constexpr uint8_t mode_frame = 0;
+        constexpr uint8_t mode_delta = 1;
+        // mode, width, base
+        constexpr size_t column_header_size = 1 + 1 + sizeof(uint64_t);
+        // version, count
+        constexpr size_t header_size = 1 + sizeof(uint32_t);
+
+        constexpr uint64_t Transaction::*fields[tx_codec::column_count] = {
+            &Transaction::id_,
+            &Transaction::sender_,
+            &Transaction::receiver_,
+            &Transaction::value_,
+            &Transaction::fee_};
+
+        uint8_t byte_width(uint64_t value)
+        {
+            if (value == 0)
+            {
+                return 0;
+            }
+            return (uint8_t)((64 - __builtin_clzll(value) + 7) / 8);
+        }
+
+        void unpack_scalar(const uint8_t *src, uint8_t width, uint64_t base, size_t count, uint64_t *out)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t stored = 0;
+                std::memcpy(&stored, src + i * width, width);
+                out[i] = base + stored;
+            }
+        }
+
+        __attribute__((target("avx2"))) void unpack_avx2(const uint8_t *src, uint8_t width, uint64_t base, size_t count, uint64_t *out)
+        {
+            const __m256i vbase = _mm256_set1_epi64x((long long)base);
+            size_t i = 0;
+            switch (width)
+            {
+            case 1:
+                for (; i + 4 <= count; i += 4)
+                {
+                    int32_t packed;
+                    std::memcpy(&packed, src + i, sizeof(packed));
+                    __m256i v = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed));
+                    _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(v, vbase));
+                }
+                break;
+            case 2:
+                for (; i + 4 <= count; i += 4)
+                {
+                    __m128i packed = _mm_loadl_epi64((const __m128i *)(src + i * 2));
+                    __m256i v = _mm256_cvtepu16_epi64(packed);
+                    _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(v, vbase));
+                }
+                break;
+            case 4:
+                for (; i + 4 <= count; i += 4)
+                {
+                    __m128i packed = _mm_loadu_si128((const __m128i *)(src + i * 4));
+                    __m256i v = _mm256_cvtepu32_epi64(packed);
+                    _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(v, vbase));
+                }
+                break;
+            case 8:
+                for (; i + 4 <= count; i += 4)
+                {
+                    __m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 8));
+                    _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(v, vbase));
+                }
+                break;
+            default:
+                // odd widths have no zero-extending load
+                break;
+            }
+            unpack_scalar(src + i * width, width, base, count - i, out + i);
+        }
+    }
+
+    tx_codec::layout tx_codec::parse_layout(const std::string &name)
+    {
+        if (name == "columnar")
+        {
+            return layout::columns;
+        }
+        if (name != "rows")
+        {
+            spdlog::warn("unknown tx encoding {}, using rows", name);
+        }
+        return layout::rows;
+    }
+
+    bool tx_codec::simd_supported()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    void tx_codec::encode(
+        const std::vector<Transaction> &txs,
+        std::string &out)
+    {
+        EASY_FUNCTION("tx_codec::encode");
+
+        const size_t count = txs.size();
+        assert(count <= max_count);
+
+        out.clear();
+        out.reserve(header_size + column_count * (column_header_size + count * sizeof(uint64_t)));
+        out.push_back((char)version);
+        const uint32_t count32 = (uint32_t)count;
+        out.append((const char *)&count32, sizeof(count32));
+
+        for (auto field : fields)
+        {
+            uint64_t min = UINT64_MAX;
+            uint64_t max = 0;
+            uint64_t max_delta = 0;
+            bool ascending = true;
+            for (size_t i = 0; i < count; i++)
+            {
+                const uint64_t value = txs[i].*field;
+                min = std::min(min, value);
+                max = std::max(max, value);
+                if (i > 0)
+                {
+                    const uint64_t prev = txs[i - 1].*field;
+                    if (value < prev)
+                    {
+                        ascending = false;
+                    }
+                    else
+                    {
+                        max_delta = std::max(max_delta, value - prev);
+                    }
+                }
+            }
+            if (count == 0)
+            {
+                min = 0;
+            }
+
+            const uint8_t frame_width = byte_width(max - min);
+            const uint8_t delta_width = byte_width(max_delta);
+            const bool use_delta = count > 0 && ascending && delta_width < frame_width;
+            const uint8_t mode = use_delta ? mode_delta : mode_frame;
+            const uint8_t width = use_delta ? delta_width : frame_width;
+            const uint64_t base = use_delta ? txs[0].*field : min;
+
+            out.push_back((char)mode);
+            out.push_back((char)width);
+            out.append((const char *)&base, sizeof(base));
+            if (width == 0)
+            {
+                continue;
+            }
+
+            const size_t offset = out.size();
+            out.resize(offset + count * width);
+            char *dst = out.data() + offset;
+            for (size_t i = 0; i < count; i++)
+            {
+                const uint64_t value = txs[i].*field;
+                const uint64_t stored = use_delta
+                                            ? (i == 0 ? 0 : value - txs[i - 1].*field)
+                                            : value - min;
+                std::memcpy(dst + i * width, &stored, width);
+            }
+        }
+    }
+
+    size_t tx_codec::count(const uint8_t *data, size_t size)
+    {
+        if (size < header_size || data[0] != version)
+        {
+            return 0;
+        }
+        uint32_t count32;
+        std::memcpy(&count32, data + 1, sizeof(count32));
+        return count32;
+    }
+
+    bool tx_codec::decode(
+        const uint8_t *data,
+        size_t size,
+        columns &out,
+        bool use_simd)
+    {
+        EASY_FUNCTION("tx_codec::decode");
+
+        if (size < header_size || data[0] != version)
+        {
+            return false;
+        }
+        const size_t count = tx_codec::count(data, size);
+        if (count > max_count)
+        {
+            return false;
+        }
+        const bool simd = use_simd && tx_codec::simd_supported();
+
+        std::vector<uint64_t> *dst_columns[column_count] = {
+            &out.id, &out.sender, &out.receiver, &out.value, &out.fee};
+
+        size_t pos = header_size;
+        for (auto dst_column : dst_columns)
+        {
+            if (size - pos < column_header_size)
+            {
+                return false;
+            }
+            const uint8_t mode = data[pos];
+            const uint8_t width = data[pos + 1];
+            uint64_t base;
+            std::memcpy(&base, data + pos + 2, sizeof(base));
+            pos += column_header_size;
+
+            if ((mode != mode_frame && mode != mode_delta) ||
+                width > sizeof(uint64_t) ||
+                size - pos < count * width)
+            {
+                return false;
+            }
+
+            dst_column->resize(count);
+            uint64_t *dst = dst_column->data();
+            if (mode == mode_frame)
+            {
+                if (simd)
+                {
+                    unpack_avx2(data + pos, width, base, count, dst);
+                }
+                else
+                {
+                    unpack_scalar(data + pos, width, base, count, dst);
+                }
+            }
+            else
+            {
+                if (simd)
+                {
+                    unpack_avx2(data + pos, width, 0, count, dst);
+                }
+                else
+                {
+                    unpack_scalar(data + pos, width, 0, count, dst);
+                }
+                // the first stored delta is always zero
+                uint64_t running = base;
+                for (size_t i = 0; i < count; i++)
+                {
+                    running += dst[i];
+                    dst[i] = running;
+                }
+            }
+            pos += count * width;
+        }
+
+        return pos == size;
+    }
+
+}
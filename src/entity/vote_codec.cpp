@@ -0,0 +1,285 @@
+#include "vote_codec.hpp"
+
+#include <cstring>
+#include "spdlog/spdlog.h"
+#include <easy/profiler.h>
+#include "oneapi/tbb/parallel_for.h"
+
+namespace tomchain
+{
+
+    namespace
+    {
+        constexpr uint8_t flag_y_odd = 0x01;
+        constexpr uint8_t flag_infinity = 0x02;
+        constexpr size_t fq_bytes = 32;
+
+        static_assert(sizeof(mp_limb_t) == 8);
+        static_assert(libff::alt_bn128_q_limbs * sizeof(mp_limb_t) == fq_bytes);
+
+        void write_fq(const libff::alt_bn128_Fq &value, uint8_t *out)
+        {
+            const libff::bigint<libff::alt_bn128_q_limbs> repr = value.as_bigint();
+            for (size_t i = 0; i < libff::alt_bn128_q_limbs; i++)
+            {
+                const mp_limb_t limb = repr.data[libff::alt_bn128_q_limbs - 1 - i];
+                for (size_t j = 0; j < sizeof(mp_limb_t); j++)
+                {
+                    out[i * sizeof(mp_limb_t) + j] = (uint8_t)(limb >> (8 * (sizeof(mp_limb_t) - 1 - j)));
+                }
+            }
+        }
+
+        bool read_fq(const uint8_t *in, libff::alt_bn128_Fq &value)
+        {
+            libff::bigint<libff::alt_bn128_q_limbs> repr;
+            for (size_t i = 0; i < libff::alt_bn128_q_limbs; i++)
+            {
+                mp_limb_t limb = 0;
+                for (size_t j = 0; j < sizeof(mp_limb_t); j++)
+                {
+                    limb = (limb << 8) | in[i * sizeof(mp_limb_t) + j];
+                }
+                repr.data[libff::alt_bn128_q_limbs - 1 - i] = limb;
+            }
+            // reject non-canonical encodings
+            if (mpn_cmp(repr.data, libff::alt_bn128_modulus_q.data, libff::alt_bn128_q_limbs) >= 0)
+            {
+                return false;
+            }
+            value = libff::alt_bn128_Fq(repr);
+            return true;
+        }
+    }
+
+    vote_codec::encoding vote_codec::parse_encoding(const std::string &name)
+    {
+        if (name == "compressed")
+        {
+            return encoding::compressed;
+        }
+        if (name != "raw")
+        {
+            spdlog::warn("unknown vote encoding {}, using raw", name);
+        }
+        return encoding::raw;
+    }
+
+    void vote_codec::compress_points(
+        std::vector<libff::alt_bn128_G1> &points,
+        std::vector<std::string> &out)
+    {
+        EASY_FUNCTION("compress_points");
+
+        // normalize all non-zero points with one shared inversion
+        std::vector<size_t> non_zero_index;
+        std::vector<libff::alt_bn128_G1> non_zero;
+        non_zero_index.reserve(points.size());
+        non_zero.reserve(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (!points[i].is_zero())
+            {
+                non_zero_index.push_back(i);
+                non_zero.push_back(points[i]);
+            }
+        }
+        libff::alt_bn128_G1::batch_to_special_all_non_zeros(non_zero);
+        for (size_t k = 0; k < non_zero.size(); k++)
+        {
+            points[non_zero_index[k]] = non_zero[k];
+        }
+
+        out.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            std::string &bytes = out[i];
+            bytes.assign(compressed_share_size, '\0');
+            uint8_t *data = (uint8_t *)(bytes.data());
+            if (points[i].is_zero())
+            {
+                data[0] = flag_infinity;
+                continue;
+            }
+            data[0] = points[i].Y.as_bigint().test_bit(0) ? flag_y_odd : 0;
+            write_fq(points[i].X, data + 1);
+        }
+    }
+
+    bool vote_codec::decompress_point(std::string_view bytes, libff::alt_bn128_G1 &point)
+    {
+        if (bytes.size() != compressed_share_size)
+        {
+            return false;
+        }
+        const uint8_t *data = (const uint8_t *)(bytes.data());
+        const uint8_t flag = data[0];
+        if ((flag & ~(flag_y_odd | flag_infinity)) != 0)
+        {
+            return false;
+        }
+        if (flag & flag_infinity)
+        {
+            point = libff::alt_bn128_G1::zero();
+            return true;
+        }
+
+        libff::alt_bn128_Fq x;
+        if (!read_fq(data + 1, x))
+        {
+            return false;
+        }
+
+        // y^2 = x^3 + b
+        const libff::alt_bn128_Fq y2 = x.squared() * x + libff::alt_bn128_coeff_b;
+        // sqrt() expects a quadratic residue, so check Euler's criterion first
+        if ((y2 ^ libff::alt_bn128_Fq::euler) != libff::alt_bn128_Fq::one())
+        {
+            return false;
+        }
+        libff::alt_bn128_Fq y = y2.sqrt();
+        if (y.as_bigint().test_bit(0) != (bool)(flag & flag_y_odd))
+        {
+            y = -y;
+        }
+
+        point = libff::alt_bn128_G1(x, y, libff::alt_bn128_Fq::one());
+        return point.is_well_defined();
+    }
+
+    std::vector<std::string> vote_codec::encode_sig_shares(
+        const std::vector<std::shared_ptr<BlockVote>> &votes,
+        encoding enc)
+    {
+        EASY_FUNCTION("encode_sig_shares");
+
+        std::vector<std::string> out;
+        if (enc == encoding::compressed)
+        {
+            std::vector<libff::alt_bn128_G1> points;
+            points.reserve(votes.size());
+            for (const auto &vote : votes)
+            {
+                points.push_back(*(vote->sig_share_->getSigShare()));
+            }
+            compress_points(points, out);
+            return out;
+        }
+
+        static_assert(sizeof(libff::alt_bn128_G1) == raw_share_size);
+        out.resize(votes.size());
+        for (size_t i = 0; i < votes.size(); i++)
+        {
+            std::shared_ptr<libff::alt_bn128_G1> g1 = votes[i]->sig_share_->getSigShare();
+            out[i].assign((const char *)(g1.get()), raw_share_size);
+        }
+        return out;
+    }
+
+    std::vector<std::shared_ptr<BlockVote>> vote_codec::decode_batch(
+        const std::vector<entry> &entries,
+        encoding enc,
+        size_t required_signers,
+        size_t total_signers,
+        uint64_t batch_blocks,
+        uint64_t server_count)
+    {
+        EASY_FUNCTION("decode_batch");
+
+        std::vector<std::shared_ptr<BlockVote>> votes(entries.size());
+        auto decode_one = [&](size_t i)
+        {
+            const entry &e = entries[i];
+            // the size and first id key the server's batch containers
+            if (e.batch_size > 0 &&
+                (e.batch_size != batch_blocks ||
+                 e.block_id != Block::batch_first_id(e.block_id, e.batch_size, server_count)))
+            {
+                spdlog::warn("vote {}:{} covers no configured batch (size {})",
+                             e.block_id, e.voter_id, e.batch_size);
+                return;
+            }
+            auto g1 = std::make_shared<libff::alt_bn128_G1>();
+            if (enc == encoding::compressed)
+            {
+                // no honest share is the point at infinity
+                if (!decompress_point(e.sig_share, *g1) || g1->is_zero())
+                {
+                    spdlog::warn("vote {}:{} has invalid compressed sig share",
+                                 e.block_id, e.voter_id);
+                    return;
+                }
+            }
+            else
+            {
+                if (e.sig_share.size() != raw_share_size)
+                {
+                    spdlog::warn("vote {}:{} has malformed sig share ({} bytes)",
+                                 e.block_id, e.voter_id, e.sig_share.size());
+                    return;
+                }
+                std::memcpy((void *)(g1.get()), e.sig_share.data(), raw_share_size);
+                // the raw limbs are whatever the sender put there
+                if (g1->is_zero() || !g1->is_well_formed())
+                {
+                    spdlog::warn("vote {}:{} has sig share off the curve",
+                                 e.block_id, e.voter_id);
+                    return;
+                }
+            }
+
+            auto sp_vote = std::make_shared<BlockVote>();
+            if (e.batch_size > 0)
+            {
+                if (e.batch_root.size() != sha256::digest_size)
+                {
+                    spdlog::warn("vote {}:{} has malformed batch root ({} bytes)",
+                                 e.block_id, e.voter_id, e.batch_root.size());
+                    return;
+                }
+                sp_vote->batch_size_ = e.batch_size;
+                std::memcpy(sp_vote->batch_root_.data(), e.batch_root.data(), sha256::digest_size);
+            }
+            sp_vote->block_id_ = e.block_id;
+            sp_vote->voter_id_ = e.voter_id;
+            // client_id starts from 1, so does signer_index
+            try
+            {
+                sp_vote->sig_share_ = std::make_shared<BLSSigShare>(
+                    g1, std::string(e.hint), e.voter_id, required_signers, total_signers);
+            }
+            catch (const std::exception &ex)
+            {
+                // e.g. an empty hint or voter id 0
+                spdlog::warn("vote {}:{} has malformed sig share: {}",
+                             e.block_id, e.voter_id, ex.what());
+                return;
+            }
+            votes[i] = sp_vote;
+        };
+
+        if (enc == encoding::compressed && entries.size() > 1)
+        {
+            // a square root per point dominates, spread it over the pool
+            oneapi::tbb::parallel_for(
+                oneapi::tbb::blocked_range<size_t>(0, entries.size()),
+                [&](const oneapi::tbb::blocked_range<size_t> &range)
+                {
+                    for (size_t i = range.begin(); i != range.end(); i++)
+                    {
+                        decode_one(i);
+                    }
+                });
+        }
+        else
+        {
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                decode_one(i);
+            }
+        }
+
+        return votes;
+    }
+
+}
@@ -5,6 +5,8 @@
 
 #include "timercpp/timercpp.h"
 #include "spdlog/spdlog.h"
+#include "libBLS/tools/utils.h"
+#include "oneapi/tbb/parallel_for.h"
 #include "argparse/argparse.hpp"
 #include <nlohmann/json.hpp>
 
@@ -23,18 +25,45 @@ namespace tomchain
 {
 
     TcServer::TcServer()
+        : resp_bytes(0),
+          verify_shares(false),
+          shares_verified(0),
+          shares_rejected(0),
+          shares_unverified(0),
+          late_votes(0),
+          committee_size(0),
+          committee_seed(0),
+          vote_batch_blocks(0),
+          outsider_votes(0),
+          batch_commits(0),
+          bad_commits(0)
     {
     }
 
     TcServer::~TcServer()
     {
+        if (merge_engine != nullptr)
+        {
+            merge_engine->stop();
+        }
+        if (mempool != nullptr)
+        {
+            mempool->stop();
+        }
     }
 
     void TcServer::init_server()
     {
         spdlog::info("Initializing server");
         this->server_id = (*::conf_data)["server-id"];
-        this->blk_seq_generator = (*::conf_data)["server-id"].template get<uint64_t>() * 1000000UL;
+        this->blk_seq_generator = (*::conf_data)["server-id"].template get<uint64_t>() * block_id_stride;
+        this->relay_vote_encoding = vote_codec::parse_encoding(
+            (*::conf_data)["relay-vote-encoding"].template get<std::string>());
+        flatbuffers_adapter<Block>::set_tx_layout(tx_codec::parse_layout(
+            (*::conf_data)["tx-encoding"].template get<std::string>()));
+        this->verify_shares = (*::conf_data)["verify-sig-shares"].template get<bool>();
+        // a block pending past its deadline no longer holds up the log
+        this->announce_log.set_expire_ms((*::conf_data)["block-die-threshold"].template get<uint64_t>());
 
         rocksdb::Options options;
         options.create_if_missing = true;
@@ -42,6 +71,28 @@ namespace tomchain
         rocksdb::Status status =
             rocksdb::DB::Open(options, rocksdb_filename.c_str(), &db);
         assert(status.ok());
+
+        this->merge_engine = std::make_unique<MergeEngine>(
+            (*::conf_data)["merge-threads"].template get<size_t>(),
+            (*::conf_data)["merge-concurrency"].template get<size_t>(),
+            (*::conf_data)["merge-queue-limit"].template get<size_t>(),
+            [this](std::shared_ptr<Block> sp_block, size_t merge_threads)
+            { this->merge_votes(sp_block, merge_threads); });
+        this->merge_engine->start();
+
+        // senders map onto a fixed set of wallets, see Mempool
+        const size_t signer_count = (*::conf_data)["tx-signer-count"].template get<size_t>();
+        std::vector<ecdsa::PubKey> signer_pkeys;
+        for (size_t i = 0; i < signer_count; i++)
+        {
+            this->tx_signers.emplace_back();
+            signer_pkeys.push_back(this->tx_signers.back().CreatePubKey());
+        }
+        this->mempool = std::make_unique<Mempool>(
+            std::move(signer_pkeys),
+            (*::conf_data)["tx-verify-threads"].template get<size_t>(),
+            (*::conf_data)["tx-verify-queue"].template get<size_t>());
+        this->mempool->start();
     }
 
     void TcServer::init_peer_stubs()
@@ -113,13 +164,19 @@ namespace tomchain
                 continue;
             }
 
+            std::shared_ptr<grpc::Channel> peer_channel =
+                grpc::CreateChannel(
+                    peer_addr.at(i),
+                    grpc::InsecureChannelCredentials());
             grpc_peer_client_stub_.insert(
                 std::make_pair(
                     server_id,
-                    TcPeerConsensus::NewStub(
-                        grpc::CreateChannel(
-                            peer_addr.at(i),
-                            grpc::InsecureChannelCredentials()))));
+                    TcPeerConsensus::NewStub(peer_channel)));
+            // block relays send pre-encoded payloads over the same channel
+            grpc_peer_generic_stub_.insert(
+                std::make_pair(
+                    server_id,
+                    std::make_unique<grpc::GenericStub>(peer_channel)));
         }
     }
 
@@ -137,13 +194,26 @@ namespace tomchain
         std::shared_ptr<TcConsensusImpl> consensus_service = 
             std::make_shared<TcConsensusImpl>(); 
         consensus_service->tc_server_ = shared_from_tc_server;
+        std::shared_ptr<TcConsensusFbImpl> consensus_fb_service = 
+            std::make_shared<TcConsensusFbImpl>(); 
+        consensus_fb_service->tc_server_ = shared_from_tc_server;
 
         grpc::ServerBuilder builder;
         builder.AddListeningPort(
             (*::conf_data)["grpc-listen-addr"], 
             grpc::InsecureServerCredentials()
         ); 
-        builder.RegisterService(consensus_service.get());
+        // select client-facing wire format 
+        if ((*::conf_data)["rpc-codec"].template get<std::string>() == std::string{"flatbuffers"})
+        {
+            spdlog::info("Using FlatBuffers consensus service"); 
+            builder.RegisterService(consensus_fb_service.get());
+        }
+        else
+        {
+            spdlog::info("Using protobuf consensus service"); 
+            builder.RegisterService(consensus_service.get());
+        }
 
         grpc_server_ = builder.BuildAndStart();
         grpc_server_->Wait(); });
@@ -185,46 +255,517 @@ namespace tomchain
     {
         spdlog::info("Initializing client profile");
 
-        auto client_count =
-            (*::conf_data)["client-count"];
+        const size_t client_count =
+            (*::conf_data)["client-count"].template get<size_t>();
+        const size_t vote_threshold =
+            (*::conf_data)["vote-threshold"].template get<size_t>();
+        const size_t server_count =
+            (*::conf_data)["server-count"].template get<size_t>();
+        spdlog::info("Signing threshold {} of {}", vote_threshold, client_count);
+
+        this->committee_size = (*::conf_data)["committee-size"].template get<uint64_t>();
+        this->committee_seed = (*::conf_data)["committee-seed"].template get<uint64_t>();
+        if (this->committee_size > 0 && this->committee_size < client_count)
+        {
+            if (this->committee_size < vote_threshold)
+            {
+                spdlog::error("committee-size {} is below vote-threshold {}",
+                              this->committee_size, vote_threshold);
+                exit(-1);
+            }
+            spdlog::info("Sampling committees of {} per block", this->committee_size);
+        }
+        this->vote_batch_blocks = (*::conf_data)["vote-batch-blocks"].template get<uint64_t>();
+        if (this->vote_batch_blocks > 1 && this->committee_size > 0 && this->committee_size < client_count)
+        {
+            // members of a batch have different committees, and only the
+            // first one's is checked; clients vote per block then too
+            spdlog::warn("vote-batch-blocks is not supported with committee-size, rejecting batch votes");
+            this->vote_batch_blocks = 0;
+        }
+        this->committees = std::make_unique<committee_cache>(
+            this->committee_seed, client_count, this->committee_size);
 
-        DKGBLSWrapper dkg_obj(client_count, client_count);
-        std::shared_ptr<std::vector<libff::alt_bn128_Fr>> sshares =
-            dkg_obj.createDKGSecretShares();
+        // field arithmetic below runs before any libBLS object sets up the curve
+        libff::init_alt_bn128_params();
+
+        // with n-of-n the signer set is fixed from here on
+        if (vote_threshold == client_count)
+        {
+            lagrange::init_cache(client_count);
+        }
+
+        // derived from the shared seed, then mapped from disk on restart
+        const keystore::keys ks = keystore::load_or_generate(
+            (*::conf_data)["keystore-path"].template get<std::string>(),
+            vote_threshold,
+            client_count,
+            (*::conf_data)["keystore-seed"].template get<uint64_t>());
+
+        // line coefficients of the group key are computed once here
+        if ((*::conf_data)["verify-commits"].template get<bool>())
+        {
+            this->commit_verifier = std::make_unique<CommitVerifier>(ks.group_pkey);
+        }
 
         // client number starts from one
-        for (size_t i = 0; i < client_count; i++)
-        {
-            ClientProfile client_profile;
-            client_profile.id = i + 1;
-
-            // TSS keys
-            BLSPrivateKeyShare skey_share(
-                sshares->at(i),
-                client_count,
-                client_count);
-            BLSPublicKeyShare pkey_share(
-                sshares->at(i),
-                client_count,
-                client_count);
-            client_profile.tss_key = std::make_shared<std::pair<
-                std::shared_ptr<BLSPrivateKeyShare>,
-                std::shared_ptr<BLSPublicKeyShare>>>(
-                std::make_pair<
-                    std::shared_ptr<BLSPrivateKeyShare>,
-                    std::shared_ptr<BLSPublicKeyShare>>(
-                    std::make_shared<BLSPrivateKeyShare>(skey_share),
-                    std::make_shared<BLSPublicKeyShare>(
-                        pkey_share)));
-
-            clients.insert(
-                std::make_pair(
-                    client_profile.id,
-                    std::make_shared<ClientProfile>(
-                        client_profile)));
+        oneapi::tbb::parallel_for(
+            oneapi::tbb::blocked_range<size_t>(0, client_count),
+            [&](const oneapi::tbb::blocked_range<size_t> &range)
+            {
+                for (size_t i = range.begin(); i < range.end(); i++)
+                {
+                    std::shared_ptr<ClientProfile> client_profile =
+                        std::make_shared<ClientProfile>();
+                    client_profile->id = i + 1;
+                    client_profile->delivered = std::make_unique<DeliveryTracker>(
+                        server_count + 1,
+                        block_id_stride);
+
+                    // TSS keys; the public key share takes the stored point
+                    // instead of multiplying again
+                    const keystore::share &share = ks.shares[i];
+                    std::shared_ptr<std::vector<std::string>> pkey_strs =
+                        std::make_shared<std::vector<std::string>>(std::vector<std::string>{
+                            ThresholdUtils::fieldElementToString(share.pkey.X.c0),
+                            ThresholdUtils::fieldElementToString(share.pkey.X.c1),
+                            ThresholdUtils::fieldElementToString(share.pkey.Y.c0),
+                            ThresholdUtils::fieldElementToString(share.pkey.Y.c1)});
+                    client_profile->tss_key = std::make_shared<std::pair<
+                        std::shared_ptr<BLSPrivateKeyShare>,
+                        std::shared_ptr<BLSPublicKeyShare>>>(
+                        std::make_pair<
+                            std::shared_ptr<BLSPrivateKeyShare>,
+                            std::shared_ptr<BLSPublicKeyShare>>(
+                            std::make_shared<BLSPrivateKeyShare>(
+                                share.skey,
+                                vote_threshold,
+                                client_count),
+                            std::make_shared<BLSPublicKeyShare>(
+                                pkey_strs,
+                                vote_threshold,
+                                client_count)));
+
+                    clients.insert(
+                        std::make_pair(
+                            client_profile->id,
+                            client_profile));
+                }
+            });
+    }
+
+    std::string TcServer::register_client(uint64_t client_id, const std::vector<uint8_t> &pkey_data)
+    {
+        ecdsa::PubKey pkey(pkey_data);
+
+        // update ecdsa pubic key
+        ClientCHM::accessor accessor;
+        this->clients.find(accessor, client_id);
+        accessor->second->ecc_pkey = std::make_shared<ecdsa::PubKey>(
+            std::move(pkey));
+        std::string tss_sk = *(accessor->second->tss_key->first->toString());
+        accessor.release();
+
+        return tss_sk;
+    }
+
+    std::vector<std::shared_ptr<Block>> TcServer::pull_pending_blocks(uint64_t client_id)
+    {
+        EASY_FUNCTION("pull_pending_blocks");
+        std::vector<std::shared_ptr<Block>> new_blocks;
+
+        std::shared_ptr<ClientProfile> client = nullptr;
+        ClientCHM::const_accessor client_accessor;
+        if (this->clients.find(client_accessor, client_id))
+        {
+            client = client_accessor->second;
+        }
+        client_accessor.release();
+        if (client == nullptr)
+        {
+            return new_blocks;
+        }
+
+        // claim [begin, end) so that overlapping polls of one client
+        // do not deliver the same entries twice
+        const uint64_t end = this->announce_log.tail();
+        uint64_t begin = client->announce_cursor.load(std::memory_order_relaxed);
+        do
+        {
+            if (begin >= end)
+            {
+                return new_blocks;
+            }
+        } while (!client->announce_cursor.compare_exchange_weak(
+            begin, end, std::memory_order_relaxed));
+
+        this->announce_log.read(
+            begin,
+            end,
+            [&](uint64_t, const std::shared_ptr<Block> &blk)
+            {
+                // only the committee of a block pulls it
+                if (!this->is_committee_member(blk->header_.id_, client_id))
+                {
+                    return;
+                }
+
+                // a block announced again is not sent twice; neither is
+                // one that far behind its proposer, see DeliveryTracker
+                if (!client->delivered->mark(blk->header_.id_))
+                {
+                    return;
+                }
+
+                // read-only: dist_ts_ was stamped by announce_pending()
+                new_blocks.push_back(blk);
+            });
+
+        return new_blocks;
+    }
+
+    void TcServer::announce_pending(uint64_t block_id)
+    {
+        if (!this->pb_sync_labels.contains(block_id))
+        {
+            return;
+        }
+
+        BlockCHM::accessor accessor;
+        std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+        const bool is_found = this->pending_blks.find(accessor, block_id);
+        pb_sl_1.unlock();
+        if (!is_found || accessor->second == nullptr || accessor->second->announced_.exchange(true))
+        {
+            return;
+        }
+
+        // record distribution timestamp once, before any client can pull
+        // the block; readers of the log leave the header alone
+        std::shared_ptr<Block> block = accessor->second;
+        if (block->header_.dist_ts_ == 0)
+        {
+            block->header_.dist_ts_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            block->invalidate_payload();
+        }
+        accessor.release();
+
+        this->announce_log.append(block);
+    }
+
+    bool TcServer::visit_pending_block(uint64_t block_id, const std::function<void(const Block &)> &visitor)
+    {
+        BlockCHM::const_accessor accessor;
+        std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+        bool is_found = this->pending_blks.find(accessor, block_id);
+        pb_sl_1.unlock();
+        if (!is_found)
+        {
+            spdlog::trace("block not found");
+            return false;
+        }
+
+        // the accessor keeps vote insertion out while the block is read
+        visitor(*(accessor->second));
+        accessor.release();
+
+        return true;
+    }
+
+    void TcServer::handle_client_vote(uint64_t client_id, std::shared_ptr<BlockVote> vote)
+    {
+        const uint64_t block_id = vote->block_id_;
+
+        // check if dead block
+        EASY_BLOCK("check if dead block");
+        bool is_died = this->dead_block.contains(block_id);
+        if (is_died)
+        {
+            spdlog::trace("{}:block is dead", client_id);
+            return;
+        }
+        EASY_END_BLOCK;
+
+        // check if target server is this server
+        EASY_BLOCK("calculate target server id");
+        std::set<uint64_t> target_server_id_set = Block::get_server_id(block_id, (*::conf_data)["server-count"]);
+        // if this server is not BPS
+        if (target_server_id_set.find(this->server_id) == target_server_id_set.end())
+        {
+            // if remote
+            // insert vote into relay queue and skip this vote
+            for (auto iter = target_server_id_set.begin(); iter != target_server_id_set.end(); iter++)
+            {
+                this->relay_votes.find(*iter)->second->push(vote);
+            }
+            return;
+        }
+        else // relay to peer shadow server
+        {
+            for (auto iter = target_server_id_set.begin(); iter != target_server_id_set.end(); iter++)
+            {
+                if (*iter == this->server_id)
+                {
+                    continue;
+                }
+                this->relay_votes.find(*iter)->second->push(vote);
+            }
+        }
+        EASY_END_BLOCK;
+
+        if (vote->batch_size_ > 0)
+        {
+            this->add_batch_vote(client_id, vote);
+            return;
+        }
+
+        // find local block storage
+        EASY_BLOCK("find local block storage");
+        spdlog::trace("{}:find local block storage", client_id);
+        BlockCHM::accessor pb_accessor;
+        std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+        bool block_is_found = this->pending_blks.find(pb_accessor, block_id);
+        pb_sl_1.unlock();
+        if (!block_is_found)
+        {
+            spdlog::trace("{}:block not found", client_id);
+            return;
+        }
+        EASY_END_BLOCK;
+
+        // insert received vote
+        EASY_BLOCK("insert received vote");
+        spdlog::trace("{}:insert received vote", client_id);
+        pb_accessor->second->add_vote(client_id, vote);
+        pb_accessor->second->invalidate_payload();
+        spdlog::debug("{}:push vote into {} relay queue, vote count={}",
+                      client_id,
+                      block_id,
+                      pb_accessor->second->votes_.size());
+        EASY_END_BLOCK;
+
+        // if votes count enough
+        EASY_BLOCK("count votes");
+        spdlog::trace("{}:check if votes count enough", client_id);
+        std::shared_ptr<Block> enough_blk = nullptr;
+        if (pb_accessor->second->is_vote_enough((*::conf_data)["vote-threshold"]))
+        {
+            enough_blk = pb_accessor->second;
+            enough_blk->finalized_.store(true, std::memory_order_release);
+            this->merging_blks.insert(std::make_pair(block_id, enough_blk));
+            std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+            this->pending_blks.erase(pb_accessor);
+            pb_sl_1.unlock();
+        }
+
+        pb_accessor.release();
+        EASY_END_BLOCK;
+
+        if (enough_blk != nullptr)
+        {
+            spdlog::debug("push into merge engine");
+            this->queue_merge(enough_blk);
+        }
+    }
+
+    void TcServer::add_batch_vote(uint64_t client_id, std::shared_ptr<BlockVote> vote)
+    {
+        EASY_FUNCTION("add_batch_vote");
+        const uint64_t first_id = vote->block_id_;
+        const uint64_t vote_threshold = (*::conf_data)["vote-threshold"];
+
+        // a bogus root only collects votes of its own
+        const BatchKey key{first_id, vote->batch_size_, vote->batch_root_};
+        BatchCHM::accessor batch_accessor;
+        if (this->vote_batches.insert(batch_accessor, key))
+        {
+            const uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            // signed like a block whose digest is the batch root
+            auto sp_batch = std::make_shared<Block>();
+            sp_batch->header_.id_ = first_id;
+            sp_batch->header_.proposal_ts_ = now_ms;
+            sp_batch->header_.digest_ = vote->batch_root_;
+            sp_batch->batch_ = std::make_shared<const BatchCert>(
+                BatchCert{first_id, vote->batch_size_, vote->batch_root_});
+            sp_batch->is_batch_vote_ = true;
+            batch_accessor->second = sp_batch;
+
+            std::unique_lock<std::mutex> be_ul_1(this->batch_expiry_mutex);
+            this->batch_expiry.emplace_back(now_ms, key);
+            be_ul_1.unlock();
+        }
+        std::shared_ptr<Block> sp_batch = batch_accessor->second;
+
+        // votes_ belongs to the merge engine once the quorum is queued
+        if (sp_batch->is_vote_enough(vote_threshold))
+        {
+            late_votes.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        sp_batch->add_vote(client_id, vote);
+        const bool is_enough = sp_batch->is_vote_enough(vote_threshold);
+        batch_accessor.release();
+
+        if (is_enough)
+        {
+            this->queue_merge(sp_batch);
         }
     }
 
+    void TcServer::expire_vote_batches()
+    {
+        const uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        const uint64_t die_threshold = (*::conf_data)["block-die-threshold"];
+
+        std::unique_lock<std::mutex> be_ul_1(this->batch_expiry_mutex);
+        while (!this->batch_expiry.empty() &&
+               now_ms - this->batch_expiry.front().first > die_threshold)
+        {
+            // waits for a merge engine thread that still holds it
+            this->vote_batches.erase(this->batch_expiry.front().second);
+            this->batch_expiry.pop_front();
+        }
+        be_ul_1.unlock();
+    }
+
+    void TcServer::retry_vote_batches()
+    {
+        // one round per call, containers pushed back wait for the next
+        std::vector<std::shared_ptr<Block>> retries;
+        std::shared_ptr<Block> sp_batch;
+        while (this->batch_retries.try_pop(sp_batch))
+        {
+            retries.push_back(sp_batch);
+        }
+        for (auto &sp_batch : retries)
+        {
+            const BatchCert &cert = *(sp_batch->batch_);
+            if (this->vote_batches.count(BatchKey{cert.first_id, cert.size, cert.root}) == 0)
+            {
+                // expired
+                continue;
+            }
+            this->queue_merge(sp_batch);
+        }
+    }
+
+    void TcServer::queue_merge(std::shared_ptr<Block> sp_block)
+    {
+        // behind the overflow, so blocks merge in the order they got quorum
+        if (this->merge_overflow.empty() && this->merge_engine->try_push(sp_block))
+        {
+            return;
+        }
+        this->merge_overflow.push(std::move(sp_block));
+    }
+
+    void TcServer::drain_merge_overflow()
+    {
+        std::shared_ptr<Block> sp_block;
+        while (this->merge_overflow.try_pop(sp_block))
+        {
+            this->merge_engine->push(std::move(sp_block));
+        }
+    }
+
+    bool TcServer::is_committee_member(uint64_t block_id, uint64_t client_id) const
+    {
+        return this->committees->contains(block_id, client_id);
+    }
+
+    bool TcServer::is_vote_outside(uint64_t block_id, uint64_t voter_id)
+    {
+        if (this->is_committee_member(block_id, voter_id))
+        {
+            return false;
+        }
+        outsider_votes.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool TcServer::is_vote_late(const vote_codec::entry &e, vote_codec::encoding enc)
+    {
+        // batch containers are not keyed by block id, see add_batch_vote()
+        if (e.batch_size > 0)
+        {
+            return false;
+        }
+        if (this->committed_blks.count(e.block_id) > 0)
+        {
+            late_votes.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (this->merging_blks.count(e.block_id) == 0)
+        {
+            return false;
+        }
+
+        // the accessor orders this against take_held_votes()
+        HeldVoteCHM::accessor held_accessor;
+        this->held_votes.insert(held_accessor, e.block_id);
+        if (this->merging_blks.count(e.block_id) == 0)
+        {
+            // left merging meanwhile, the vote goes to the block itself
+            if (held_accessor->second.empty())
+            {
+                this->held_votes.erase(held_accessor);
+            }
+            return false;
+        }
+        if (held_accessor->second.size() >= (*::conf_data)["client-count"].template get<uint64_t>())
+        {
+            late_votes.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        held_accessor->second.push_back(
+            HeldVote{enc, e.voter_id, std::string(e.sig_share), std::string(e.hint)});
+        return true;
+    }
+
+    std::vector<std::shared_ptr<BlockVote>> TcServer::take_held_votes(uint64_t block_id)
+    {
+        std::vector<HeldVote> held;
+        HeldVoteCHM::accessor held_accessor;
+        if (this->held_votes.find(held_accessor, block_id))
+        {
+            held.swap(held_accessor->second);
+            this->held_votes.erase(held_accessor);
+        }
+        held_accessor.release();
+
+        std::vector<std::shared_ptr<BlockVote>> votes;
+        for (vote_codec::encoding enc : {vote_codec::encoding::raw, vote_codec::encoding::compressed})
+        {
+            std::vector<vote_codec::entry> entries;
+            for (const HeldVote &hv : held)
+            {
+                if (hv.enc == enc)
+                {
+                    entries.push_back({block_id, hv.voter_id, hv.sig_share, hv.hint, 0, {}});
+                }
+            }
+            if (entries.empty())
+            {
+                continue;
+            }
+            std::vector<std::shared_ptr<BlockVote>> decoded = vote_codec::decode_batch(
+                entries,
+                enc,
+                (*::conf_data)["vote-threshold"],
+                (*::conf_data)["client-count"]);
+            for (auto &vote : decoded)
+            {
+                if (vote != nullptr)
+                {
+                    votes.push_back(vote);
+                }
+            }
+        }
+        return votes;
+    }
+
     void TcServer::schedule()
     {
         Timer t;
@@ -309,11 +850,33 @@ namespace tomchain
                 std::unique_lock<std::shared_mutex> pb_ul_1(pb_sm_1);
                 const uint64_t pb_size = pending_blks.size();
                 pb_ul_1.unlock();
+                const MergeEngine::Stats merge_stats = merge_engine->take_stats();
+                const Mempool::Stats tx_stats = mempool->take_stats();
                 spdlog::info(
-                    "tx:{} | pb:{} | cb:{}",
-                    pending_txs.size(),
+                    "tx:{} | txv ok:{} bad:{} {:.0f}/s q:{} | pb:{} ann:{} | cb:{} | batched:{} badcert:{} | out:{} | shares ok:{} bad:{} unchecked:{} late:{} outside:{} | "
+                    "mq:{} merging:{} merged:{} lat avg:{:.2f}ms max:{:.2f}ms stalls:{}",
+                    tx_stats.ready,
+                    tx_stats.verified,
+                    tx_stats.rejected,
+                    tx_stats.verify_per_sec,
+                    tx_stats.queued_batches,
                     pb_size,
-                    committed_blks.size());
+                    announce_log.size(),
+                    committed_blks.size(),
+                    batch_commits.load(std::memory_order_relaxed),
+                    bad_commits.load(std::memory_order_relaxed),
+                    resp_bytes.load(std::memory_order_relaxed),
+                    shares_verified.load(std::memory_order_relaxed),
+                    shares_rejected.load(std::memory_order_relaxed),
+                    shares_unverified.load(std::memory_order_relaxed),
+                    late_votes.load(std::memory_order_relaxed),
+                    outsider_votes.load(std::memory_order_relaxed),
+                    merge_stats.queue_depth,
+                    merge_stats.in_flight,
+                    merge_stats.merged,
+                    merge_stats.avg_latency_ms,
+                    merge_stats.max_latency_ms,
+                    merge_stats.stalls);
                 count_flag = false;
             },
             (*::conf_data)["count_freq"]);
@@ -362,24 +925,25 @@ namespace tomchain
                 }
                 bcast_commit_flag = true;
                 this->bcast_commits();
+                this->expire_vote_batches();
+                this->retry_vote_batches();
                 // this->remove_dead_blocks();
                 bcast_commit_flag = false;
             },
             (*::conf_data)["scheduler_freq"]);
 
-        // merge votes
-        bool merge_flag = false;
+        // merge overflow, may wait for the merge engine
+        bool merge_overflow_flag = false;
         t.setInterval(
             [&]()
             {
-                if (merge_flag == true)
+                if (merge_overflow_flag == true)
                 {
                     return;
                 }
-                merge_flag = true;
-                spdlog::trace("merge_votes thread");
-                this->merge_votes();
-                merge_flag = false;
+                merge_overflow_flag = true;
+                this->drain_merge_overflow();
+                merge_overflow_flag = false;
             },
             (*::conf_data)["scheduler_freq"]);
 
@@ -444,6 +1008,7 @@ namespace tomchain
                     spdlog::trace("remove block ({}) from pending", block_id);
                     this->dead_block.insert(block_id);
 
+                    pb_accessor->second->finalized_.store(true, std::memory_order_release);
                     this->pending_blks.erase(pb_accessor);
                 }
             }
@@ -454,171 +1019,411 @@ namespace tomchain
         spdlog::trace("remove_dead_blocks ends ");
     }
 
-    void TcServer::merge_votes()
+    void TcServer::merge_votes(std::shared_ptr<Block> sp_block, size_t merge_threads)
     {
         spdlog::trace("merge_votes starts ");
 
-        std::shared_ptr<Block> sp_block;
-        while (pb_merge_queue.try_pop(sp_block))
-        {
-            sp_block->merge_votes((*::conf_data)["client-count"]);
-
-            // get latency in milliseconds
-            uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-            uint64_t latency = now_ms - sp_block->header_.proposal_ts_;
-            spdlog::info("LocalCommit blockid={}, latency={}", sp_block->header_.id_, latency);
-
-            // record commit timestamp
-            sp_block->header_.commit_ts_ = now_ms;
-
-            // record recv timestamp
-            sp_block->header_.recv_ts_ = now_ms;
-
-            // print committed block info in log
-            spdlog::debug("LocalCommit block={}, proposal_ts={}, dist_ts={}, commit_ts={}, recv_ts={}",
-                          sp_block->header_.id_,
-                          sp_block->header_.proposal_ts_,
-                          sp_block->header_.dist_ts_,
-                          sp_block->header_.commit_ts_,
-                          sp_block->header_.recv_ts_);
-
-            // insert block to committed
-            BlockCHM::accessor cb_accessor;
-            this->committed_blks.insert(
-                cb_accessor,
-                sp_block->header_.id_);
-            cb_accessor->second = sp_block;
-
-            // insert into rocksdb
-            EASY_BLOCK("rocksdb");
-            // serialize
-            auto blk_bv = flexbuffers_adapter<Block>::to_bytes(*sp_block);
-            std::string ser_blk(blk_bv->begin(), blk_bv->end());
-            // put
-            std::unique_lock<std::mutex> db_ul_1(this->db_mutex);
-            std::string block_name = std::string{"block-"} + std::to_string(sp_block->header_.id_);
-            this->db->Put(rocksdb::WriteOptions(), block_name.c_str(), ser_blk);
-            db_ul_1.unlock();
-            EASY_END_BLOCK;
+        if (sp_block->is_batch_vote_)
+        {
+            this->certify_batch(sp_block, merge_threads);
+            return;
+        }
+
+        if (!this->check_votes(sp_block))
+        {
+            return;
+        }
+
+        sp_block->merge_votes(
+            (*::conf_data)["vote-threshold"],
+            (*::conf_data)["client-count"],
+            merge_threads);
+
+        this->commit_block(sp_block);
+
+        spdlog::trace("merge_votes ends ");
+    }
 
-            // insert block to bcast commit
-            for (
-                auto iter = this->bcast_commit_blocks.begin();
-                iter != this->bcast_commit_blocks.end();
-                iter++)
+    void TcServer::certify_batch(std::shared_ptr<Block> sp_batch, size_t merge_threads)
+    {
+        EASY_FUNCTION("certify_batch");
+        const BatchCert &cert = *(sp_batch->batch_);
+        const uint64_t server_count = (*::conf_data)["server-count"];
+
+        // merged already if this is a retry
+        if (sp_batch->tss_sig_ == nullptr)
+        {
+            if (!this->check_votes(sp_batch))
             {
-                iter->second->push(cb_accessor->second);
+                return;
             }
 
-            cb_accessor.release();
+            sp_batch->merge_votes(
+                (*::conf_data)["vote-threshold"],
+                (*::conf_data)["client-count"],
+                merge_threads);
+        }
 
-            // remove block from pending
-            spdlog::trace("remove block ({}) from pending", sp_block->header_.id_);
-            // this->pending_blks.erase(sp_block->header_.id_);
+        // members committed or merging on per-block votes still count for the root
+        std::vector<merkle::digest> digests(cert.size);
+        for (uint64_t i = 0; i < cert.size; i++)
+        {
+            const uint64_t block_id = Block::batch_member_id(cert.first_id, i, server_count);
+            BlockCHM::const_accessor member_accessor;
+            std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+            const bool is_found =
+                this->pending_blks.find(member_accessor, block_id) ||
+                this->merging_blks.find(member_accessor, block_id) ||
+                this->committed_blks.find(member_accessor, block_id);
+            pb_sl_1.unlock();
+            if (!is_found)
+            {
+                // the member may still be on its way from its proposer
+                spdlog::debug("batch {}: member {} unknown, retrying", cert.first_id, block_id);
+                this->batch_retries.push(sp_batch);
+                return;
+            }
+            digests[i] = member_accessor->second->header_.digest_;
+        }
 
-            // this->bcast_commits();
+        merkle::tree tree(digests);
+        if (tree.root() != cert.root)
+        {
+            spdlog::warn("batch {}: root mismatch, not certified", cert.first_id);
+            return;
         }
 
-        spdlog::trace("merge_votes ends ");
+        for (uint64_t i = 0; i < cert.size; i++)
+        {
+            // taking a block out of the pending pool claims it
+            const uint64_t block_id = Block::batch_member_id(cert.first_id, i, server_count);
+            std::shared_ptr<Block> sp_block = nullptr;
+            BlockCHM::accessor pb_accessor;
+            std::shared_lock<std::shared_mutex> pb_sl_1(this->pb_sm_1);
+            if (this->pending_blks.find(pb_accessor, block_id))
+            {
+                sp_block = pb_accessor->second;
+                sp_block->finalized_.store(true, std::memory_order_release);
+                this->pending_blks.erase(pb_accessor);
+            }
+            pb_sl_1.unlock();
+            pb_accessor.release();
+            if (sp_block == nullptr)
+            {
+                continue;
+            }
+
+            sp_block->tss_sig_ = sp_batch->tss_sig_;
+            sp_block->batch_ = sp_batch->batch_;
+            sp_block->batch_index_ = i;
+            sp_block->batch_proof_ = tree.prove(i, i + 1);
+            this->commit_block(sp_block);
+            batch_commits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // the container stays until expire_vote_batches(), turning later
+        // votes for the batch away as late
     }
 
-    void TcServer::generate_tx(uint64_t num_tx)
+    void TcServer::commit_block(std::shared_ptr<Block> sp_block)
     {
-        const uint64_t account_count = (*::conf_data)["account-count"];
-        std::random_device dev;
-        std::mt19937 rng(dev());
-        std::uniform_int_distribution<
-            std::mt19937::result_type>
-            distribution(1, account_count);
-
-        for (size_t i = 0; i < num_tx; i++)
+        // get latency in milliseconds
+        uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        uint64_t latency = now_ms - sp_block->header_.proposal_ts_;
+        spdlog::info("LocalCommit blockid={}, latency={}", sp_block->header_.id_, latency);
+
+        // record commit timestamp
+        sp_block->header_.commit_ts_ = now_ms;
+
+        // record recv timestamp
+        sp_block->header_.recv_ts_ = now_ms;
+        sp_block->invalidate_payload();
+
+        // print committed block info in log
+        spdlog::debug("LocalCommit block={}, proposal_ts={}, dist_ts={}, commit_ts={}, recv_ts={}",
+                      sp_block->header_.id_,
+                      sp_block->header_.proposal_ts_,
+                      sp_block->header_.dist_ts_,
+                      sp_block->header_.commit_ts_,
+                      sp_block->header_.recv_ts_);
+
+        // insert block to committed
+        BlockCHM::accessor cb_accessor;
+        this->committed_blks.insert(
+            cb_accessor,
+            sp_block->header_.id_);
+        cb_accessor->second = sp_block;
+        this->merging_blks.erase(sp_block->header_.id_);
+        // the quorum is in, votes held meanwhile are late
+        this->held_votes.erase(sp_block->header_.id_);
+
+        // insert into rocksdb
+        EASY_BLOCK("rocksdb");
+        // serialize
+        // encoded once, also reused by SPBcastCommit
+        std::shared_ptr<const std::string> ser_blk =
+            flatbuffers_adapter<Block>::payload(*sp_block);
+        // put
+        std::unique_lock<std::mutex> db_ul_1(this->db_mutex);
+        std::string block_name = std::string{"block-"} + std::to_string(sp_block->header_.id_);
+        this->db->Put(rocksdb::WriteOptions(), block_name.c_str(), *ser_blk);
+        db_ul_1.unlock();
+        EASY_END_BLOCK;
+
+        // insert block to bcast commit
+        for (
+            auto iter = this->bcast_commit_blocks.begin();
+            iter != this->bcast_commit_blocks.end();
+            iter++)
         {
-            uint64_t tx_id = distribution(rng);
-            uint64_t sender = distribution(rng);
-            uint64_t receiver = distribution(rng);
-            // uint64_t value = distribution(rng); 
-            uint64_t value = 0; 
-            uint64_t fee = distribution(rng);
-            Transaction tx(
-                tx_id,
-                sender,
-                receiver,
-                value,
-                fee);
-            pending_txs.insert(
-                std::make_pair(tx_id, std::make_shared<Transaction>(tx)));
+            iter->second->push(cb_accessor->second);
         }
+
+        cb_accessor.release();
+
+        // remove block from pending
+        spdlog::trace("remove block ({}) from pending", sp_block->header_.id_);
+        // this->pending_blks.erase(sp_block->header_.id_);
+
+        // this->bcast_commits();
     }
 
-    void TcServer::pack_block(uint64_t num_tx, uint64_t num_block)
+    bool TcServer::check_votes(std::shared_ptr<Block> sp_block)
     {
-        std::random_device dev;
-        std::mt19937 rng(dev());
-        std::uniform_int_distribution<
-            std::mt19937::result_type>
-            distribution(1, INT_MAX);
+        if (!this->verify_shares)
+        {
+            shares_unverified.fetch_add(sp_block->votes_.size(), std::memory_order_relaxed);
+            return true;
+        }
 
-        for (size_t i = 0; i < num_block; i++)
+        EASY_FUNCTION("check_votes");
+        const uint64_t vote_threshold = (*::conf_data)["vote-threshold"];
+
+        // voters whose share passed already
+        std::set<uint64_t> valid;
+        while (true)
         {
-            std::size_t pending_txs_size = pending_txs.size();
-            if (pending_txs_size >= num_tx)
+            // the block left the pending pool, so its votes are stable here
+            std::vector<share_verifier::item> items;
+            std::vector<uint64_t> bad;
+            items.reserve(sp_block->votes_.size());
+            for (auto iter = sp_block->votes_.begin(); iter != sp_block->votes_.end(); iter++)
+            {
+                const std::shared_ptr<BlockVote> &vote = iter->second;
+                if (valid.count(vote->voter_id_) > 0)
+                {
+                    continue;
+                }
+                ClientCHM::const_accessor client_accessor;
+                if (vote->sig_share_ == nullptr ||
+                    !this->clients.find(client_accessor, vote->voter_id_))
+                {
+                    bad.push_back(vote->voter_id_);
+                    continue;
+                }
+                items.push_back({vote->voter_id_,
+                                 *(vote->sig_share_->getSigShare()),
+                                 *(client_accessor->second->tss_key->second->getPublicKey())});
+            }
+
+            std::vector<uint64_t> invalid =
+                share_verifier::find_invalid(*(sp_block->get_sha256()), items);
+            bad.insert(bad.end(), invalid.begin(), invalid.end());
+            for (const share_verifier::item &item : items)
+            {
+                valid.insert(item.voter_id);
+            }
+            for (uint64_t voter_id : invalid)
             {
-                std::vector<uint64_t> extracted_tx;
-                TransactionCHM::iterator it;
-                BlockCHM::accessor accessor;
+                valid.erase(voter_id);
+            }
 
-                // construct new block
-                // uint64_t block_id = distribution(rng);
-                uint64_t block_id = this->blk_seq_generator.fetch_add(1, std::memory_order_seq_cst);
-                // TODO: base id
-                uint64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                Block new_block(block_id, 0xDEADBEEF, timestamp);
+            shares_verified.fetch_add(items.size() - invalid.size(), std::memory_order_relaxed);
+            shares_rejected.fetch_add(bad.size(), std::memory_order_relaxed);
+            if (bad.empty())
+            {
+                return true;
+            }
 
-                uint64_t tx_count = 0; 
-                for (it = pending_txs.begin(); it != pending_txs.end(); ++it)
+            if (sp_block->is_batch_vote_)
+            {
+                // the container never left vote_batches; its accessor keeps 
+                // add_batch_vote() out while the shares are dropped 
+                const BatchCert &cert = *(sp_block->batch_);
+                BatchCHM::accessor batch_accessor;
+                this->vote_batches.find(batch_accessor, BatchKey{cert.first_id, cert.size, cert.root});
+                for (uint64_t voter_id : bad)
                 {
-                    extracted_tx.push_back(it->first);
-                    new_block.tx_vec_.push_back(it->second);
-                    
-                    tx_count++; 
-                    if (tx_count >= num_tx) 
+                    spdlog::warn("batch {}: invalid signature share from voter {}",
+                                 sp_block->header_.id_, voter_id);
+                    for (auto iter = sp_block->votes_.begin(); iter != sp_block->votes_.end(); iter++)
                     {
-                        break; 
+                        if (iter->second->voter_id_ == voter_id)
+                        {
+                            sp_block->remove_vote(iter->first);
+                            break;
+                        }
                     }
                 }
-                auto p_block = std::make_shared<Block>(new_block);
-
-                spdlog::trace("pack tx count={}", p_block->tx_vec_.size());
+                // short of the quorum, add_batch_vote() queues it again
+                return sp_block->is_vote_enough(vote_threshold);
+            }
 
-                // add to relay blocks list
-                for (auto iter = relay_blocks.begin(); iter != relay_blocks.end(); iter++)
+            for (uint64_t voter_id : bad)
+            {
+                spdlog::warn("block {}: invalid signature share from voter {}",
+                             sp_block->header_.id_, voter_id);
+                for (auto iter = sp_block->votes_.begin(); iter != sp_block->votes_.end(); iter++)
                 {
-                    iter->second->push(p_block);
+                    if (iter->second->voter_id_ == voter_id)
+                    {
+                        sp_block->remove_vote(iter->first);
+                        break;
+                    }
                 }
-                // this->send_relay_blocks();
+            }
+            sp_block->invalidate_payload();
 
-                // insert into pending blocks
-                std::shared_lock<std::shared_mutex> pb_sl_1(pb_sm_1);
-                pending_blks.insert(
-                    accessor,
-                    block_id);
-                pb_sl_1.unlock();
-                accessor->second = p_block;
+            // all that is left has been checked
+            if (sp_block->is_vote_enough(vote_threshold))
+            {
+                return true;
+            }
 
-                // this->send_relay_block_sync(block_id);
+            // back to the pending pool until enough valid votes arrive
+            const uint64_t block_id = sp_block->header_.id_;
+            sp_block->finalized_.store(false, std::memory_order_release);
+            BlockCHM::accessor pb_accessor;
+            std::shared_lock<std::shared_mutex> pb_sl_1(pb_sm_1);
+            pending_blks.insert(
+                pb_accessor,
+                block_id);
+            pb_sl_1.unlock();
+            pb_accessor->second = sp_block;
+            this->merging_blks.erase(block_id);
 
-                spdlog::trace("gen block: {}", block_id);
+            // with the votes that came in while it was merging
+            std::vector<std::shared_ptr<BlockVote>> held = this->take_held_votes(block_id);
+            for (auto &vote : held)
+            {
+                sp_block->add_vote(vote->voter_id_, vote);
+            }
+            if (!sp_block->is_vote_enough(vote_threshold))
+            {
+                pb_accessor.release();
+                return false;
+            }
 
-                // remove extracted pending transactions
-                for (auto iter = extracted_tx.begin(); iter < extracted_tx.end(); iter++)
-                {
-                    pending_txs.erase(*iter);
-                }
+            // they complete the quorum: claim the block again and check them
+            sp_block->finalized_.store(true, std::memory_order_release);
+            this->merging_blks.insert(std::make_pair(block_id, sp_block));
+            std::shared_lock<std::shared_mutex> pb_sl_2(pb_sm_1);
+            pending_blks.erase(pb_accessor);
+            pb_sl_2.unlock();
+        }
+    }
+
+    void TcServer::generate_tx(uint64_t num_tx)
+    {
+        const uint64_t account_count = (*::conf_data)["account-count"];
+        const uint64_t batch_size = (*::conf_data)["tx-verify-batch"];
+        std::random_device dev;
+        std::mt19937 rng(dev());
+        std::uniform_int_distribution<
+            std::mt19937::result_type>
+            distribution(1, account_count);
+
+        for (uint64_t begin = 0; begin < num_tx; begin += batch_size)
+        {
+            const uint64_t count = std::min(batch_size, num_tx - begin);
+            SignedTxBatch batch;
+            batch.txs.reserve(count);
+            batch.sigs.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                uint64_t tx_id = distribution(rng);
+                uint64_t sender = distribution(rng);
+                uint64_t receiver = distribution(rng);
+                // uint64_t value = distribution(rng); 
+                uint64_t value = 0; 
+                uint64_t fee = distribution(rng);
+                batch.txs.emplace_back(
+                    tx_id,
+                    sender,
+                    receiver,
+                    value,
+                    fee);
             }
-            else
+
+            // wallets sign in parallel, standing in for many clients
+            EASY_BLOCK("sign txs");
+            oneapi::tbb::parallel_for(
+                oneapi::tbb::blocked_range<size_t>(0, count),
+                [&](const oneapi::tbb::blocked_range<size_t> &range)
+                {
+                    for (size_t i = range.begin(); i < range.end(); i++)
+                    {
+                        const Transaction &tx = batch.txs[i];
+                        const sha256::digest digest = tx.signing_digest();
+                        // a failed signing leaves the signature empty, which fails verification
+                        batch.sigs[i] = std::get<0>(
+                            this->tx_signers[tx.sender_ % this->tx_signers.size()].Sign(
+                                std::vector<uint8_t>(digest.begin(), digest.end())));
+                    }
+                });
+            EASY_END_BLOCK;
+
+            // waits while the verifiers are behind
+            this->mempool->submit(std::move(batch));
+        }
+    }
+
+    void TcServer::pack_block(uint64_t num_tx, uint64_t num_block)
+    {
+        // the most a columnar block decodes
+        num_tx = std::min<uint64_t>(num_tx, tx_codec::max_count);
+        for (size_t i = 0; i < num_block; i++)
+        {
+            // verified transactions move into the block
+            std::vector<Transaction> txs;
+            if (!this->mempool->take(num_tx, txs))
             {
                 break;
             }
+
+            BlockCHM::accessor accessor;
+
+            // construct new block
+            uint64_t block_id = this->blk_seq_generator.fetch_add(1, std::memory_order_seq_cst);
+            // TODO: base id
+            uint64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            auto p_block = std::make_shared<Block>(block_id, 0xDEADBEEF, timestamp);
+            p_block->tx_vec_ = std::move(txs);
+
+            // builds the Merkle tree in parallel; voters sign the
+            // resulting header digest
+            p_block->seal();
+
+            spdlog::trace("pack tx count={}", p_block->tx_vec_.size());
+
+            // add to relay blocks list
+            for (auto iter = relay_blocks.begin(); iter != relay_blocks.end(); iter++)
+            {
+                iter->second->push(p_block);
+            }
+            // this->send_relay_blocks();
+
+            // insert into pending blocks
+            std::shared_lock<std::shared_mutex> pb_sl_1(pb_sm_1);
+            pending_blks.insert(
+                accessor,
+                block_id);
+            pb_sl_1.unlock();
+            accessor->second = p_block;
+
+            // this->send_relay_block_sync(block_id);
+
+            spdlog::trace("gen block: {}", block_id);
         }
     }
 
@@ -709,6 +1514,7 @@ namespace tomchain
 
         this->pb_sync_labels.insert(block_id);
         spdlog::trace("block ({}) signaled locally", block_id);
+        this->announce_pending(block_id);
     }
 
 }
@@ -0,0 +1,183 @@
+#include "libBLS/libBLS.h"
+#include "libBLS/tools/utils.h"
+#include "block.hpp"
+#include "merkle.hpp"
+#include "commit_verifier.hpp"
+
+#include "spdlog/spdlog.h"
+#include "argparse/argparse.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace tomchain;
+
+namespace
+{
+    // keeps the compiler from dropping results
+    volatile size_t sink;
+
+    /**
+     * @brief Repeats `op` until `min_ms` has elapsed.
+     *
+     * @return Mean nanoseconds per call.
+     */
+    double time_op(const std::function<bool()> &op, uint64_t min_ms)
+    {
+        // warm up
+        sink = op();
+
+        uint64_t iters = 0;
+        const auto start = std::chrono::steady_clock::now();
+        auto now = start;
+        while (now - start < std::chrono::milliseconds(min_ms))
+        {
+            sink = sink + op();
+            iters++;
+            now = std::chrono::steady_clock::now();
+        }
+        return std::chrono::duration<double, std::nano>(now - start).count() / iters;
+    }
+
+    void report(const std::string &name, double ns, double baseline_ns)
+    {
+        spdlog::info("{:<28} {:>10.1f}us/commit {:>8.0f} commits/s {:>5.2f}x",
+                     name, ns / 1e3, 1e9 / ns, baseline_ns / ns);
+    }
+
+    std::shared_ptr<BLSSignature> sign(
+        const std::shared_ptr<BLSPrivateKeyShare> &skey,
+        const sha256::digest &message)
+    {
+        auto hash = std::make_shared<std::array<uint8_t, 32>>(message);
+        BLSSigShareSet sig_set(1, 1);
+        sig_set.addSigShare(skey->sign(hash, 1));
+        return sig_set.merge();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    argparse::ArgumentParser parser("tc-bench-commit-verify");
+    parser.add_argument("--min-ms")
+        .help("minimum run time per measurement in milliseconds")
+        .default_value(uint64_t{1000})
+        .scan<'u', uint64_t>();
+    parser.add_argument("--batch-size")
+        .help("blocks per batch certificate")
+        .default_value(uint64_t{64})
+        .scan<'u', uint64_t>();
+    parser.parse_args(argc, argv);
+    const uint64_t min_ms = parser.get<uint64_t>("--min-ms");
+    const uint64_t batch_size = parser.get<uint64_t>("--batch-size");
+
+    // with one signer the certificate is the group signature itself
+    auto keys = BLSPrivateKeyShare::generateSampleKeys(1, 1);
+    const std::shared_ptr<BLSPrivateKeyShare> skey = keys->first->at(0);
+    const std::shared_ptr<BLSPublicKey> group_pkey = keys->second;
+    const libff::alt_bn128_G2 pkey = *(group_pkey->getPublicKey());
+
+    Block block(1000001, 1000000, 1);
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        block.insert(Transaction(i, i % 97, i % 89, i, 1));
+    }
+    block.seal();
+    block.tss_sig_ = sign(skey, block.header_.digest_);
+    const libff::alt_bn128_G1 sig = *(block.tss_sig_->getSig());
+    const sha256::digest message = block.header_.digest_;
+    auto sp_message = std::make_shared<std::array<uint8_t, 32>>(message);
+
+    // the same block as member of a batch certificate
+    std::vector<merkle::digest> members(batch_size);
+    for (uint64_t i = 0; i < batch_size; i++)
+    {
+        members[i] = sha256::hash((const uint8_t *)(&i), sizeof(i));
+    }
+    const uint64_t index = batch_size / 2;
+    members[index] = block.header_.digest_;
+    const merkle::tree batch_tree(members);
+    Block batch_block(block);
+    batch_block.batch_ = std::make_shared<const BatchCert>(
+        BatchCert{block.header_.id_, batch_size, batch_tree.root()});
+    batch_block.batch_index_ = index;
+    batch_block.batch_proof_ = batch_tree.prove(index, index + 1);
+    batch_block.tss_sig_ = sign(skey, batch_tree.root());
+
+    const CommitVerifier verifier(pkey);
+
+    // sanity: valid certificates pass, a wrong message or signature fails
+    sha256::digest other = message;
+    other[0] ^= 0x01;
+    if (!verifier.verify(block) ||
+        !verifier.verify(batch_block) ||
+        verifier.verify(other, sig) ||
+        verifier.verify(message, sig + libff::alt_bn128_G1::one()) ||
+        !group_pkey->VerifySig(sp_message, block.tss_sig_))
+    {
+        spdlog::error("commit verification is broken");
+        return EXIT_FAILURE;
+    }
+
+    spdlog::info("per-commit certificate check, min {} ms per measurement", min_ms);
+
+    // baseline: BLSPublicKey, as a receiver without cached state would do
+    const double libbls_ns = time_op([&]()
+                                     { return group_pkey->VerifySig(sp_message, block.tss_sig_); },
+                                     min_ms);
+    report("libBLS VerifySig", libbls_ns, libbls_ns);
+
+    // two full pairings
+    report("two pairings",
+           time_op([&]()
+                   {
+                       libff::alt_bn128_G1 hash_point = ThresholdUtils::HashtoG1(sp_message);
+                       return libff::alt_bn128_reduced_pairing(sig, libff::alt_bn128_G2::one()) ==
+                              libff::alt_bn128_reduced_pairing(hash_point, pkey); },
+                   min_ms),
+           libbls_ns);
+
+    // one double Miller loop, G2 lines recomputed per check
+    report("double miller loop",
+           time_op([&]()
+                   {
+                       libff::alt_bn128_G1 hash_point = ThresholdUtils::HashtoG1(sp_message);
+                       const libff::alt_bn128_Fq12 f = libff::alt_bn128_double_miller_loop(
+                           libff::alt_bn128_precompute_G1(sig),
+                           libff::alt_bn128_precompute_G2(libff::alt_bn128_G2::one()),
+                           libff::alt_bn128_precompute_G1(-hash_point),
+                           libff::alt_bn128_precompute_G2(pkey));
+                       return libff::alt_bn128_final_exponentiation(f) == libff::alt_bn128_GT::one(); },
+                   min_ms),
+           libbls_ns);
+
+    // CommitVerifier, G2 lines cached
+    report("cached lines",
+           time_op([&]()
+                   { return verifier.verify(message, sig); },
+                   min_ms),
+           libbls_ns);
+    report("cached lines, block",
+           time_op([&]()
+                   { return verifier.verify(block); },
+                   min_ms),
+           libbls_ns);
+    report("cached lines, batch member",
+           time_op([&]()
+                   { return verifier.verify(batch_block); },
+                   min_ms),
+           libbls_ns);
+
+    // share of the check that is not the pairing
+    report("hash to G1 only",
+           time_op([&]()
+                   { return !ThresholdUtils::HashtoG1(sp_message).is_zero(); },
+                   min_ms),
+           libbls_ns);
+
+    return 0;
+}
@@ -0,0 +1,413 @@
+#include "libBLS/libBLS.h"
+#include "block.hpp"
+#include "msgpack_adapter.hpp"
+#include "flexbuffers_adapter.hpp"
+#include "flatbuffers_adapter.hpp"
+#include "alpaca_adapter.hpp"
+#include "block_view.hpp"
+#include "vote_codec.hpp"
+#include "tx_codec.hpp"
+
+#include "spdlog/spdlog.h"
+#include "argparse/argparse.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// count every heap allocation made by the codecs under test
+static std::atomic<uint64_t> alloc_count{0};
+
+void *operator new(std::size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace tomchain;
+
+namespace
+{
+    struct BenchResult
+    {
+        std::string codec;
+        std::string type;
+        size_t txs;
+        size_t votes;
+        size_t bytes;
+        double encode_ns;
+        double decode_ns;
+        double encode_allocs;
+        double decode_allocs;
+    };
+
+    struct OpStats
+    {
+        double ns;
+        double allocs;
+    };
+
+    // keeps the compiler from dropping decode results
+    volatile size_t sink;
+
+    /**
+     * @brief Repeats `op` until `min_ms` has elapsed.
+     *
+     * @return OpStats Mean time and heap allocations per call.
+     */
+    OpStats time_op(const std::function<void()> &op, uint64_t min_ms)
+    {
+        // warm up caches and thread-local builders
+        op();
+
+        uint64_t iters = 0;
+        const uint64_t allocs_before = alloc_count.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+        auto now = start;
+        uint64_t batch = 1;
+        while (now - start < std::chrono::milliseconds(min_ms))
+        {
+            for (uint64_t i = 0; i < batch; i++)
+            {
+                op();
+            }
+            iters += batch;
+            batch *= 2;
+            now = std::chrono::steady_clock::now();
+        }
+        const uint64_t allocs = alloc_count.load(std::memory_order_relaxed) - allocs_before;
+        const double ns = std::chrono::duration<double, std::nano>(now - start).count();
+
+        return OpStats{ns / iters, (double)allocs / iters};
+    }
+
+    class SerdeBench
+    {
+    public:
+        explicit SerdeBench(uint64_t min_ms) : min_ms_(min_ms) {}
+
+        /**
+         * @brief Times one codec on one object.
+         *
+         * @param encode Encodes the object into `bytes`.
+         * @param decode Decodes `bytes`.
+         */
+        void run(
+            const std::string &codec,
+            const std::string &type,
+            size_t txs,
+            size_t votes,
+            const std::function<void(std::string &)> &encode,
+            const std::function<void(const std::string &)> &decode)
+        {
+            std::string bytes;
+            encode(bytes);
+
+            OpStats enc = time_op([&]()
+                                  { encode(bytes); },
+                                  min_ms_);
+            OpStats dec = time_op([&]()
+                                  { decode(bytes); },
+                                  min_ms_);
+
+            BenchResult result{codec, type, txs, votes, bytes.size(), enc.ns, dec.ns, enc.allocs, dec.allocs};
+            spdlog::info("{:<14} {:<12} txs={:<6} votes={:<5} bytes={:<9} enc={:>10.0f}ns ({:>7.1f} MB/s, {:>7.1f} allocs) dec={:>10.0f}ns ({:>7.1f} MB/s, {:>7.1f} allocs)",
+                         codec, type, txs, votes, bytes.size(),
+                         enc.ns, mbps(bytes.size(), enc.ns), enc.allocs,
+                         dec.ns, mbps(bytes.size(), dec.ns), dec.allocs);
+            results_.push_back(result);
+        }
+
+        void write_csv(const std::string &path) const
+        {
+            std::ofstream csv(path);
+            csv << "codec,type,txs,votes,bytes,encode_ns,decode_ns,encode_mbps,decode_mbps,encode_allocs,decode_allocs\n";
+            for (const auto &r : results_)
+            {
+                csv << r.codec << ',' << r.type << ',' << r.txs << ',' << r.votes << ','
+                    << r.bytes << ',' << r.encode_ns << ',' << r.decode_ns << ','
+                    << mbps(r.bytes, r.encode_ns) << ',' << mbps(r.bytes, r.decode_ns) << ','
+                    << r.encode_allocs << ',' << r.decode_allocs << '\n';
+            }
+            spdlog::info("wrote {} results to {}", results_.size(), path);
+        }
+
+    private:
+        static double mbps(size_t bytes, double ns)
+        {
+            return ns == 0 ? 0 : (double)bytes / ns * 1e3;
+        }
+
+    private:
+        uint64_t min_ms_;
+        std::vector<BenchResult> results_;
+    };
+
+    template <typename T>
+    void msgpack_encode(const T &obj, std::string &out)
+    {
+        msgpack::sbuffer sbuf;
+        msgpack::pack(sbuf, obj);
+        out.assign(sbuf.data(), sbuf.size());
+    }
+
+    template <typename T>
+    void msgpack_decode(const std::string &bytes)
+    {
+        auto oh = msgpack::unpack(bytes.data(), bytes.size());
+        auto obj = oh->as<std::shared_ptr<T>>();
+        sink = (size_t)obj.get();
+    }
+
+    /**
+     * @brief Any adapter with the flexbuffers_codec entry points
+     * (flexbuffers_adapter, alpaca_adapter).
+     */
+    template <template <typename> class Adapter, typename T>
+    void bench_adapter(SerdeBench &bench, const std::string &codec, const std::string &type, size_t txs, size_t votes, const T &obj)
+    {
+        bench.run(
+            codec, type, txs, votes,
+            [&](std::string &out)
+            { Adapter<T>::to_bytes(obj, out); },
+            [&](const std::string &bytes)
+            { sink = (size_t)Adapter<T>::from_bytes(std::string_view(bytes)).get(); });
+    }
+
+    template <typename T, typename FbT>
+    void bench_flatbuffers(SerdeBench &bench, const std::string &type, const T &obj)
+    {
+        flatbuffers::FlatBufferBuilder fbb(1024);
+        bench.run(
+            "flatbuffers", type, 0, 0,
+            [&](std::string &out)
+            {
+                fbb.Clear();
+                fbb.Finish(flatbuffers_adapter<T>::build(fbb, obj));
+                out.assign((const char *)(fbb.GetBufferPointer()), fbb.GetSize());
+            },
+            [&](const std::string &bytes)
+            {
+                auto root = flatbuffers::GetRoot<FbT>(bytes.data());
+                sink = (size_t)flatbuffers_adapter<T>::from_fb(root).get();
+            });
+    }
+
+    void bench_block(
+        SerdeBench &bench,
+        size_t tx_count,
+        size_t vote_count,
+        std::shared_ptr<BLSSigShare> sig_share)
+    {
+        std::mt19937 rng(tx_count * 1024 + vote_count);
+        std::uniform_int_distribution<std::mt19937::result_type> distribution(1, 2000000);
+
+        Block block(1000001, 1000000, 1);
+        for (size_t i = 0; i < tx_count; i++)
+        {
+            block.insert(Transaction(
+                distribution(rng), distribution(rng), distribution(rng), 0, distribution(rng)));
+        }
+        for (size_t i = 1; i <= vote_count; i++)
+        {
+            auto vote = std::make_shared<BlockVote>();
+            vote->block_id_ = block.header_.id_;
+            vote->voter_id_ = i;
+            vote->sig_share_ = sig_share;
+            block.votes_.insert(std::make_pair(i, vote));
+        }
+
+        bench.run(
+            "msgpack", "Block", tx_count, vote_count,
+            [&](std::string &out)
+            { msgpack_encode(block, out); },
+            [&](const std::string &bytes)
+            { msgpack_decode<Block>(bytes); });
+
+        bench_adapter<flexbuffers_adapter>(bench, "flexbuffers", "Block", tx_count, vote_count, block);
+        bench_adapter<alpaca_adapter>(bench, "alpaca", "Block", tx_count, vote_count, block);
+
+        for (auto layout : {tx_codec::layout::rows, tx_codec::layout::columns})
+        {
+            flatbuffers_adapter<Block>::set_tx_layout(layout);
+            bench.run(
+                layout == tx_codec::layout::rows ? "flatbuffers" : "fb-columnar",
+                "Block", tx_count, vote_count,
+                [&](std::string &out)
+                { flatbuffers_adapter<Block>::to_bytes(block, out); },
+                [&](const std::string &bytes)
+                { sink = (size_t)flatbuffers_adapter<Block>::from_bytes(std::string_view(bytes)).get(); });
+        }
+        flatbuffers_adapter<Block>::set_tx_layout(tx_codec::layout::rows);
+    }
+
+    void bench_vote_batch(SerdeBench &bench, size_t vote_count, std::shared_ptr<BLSSigShare> sig_share)
+    {
+        std::vector<std::shared_ptr<BlockVote>> votes;
+        for (size_t i = 1; i <= vote_count; i++)
+        {
+            auto vote = std::make_shared<BlockVote>();
+            vote->block_id_ = 1000001;
+            vote->voter_id_ = i;
+            vote->sig_share_ = sig_share;
+            votes.push_back(vote);
+        }
+
+        for (auto enc : {vote_codec::encoding::raw, vote_codec::encoding::compressed})
+        {
+            // shares only; ids and hints are plain protobuf fields
+            std::vector<std::string> shares;
+            bench.run(
+                enc == vote_codec::encoding::raw ? "vote-raw" : "vote-compressed",
+                "BlockVote", 0, vote_count,
+                [&](std::string &out)
+                {
+                    shares = vote_codec::encode_sig_shares(votes, enc);
+                    out.clear();
+                    for (const auto &share : shares)
+                    {
+                        out += share;
+                    }
+                },
+                [&](const std::string &bytes)
+                {
+                    // entries point at the shares of the last encode, as
+                    // they would point into a parsed request
+                    std::vector<vote_codec::entry> entries;
+                    entries.reserve(votes.size());
+                    for (size_t i = 0; i < votes.size(); i++)
+                    {
+                        entries.push_back({votes[i]->block_id_, votes[i]->voter_id_, shares[i], sig_share->getHint()});
+                    }
+                    auto decoded = vote_codec::decode_batch(entries, enc, votes.size(), votes.size());
+                    sink = decoded.size();
+                });
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    argparse::ArgumentParser parser("tc-bench-serde");
+    parser.add_argument("--csv")
+        .help("output csv file")
+        .default_value(std::string{"bench_serde.csv"});
+    parser.add_argument("--min-ms")
+        .help("minimum run time per measurement in milliseconds")
+        .default_value(uint64_t{200})
+        .scan<'u', uint64_t>();
+    parser.add_argument("--quick")
+        .help("only the smallest and largest block sizes")
+        .default_value(false)
+        .implicit_value(true);
+    parser.parse_args(argc, argv);
+
+    SerdeBench bench(parser.get<uint64_t>("--min-ms"));
+
+    auto keys = BLSPrivateKeyShare::generateSampleKeys(1, 1);
+    std::array<uint8_t, 32> hash_arr{};
+    auto sp_hash_arr = std::make_shared<std::array<uint8_t, 32>>(hash_arr);
+    std::shared_ptr<BLSSigShare> sig_share = keys->first->at(0)->sign(sp_hash_arr, 1);
+
+    // BlockHeader
+    BlockHeader header(1000001, 1000000, 1);
+    bench.run(
+        "msgpack", "BlockHeader", 0, 0,
+        [&](std::string &out)
+        { msgpack_encode(header, out); },
+        [&](const std::string &bytes)
+        {
+            auto oh = msgpack::unpack(bytes.data(), bytes.size());
+            sink = oh->as<BlockHeader>().id_;
+        });
+    bench_adapter<flexbuffers_adapter>(bench, "flexbuffers", "BlockHeader", 0, 0, header);
+    bench_adapter<alpaca_adapter>(bench, "alpaca", "BlockHeader", 0, 0, header);
+    bench_flatbuffers<BlockHeader, fb::BlockHeader>(bench, "BlockHeader", header);
+
+    // BLSSigShare
+    bench.run(
+        "msgpack", "BLSSigShare", 0, 0,
+        [&](std::string &out)
+        { msgpack_encode(sig_share, out); },
+        [&](const std::string &bytes)
+        { msgpack_decode<BLSSigShare>(bytes); });
+    bench_adapter<flexbuffers_adapter>(bench, "flexbuffers", "BLSSigShare", 0, 0, *sig_share);
+    bench_adapter<alpaca_adapter>(bench, "alpaca", "BLSSigShare", 0, 0, *sig_share);
+    bench_flatbuffers<BLSSigShare, fb::BLSSigShare>(bench, "BLSSigShare", *sig_share);
+
+    // BlockVote
+    BlockVote vote;
+    vote.block_id_ = 1000001;
+    vote.voter_id_ = 1;
+    vote.sig_share_ = sig_share;
+    bench.run(
+        "msgpack", "BlockVote", 0, 1,
+        [&](std::string &out)
+        { msgpack_encode(vote, out); },
+        [&](const std::string &bytes)
+        { msgpack_decode<BlockVote>(bytes); });
+    bench_adapter<flexbuffers_adapter>(bench, "flexbuffers", "BlockVote", 0, 1, vote);
+    bench_adapter<alpaca_adapter>(bench, "alpaca", "BlockVote", 0, 1, vote);
+    bench_flatbuffers<BlockVote, fb::BlockVote>(bench, "BlockVote", vote);
+
+    std::vector<size_t> tx_counts{10, 100, 1000, 10000};
+    std::vector<size_t> vote_counts{1, 16, 256, 1024};
+    if (parser.get<bool>("--quick"))
+    {
+        tx_counts = {10, 10000};
+        vote_counts = {1, 1024};
+    }
+
+    for (size_t vote_count : vote_counts)
+    {
+        bench_vote_batch(bench, vote_count, sig_share);
+    }
+
+    // Block
+    for (size_t tx_count : tx_counts)
+    {
+        for (size_t vote_count : vote_counts)
+        {
+            bench_block(bench, tx_count, vote_count, sig_share);
+        }
+    }
+
+    bench.write_csv(parser.get<std::string>("--csv"));
+
+    return 0;
+}
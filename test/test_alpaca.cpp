@@ -0,0 +1,75 @@
+#include "alpaca_adapter.hpp"
+
+#include "spdlog/spdlog.h"
+
+using namespace tomchain;
+
+int main()
+{
+    std::array<uint8_t, 32> hash_arr{};
+    std::shared_ptr<std::array<uint8_t, 32>> spHashArr =
+        std::make_shared<std::array<uint8_t, 32>>(hash_arr);
+
+    auto keys = BLSPrivateKeyShare::generateSampleKeys(1, 1);
+    std::shared_ptr<BLSSigShare> sig_share = keys->first->at(0)->sign(spHashArr, 1);
+
+    // sig share
+    std::string ss_bytes;
+    alpaca_adapter<BLSSigShare>::to_bytes(*sig_share, ss_bytes);
+    auto sig_share_des = alpaca_adapter<BLSSigShare>::from_bytes(std::string_view(ss_bytes));
+    assert(*(sig_share_des->getSigShare()) == *(sig_share->getSigShare()));
+    assert(sig_share_des->getHint() == sig_share->getHint());
+    spdlog::info("sig_share: {} bytes", ss_bytes.size());
+
+    // a point off the curve is rejected
+    alpaca_wire::BLSSigShare bad_share = alpaca_adapter<BLSSigShare>::to_wire(*sig_share);
+    bad_share.g1[0] ^= 0x01;
+    assert(alpaca_adapter<BLSSigShare>::from_wire(bad_share) == nullptr);
+    alpaca_wire::BlockVote bad_vote{1, 1, bad_share};
+    assert(alpaca_adapter<BlockVote>::from_wire(bad_vote) == nullptr);
+
+    // header
+    BlockHeader header(7, 6, 5);
+    header.commit_ts_ = 4;
+    auto hdr_bytes = alpaca_adapter<BlockHeader>::to_bytes(header);
+    // fixed-width: seven uint64 fields, the tx root and the digest
+    assert(hdr_bytes->size() == 7 * sizeof(uint64_t) + 2 * sha256::digest_size);
+    auto hdr_des = alpaca_adapter<BlockHeader>::from_bytes(hdr_bytes);
+    assert(hdr_des->id_ == 7 && hdr_des->base_id_ == 6 && hdr_des->commit_ts_ == 4);
+    spdlog::info("header");
+
+    // block with a vote and one without a share
+    Block block(1, 0, 1);
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        block.insert(Transaction(i, i + 1, i + 2, i + 3, i + 4));
+    }
+    auto vote = std::make_shared<BlockVote>();
+    vote->block_id_ = 1;
+    vote->voter_id_ = 1;
+    vote->sig_share_ = sig_share;
+    block.votes_.insert(std::make_pair(1, vote));
+    auto empty_vote = std::make_shared<BlockVote>();
+    empty_vote->block_id_ = 1;
+    empty_vote->voter_id_ = 2;
+    block.votes_.insert(std::make_pair(2, empty_vote));
+
+    std::string blk_bytes;
+    alpaca_adapter<Block>::to_bytes(block, blk_bytes);
+    auto block_des = alpaca_adapter<Block>::from_bytes(std::string_view(blk_bytes));
+    assert(block_des != nullptr);
+    assert(block_des->header_.id_ == 1);
+    assert(block_des->tx_vec_.size() == 100);
+    assert(block_des->tx_vec_.at(99).fee_ == 103);
+    assert(block_des->votes_.size() == 2);
+    assert(*(block_des->votes_.at(1)->sig_share_->getSigShare()) == *(sig_share->getSigShare()));
+    assert(block_des->votes_.at(2)->sig_share_ == nullptr);
+    spdlog::info("block: {} bytes", blk_bytes.size());
+
+    // truncated input is rejected
+    auto truncated = alpaca_adapter<Block>::from_bytes(
+        std::string_view(blk_bytes).substr(0, blk_bytes.size() / 2));
+    assert(truncated == nullptr);
+
+    return 0;
+}
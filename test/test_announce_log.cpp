@@ -0,0 +1,119 @@
+#include "server/announce_log.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace tomchain;
+
+namespace
+{
+    std::shared_ptr<Block> make_block(uint64_t id, bool finalized)
+    {
+        auto block = std::make_shared<Block>(id, 0, 0);
+        block->finalized_.store(finalized);
+        return block;
+    }
+}
+
+int main()
+{
+    const uint64_t seg = AnnounceLog::segment_size;
+
+    // readers skip finalized entries, trim drops finalized segments
+    {
+        AnnounceLog log;
+        for (uint64_t i = 0; i < 2 * seg; i++)
+        {
+            assert(log.append(make_block(i, i < seg || i % 2 == 0)) == i);
+        }
+        uint64_t seen = 0;
+        log.read(0, log.tail(), [&](uint64_t seq, const std::shared_ptr<Block> &block)
+                 {
+                     assert(block->header_.id_ == seq);
+                     assert(seq >= seg && seq % 2 == 1);
+                     seen++; });
+        assert(seen == seg / 2);
+
+        // the first full segment goes with the next rollover
+        log.append(make_block(2 * seg, false));
+        assert(log.size() == seg + 1);
+        log.read(0, seg, [](uint64_t, const std::shared_ptr<Block> &)
+                 { assert(false); });
+    }
+
+    // one stuck block does not pin the log once its segment expires
+    {
+        AnnounceLog log(50);
+        log.append(make_block(0, false));
+        for (uint64_t i = 1; i < 3 * seg; i++)
+        {
+            log.append(make_block(i, true));
+        }
+        log.trim();
+        assert(log.size() == 3 * seg);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        log.trim();
+        // the tail segment stays
+        assert(log.size() == seg);
+    }
+
+    // concurrent appends, reads and trims
+    {
+        AnnounceLog log(1);
+        const uint64_t appenders = 4;
+        const uint64_t per_appender = 8 * seg;
+        std::atomic<uint64_t> done(0);
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < appenders; t++)
+        {
+            threads.emplace_back([&, t]()
+                                 {
+                                     for (uint64_t i = 0; i < per_appender; i++)
+                                     {
+                                         // every 100th block stays pending
+                                         log.append(make_block(t * per_appender + i, i % 100 != 0));
+                                     }
+                                     done++; });
+        }
+        for (uint64_t t = 0; t < 4; t++)
+        {
+            threads.emplace_back([&]()
+                                 {
+                                     uint64_t cursor = 0;
+                                     while (done.load() < appenders || cursor < log.tail())
+                                     {
+                                         const uint64_t end = log.tail();
+                                         log.read(cursor, end, [&](uint64_t seq, const std::shared_ptr<Block> &block)
+                                                  {
+                                                      assert(seq >= cursor && seq < end);
+                                                      assert(block->header_.id_ % per_appender % 100 == 0); });
+                                         cursor = end;
+                                     } });
+        }
+        threads.emplace_back([&]()
+                             {
+                                 while (done.load() < appenders)
+                                 {
+                                     log.trim();
+                                     std::this_thread::yield();
+                                 } });
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        assert(log.tail() == appenders * per_appender);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        log.trim();
+        assert(log.size() <= seg);
+    }
+
+    spdlog::info("announce log tests passed");
+    return 0;
+}
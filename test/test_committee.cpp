@@ -0,0 +1,73 @@
+#include "committee.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <vector>
+
+using namespace tomchain;
+
+int main()
+{
+    const uint64_t client_count = 2000;
+    const uint64_t size = 100;
+    const uint64_t seed = 42;
+
+    std::vector<uint64_t> hits(client_count + 1, 0);
+    const uint64_t block_count = 2000;
+    for (uint64_t block_id = 0; block_id < block_count; block_id++)
+    {
+        std::vector<uint64_t> picked = committee::members(block_id, seed, client_count, size);
+        assert(picked.size() == size);
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            assert(picked[i] >= 1 && picked[i] <= client_count);
+            // sorted and distinct
+            assert(i == 0 || picked[i - 1] < picked[i]);
+            hits[picked[i]]++;
+        }
+
+        // deterministic, and contains() agrees
+        assert(committee::members(block_id, seed, client_count, size) == picked);
+        assert(committee::contains(block_id, seed, client_count, size, picked.front()));
+        assert(committee::contains(block_id, seed, client_count, size, picked.back()));
+    }
+
+    // every client sits on about block_count * size / client_count committees
+    const uint64_t expected = block_count * size / client_count;
+    for (uint64_t client_id = 1; client_id <= client_count; client_id++)
+    {
+        assert(hits[client_id] > expected / 4 && hits[client_id] < expected * 4);
+    }
+
+    // another seed, another committee
+    assert(committee::members(7, seed, client_count, size) !=
+           committee::members(7, seed + 1, client_count, size));
+
+    // sampling off
+    assert(committee::members(7, seed, 16, 0).size() == 16);
+    assert(committee::members(7, seed, 16, 16).size() == 16);
+    assert(committee::contains(7, seed, 16, 0, 16));
+    assert(!committee::contains(7, seed, 16, 0, 17));
+    assert(!committee::contains(7, seed, client_count, size, 0));
+
+    // the cache agrees, also after evicting
+    committee_cache cache(seed, client_count, size, 16);
+    for (uint64_t round = 0; round < 2; round++)
+    {
+        for (uint64_t block_id = 0; block_id < 64; block_id++)
+        {
+            const std::vector<uint64_t> picked = committee::members(block_id, seed, client_count, size);
+            assert(*(cache.members(block_id)) == picked);
+            assert(cache.contains(block_id, picked[size / 2]));
+            assert(cache.contains(block_id, picked[0] + 1) ==
+                   committee::contains(block_id, seed, client_count, size, picked[0] + 1));
+        }
+    }
+    assert(!cache.contains(7, client_count + 1));
+    assert(committee_cache(seed, 16, 0).contains(7, 16));
+
+    spdlog::info("test_committee passed");
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "server/delivery_tracker.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+
+using namespace tomchain;
+
+int main()
+{
+    const uint64_t stride = 1ULL << 40;
+    const uint64_t window = DeliveryTracker::window;
+    DeliveryTracker tracker(3, stride);
+
+    // each block once; proposers are independent lanes
+    assert(tracker.mark(0));
+    assert(!tracker.mark(0));
+    assert(tracker.mark(stride));
+    assert(!tracker.mark(stride));
+
+    // a gap inside the window: the cursor waits at 1, later ids still count
+    assert(tracker.mark(2));
+    assert(tracker.mark(1));
+    assert(!tracker.mark(1));
+    assert(!tracker.mark(2));
+    // cursor moved past the run 0..2, behind it counts as delivered
+    assert(tracker.mark(5));
+    assert(tracker.mark(3));
+
+    // the last id of the window from cursor 4 still fits
+    assert(tracker.mark(4 + window - 1));
+    assert(tracker.mark(4));
+    assert(!tracker.mark(5));
+
+    // one past the window slides it; skipped ids behind it are given up
+    const uint64_t far = 6 + window + 10;
+    assert(tracker.mark(far));
+    assert(!tracker.mark(6));
+    assert(!tracker.mark(far - window));
+    // ids still inside the slid window are tracked
+    assert(tracker.mark(far - window + 1));
+    assert(!tracker.mark(far - window + 1));
+    assert(tracker.mark(far - 1));
+    assert(!tracker.mark(far));
+
+    // a jump of more than a whole window clears it
+    const uint64_t jump = far + 3 * window;
+    assert(tracker.mark(jump));
+    assert(!tracker.mark(far + 1));
+    assert(tracker.mark(jump - 1));
+    assert(!tracker.mark(jump - window));
+
+    // other lanes are untouched
+    assert(tracker.mark(2 * stride + 7));
+    assert(tracker.mark(stride + 1));
+
+    // unknown proposers are not tracked
+    assert(tracker.mark(3 * stride));
+    assert(tracker.mark(3 * stride));
+
+    spdlog::info("test_delivery_tracker passed");
+
+    return 0;
+}
@@ -1,7 +1,12 @@
 #include "flexbuffers_adapter.hpp"
+#include "flatbuffers_adapter.hpp"
+#include "block_view.hpp"
+#include "vote_codec.hpp"
+#include "tx_codec.hpp"
 
 #include "spdlog/spdlog.h"
 
+#include <cstring>
 #include <random>
 
 using namespace tomchain;
@@ -59,8 +64,249 @@ int main()
     std::shared_ptr<Block> block_des = flexbuffers_adapter<Block>::from_bytes(bytes);
 
     assert(block_des->header_.base_id_ == block.header_.base_id_);
+    // votes are nested maps, not separately encoded blobs
+    assert(block_des->votes_.size() == 1);
+    assert(*(block_des->votes_.at(1)->sig_share_->getSigShare()) == *(sig_share->getSigShare()));
+    assert(block_des->tss_sig_ != nullptr);
+    assert(*(block_des->tss_sig_->getSig()) == *(tss_sig->getSig()));
     spdlog::info("block");
 
+    // test flatbuffers block and in-place view
+    {
+        block.insert(Transaction(1, 2, 3, 4, 5));
+        block.insert(Transaction(6, 7, 8, 9, 10));
+
+        auto fb_bytes = flatbuffers_adapter<Block>::to_bytes(block);
+        BlockView view(fb_bytes->data(), fb_bytes->size());
+        assert(view.verify());
+        assert(view.id() == block.header_.id_);
+        assert(view.tx_count() == 2);
+        assert(view.tx_at(1).receiver() == 8);
+        assert(view.find_vote(1) != nullptr);
+        assert(view.find_vote(2) == nullptr);
+
+        auto fb_vote = view.get_vote(1);
+        assert(*(fb_vote->sig_share_->getSigShare()) == *(sig_share->getSigShare()));
+        assert(fb_vote->sig_share_->getSignerIndex() == sig_share->getSignerIndex());
+
+        // a share must be signed under the voter's own index
+        {
+            BlockVote forged = *fb_vote;
+            forged.voter_id_ = fb_vote->voter_id_ + 1;
+            flatbuffers::FlatBufferBuilder fbb;
+            fbb.Finish(flatbuffers_adapter<BlockVote>::build(fbb, forged));
+            assert(flatbuffers_adapter<BlockVote>::from_fb(
+                       flatbuffers::GetRoot<fb::BlockVote>(fbb.GetBufferPointer())) == nullptr);
+        }
+
+        auto fb_block = flatbuffers_adapter<Block>::from_bytes(fb_bytes);
+        assert(fb_block->header_.base_id_ == block.header_.base_id_);
+        assert(fb_block->tx_vec_.size() == 2);
+        assert(fb_block->tx_vec_.at(0).fee_ == 5);
+        assert(fb_block->tss_sig_ != nullptr);
+        assert(*(fb_block->tss_sig_->getSig()) == *(tss_sig->getSig()));
+        assert(fb_block->batch_ == nullptr);
+
+        // truncated or garbage bytes are rejected before they are read
+        std::string truncated((const char *)(fb_bytes->data()), fb_bytes->size() / 2);
+        assert(!BlockView(truncated).verify());
+        assert(flatbuffers_adapter<Block>::from_bytes(std::string_view(truncated)) == nullptr);
+        assert(!BlockView(std::string("ab")).verify());
+        assert(flatbuffers_adapter<BLSSigShare>::from_fb(nullptr) == nullptr);
+
+        // batch certificate
+        Block member(block);
+        member.batch_ = std::make_shared<const BatchCert>(BatchCert{1, 4, {}});
+        member.batch_index_ = 2;
+        member.batch_proof_ = {sha256::digest{}, sha256::digest{}};
+        member.batch_proof_[1].fill(7);
+        auto member_bytes = flatbuffers_adapter<Block>::to_bytes(member);
+        Block copied;
+        assert(BlockView(member_bytes->data(), member_bytes->size()).copy_commit(copied));
+        assert(copied.batch_ != nullptr && copied.batch_->size == 4);
+        assert(copied.batch_index_ == 2);
+        assert(copied.batch_proof_ == member.batch_proof_);
+
+        // not committed yet
+        Block uncommitted(block);
+        uncommitted.tss_sig_ = nullptr;
+        auto uncommitted_bytes = flatbuffers_adapter<Block>::to_bytes(uncommitted);
+        assert(!BlockView(uncommitted_bytes->data(), uncommitted_bytes->size()).copy_commit(copied));
+        spdlog::info("flatbuffers block");
+    }
+
+    // test columnar transactions
+    {
+        Block col_block;
+        std::mt19937_64 tx_rng(7);
+        for (uint64_t i = 0; i < 1001; i++)
+        {
+            col_block.insert(Transaction(
+                1000000 + i, tx_rng() % 256, tx_rng() % 65536, tx_rng(), 10));
+        }
+
+        std::string col_bytes;
+        tx_codec::encode(col_block.tx_vec_, col_bytes);
+        assert(tx_codec::count((const uint8_t *)(col_bytes.data()), col_bytes.size()) == 1001);
+        for (bool use_simd : {false, true})
+        {
+            tx_codec::columns columns;
+            assert(tx_codec::decode((const uint8_t *)(col_bytes.data()), col_bytes.size(), columns, use_simd));
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                assert(columns.id[i] == col_block.tx_vec_[i].id_);
+                assert(columns.sender[i] == col_block.tx_vec_[i].sender_);
+                assert(columns.receiver[i] == col_block.tx_vec_[i].receiver_);
+                assert(columns.value[i] == col_block.tx_vec_[i].value_);
+                assert(columns.fee[i] == col_block.tx_vec_[i].fee_);
+            }
+            assert(!tx_codec::decode((const uint8_t *)(col_bytes.data()), col_bytes.size() - 1, columns, use_simd));
+        }
+
+        // ids may repeat: all equal (zero width) or drawn from a small range
+        for (uint64_t id_range : {1, 3})
+        {
+            std::vector<Transaction> repeated;
+            for (uint64_t i = 0; i < 1001; i++)
+            {
+                repeated.push_back(Transaction(1 + tx_rng() % id_range, 2, 3, 4, 5));
+            }
+            std::string bytes;
+            tx_codec::encode(repeated, bytes);
+            for (bool use_simd : {false, true})
+            {
+                tx_codec::columns columns;
+                assert(tx_codec::decode((const uint8_t *)(bytes.data()), bytes.size(), columns, use_simd));
+                assert(columns.size() == repeated.size());
+                for (size_t i = 0; i < columns.size(); i++)
+                {
+                    assert(columns.id[i] == repeated[i].id_);
+                    assert(columns.fee[i] == repeated[i].fee_);
+                }
+            }
+        }
+
+        // a huge count with zero-width columns must not be allocated
+        {
+            std::string bogus;
+            tx_codec::encode({Transaction(1, 2, 3, 4, 5)}, bogus);
+            const uint32_t huge = UINT32_MAX;
+            std::memcpy(bogus.data() + 1, &huge, sizeof(huge));
+            tx_codec::columns columns;
+            assert(!tx_codec::decode((const uint8_t *)(bogus.data()), bogus.size(), columns));
+            assert(columns.size() == 0);
+
+            // identical transactions encode to zero-width columns
+            std::string same;
+            tx_codec::encode(std::vector<Transaction>(2, Transaction(1, 2, 3, 4, 5)), same);
+            const uint32_t too_many = tx_codec::max_count + 1;
+            std::memcpy(same.data() + 1, &too_many, sizeof(too_many));
+            assert(!tx_codec::decode((const uint8_t *)(same.data()), same.size(), columns));
+            assert(columns.size() == 0);
+        }
+
+        flatbuffers_adapter<Block>::set_tx_layout(tx_codec::layout::columns);
+        auto fb_bytes = flatbuffers_adapter<Block>::to_bytes(col_block);
+        flatbuffers_adapter<Block>::set_tx_layout(tx_codec::layout::rows);
+        BlockView view(fb_bytes->data(), fb_bytes->size());
+        assert(view.verify());
+        assert(view.has_tx_columns());
+        assert(view.tx_count() == 1001);
+        auto fb_block = view.to_block();
+        assert(fb_block->tx_vec_.size() == 1001);
+        assert(fb_block->tx_vec_.at(1000).value_ == col_block.tx_vec_.at(1000).value_);
+        spdlog::info("columnar txs: {} bytes", col_bytes.size());
+    }
+
+    // test compressed vote encoding
+    {
+        std::vector<std::shared_ptr<BlockVote>> votes;
+        for (size_t i = 0; i < 8; i++)
+        {
+            auto sp_vote = std::make_shared<BlockVote>();
+            sp_vote->block_id_ = 7;
+            sp_vote->voter_id_ = i + 1;
+            sp_vote->sig_share_ = keys->first->at(i)->sign(spHashArr, i + 1);
+            votes.push_back(sp_vote);
+        }
+
+        for (auto enc : {vote_codec::encoding::raw, vote_codec::encoding::compressed})
+        {
+            std::vector<std::string> sig_shares = vote_codec::encode_sig_shares(votes, enc);
+            std::vector<vote_codec::entry> entries;
+            for (size_t i = 0; i < votes.size(); i++)
+            {
+                if (enc == vote_codec::encoding::compressed)
+                {
+                    assert(sig_shares[i].size() == vote_codec::compressed_share_size);
+                }
+                entries.push_back({votes[i]->block_id_, votes[i]->voter_id_, sig_shares[i], votes[i]->sig_share_->getHint()});
+            }
+            auto decoded = vote_codec::decode_batch(entries, enc, num_signed, num_all);
+            for (size_t i = 0; i < votes.size(); i++)
+            {
+                assert(decoded[i] != nullptr);
+                assert(*(decoded[i]->sig_share_->getSigShare()) == *(votes[i]->sig_share_->getSigShare()));
+            }
+
+            // batch votes must cover a whole batch as configured
+            const std::string root(sha256::digest_size, '\x01');
+            std::vector<vote_codec::entry> batch_entries = {
+                {8, 1, sig_shares[0], votes[0]->sig_share_->getHint(), 4, root},
+                {8, 1, sig_shares[0], votes[0]->sig_share_->getHint(), 8, root},
+                {2, 1, sig_shares[0], votes[0]->sig_share_->getHint(), 4, root}};
+            auto batch_decoded = vote_codec::decode_batch(batch_entries, enc, num_signed, num_all, 4, 2);
+            assert(batch_decoded[0] != nullptr && batch_decoded[0]->batch_size_ == 4);
+            assert(batch_decoded[1] == nullptr);
+            assert(batch_decoded[2] == nullptr);
+            assert(vote_codec::decode_batch(batch_entries, enc, num_signed, num_all)[0] == nullptr);
+
+            // shares libBLS refuses are dropped, not thrown
+            std::vector<vote_codec::entry> refused = {
+                {7, 1, sig_shares[0], ""},
+                {7, 0, sig_shares[0], votes[0]->sig_share_->getHint()}};
+            for (const auto &vote : vote_codec::decode_batch(refused, enc, num_signed, num_all))
+            {
+                assert(vote == nullptr);
+            }
+        }
+
+        // the point at infinity (flag 0x02)
+        std::string infinity(vote_codec::compressed_share_size, '\0');
+        infinity[0] = 0x02;
+        std::vector<vote_codec::entry> infinity_entries = {
+            {7, 1, infinity, votes[0]->sig_share_->getHint()}};
+        assert(vote_codec::decode_batch(infinity_entries, vote_codec::encoding::compressed, num_signed, num_all)[0] == nullptr);
+
+        // raw limbs off the curve
+        std::string off_curve = vote_codec::encode_sig_shares(votes, vote_codec::encoding::raw)[0];
+        off_curve[0] ^= 0x01;
+        std::vector<vote_codec::entry> off_curve_entries = {
+            {7, 1, off_curve, votes[0]->sig_share_->getHint()}};
+        assert(vote_codec::decode_batch(off_curve_entries, vote_codec::encoding::raw, num_signed, num_all)[0] == nullptr);
+
+        // x that is not on the curve
+        std::string bad(vote_codec::compressed_share_size, '\0');
+        bad[vote_codec::compressed_share_size - 1] = 5;
+        libff::alt_bn128_G1 bad_point;
+        assert(!vote_codec::decompress_point(bad, bad_point));
+        spdlog::info("vote encoding");
+    }
+
+    // test cached block payload
+    {
+        auto payload_1 = flatbuffers_adapter<Block>::payload(block);
+        auto payload_2 = flatbuffers_adapter<Block>::payload(block);
+        assert(payload_1 == payload_2);
+
+        block.header_.commit_ts_ = 42;
+        block.invalidate_payload();
+        auto payload_3 = flatbuffers_adapter<Block>::payload(block);
+        assert(payload_3 != payload_1);
+        assert(BlockView(*payload_3).header()->commit_ts() == 42);
+        spdlog::info("block payload");
+    }
+
     // test block header
     {
         std::random_device dev;
@@ -69,13 +315,14 @@ int main()
         uint64_t header_id = distribution(rng);
         uint64_t header_baseid = distribution(rng);
         BlockHeader hdr1(header_id, header_baseid, 1);
-        auto hdr_bv = flexbuffers_adapter<BlockHeader>::to_bytes(hdr1);
-        std::string hdr1_ser(hdr_bv->begin(), hdr_bv->end());
+        std::string hdr1_ser;
+        flexbuffers_adapter<BlockHeader>::to_bytes(hdr1, hdr1_ser);
 
-        std::vector<uint8_t> blkhdr_ser(hdr1_ser.begin(), hdr1_ser.end());
         auto hdr1_des =
             flexbuffers_adapter<BlockHeader>::from_bytes(
-                std::make_shared<std::vector<uint8_t>>(blkhdr_ser));
+                std::string_view(hdr1_ser));
+        assert(hdr1_des->id_ == header_id);
+        assert(hdr1_des->base_id_ == header_baseid);
         spdlog::info("hdr1: {} {}", header_id, header_baseid);
         spdlog::info("hdr1: {} {}", hdr1_des->id_, hdr1_des->base_id_);
     }
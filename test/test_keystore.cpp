@@ -0,0 +1,83 @@
+#include "keystore.hpp"
+#include "lagrange.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <fstream>
+
+using namespace tomchain;
+
+int main()
+{
+    libff::init_alt_bn128_params();
+
+    const size_t num_all = 16;
+    const std::string path = "/tmp/tc-test-keystore";
+
+    keystore::keys generated = keystore::generate(num_all, num_all);
+    assert(generated.shares.size() == num_all);
+
+    // shares lie on one polynomial whose constant term is the group key
+    std::vector<libff::alt_bn128_Fr> coeffs = lagrange::coefficients(num_all);
+    libff::alt_bn128_Fr secret = libff::alt_bn128_Fr::zero();
+    for (size_t i = 0; i < num_all; i++)
+    {
+        assert(generated.shares[i].pkey == generated.shares[i].skey * libff::alt_bn128_G2::one());
+        secret = secret + coeffs[i] * generated.shares[i].skey;
+    }
+    assert(secret * libff::alt_bn128_G2::one() == generated.group_pkey);
+
+    // round trip
+    assert(keystore::save(path, generated));
+    keystore::keys loaded;
+    assert(keystore::load(path, num_all, num_all, loaded));
+    assert(loaded.threshold == num_all);
+    assert(loaded.group_pkey == generated.group_pkey);
+    for (size_t i = 0; i < num_all; i++)
+    {
+        assert(loaded.shares[i].skey == generated.shares[i].skey);
+        assert(loaded.shares[i].pkey == generated.shares[i].pkey);
+    }
+
+    // another committee size
+    assert(!keystore::load(path, num_all + 1, num_all + 1, loaded));
+
+    // a flipped byte fails the checksum
+    {
+        std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekg(100);
+        const char byte = (char)fs.get();
+        fs.seekp(100);
+        fs.put((char)(byte ^ 0x01));
+    }
+    assert(!keystore::load(path, num_all, num_all, loaded));
+
+    // and gets replaced
+    const uint64_t seed = 7;
+    keystore::keys regenerated = keystore::load_or_generate(path, num_all, num_all, seed);
+    assert(keystore::load(path, num_all, num_all, loaded));
+    assert(loaded.group_pkey == regenerated.group_pkey);
+
+    // the seed alone fixes the keys
+    keystore::keys seeded = keystore::generate(num_all, num_all, seed);
+    assert(keystore::matches_seed(seeded, seed));
+    assert(!keystore::matches_seed(seeded, seed + 1));
+    assert(seeded.group_pkey == regenerated.group_pkey);
+    for (size_t i = 0; i < num_all; i++)
+    {
+        assert(seeded.shares[i].skey == regenerated.shares[i].skey);
+    }
+
+    // a file of another seed is replaced, not used
+    keystore::keys reseeded = keystore::load_or_generate(path, num_all, num_all, seed + 1);
+    assert(keystore::matches_seed(reseeded, seed + 1));
+    assert(keystore::load(path, num_all, num_all, loaded));
+    assert(loaded.group_pkey == reseeded.group_pkey);
+
+    std::remove(path.c_str());
+
+    spdlog::info("test_keystore passed");
+
+    return 0;
+}
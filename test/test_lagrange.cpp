@@ -0,0 +1,127 @@
+#include "lagrange.hpp"
+#include "block.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+
+using namespace tomchain;
+
+int main()
+{
+    libff::init_alt_bn128_params();
+
+    // batch inversion
+    std::vector<libff::alt_bn128_Fr> values;
+    for (long i = 1; i <= 10; i++)
+    {
+        values.push_back(libff::alt_bn128_Fr(i * 7919));
+    }
+    std::vector<libff::alt_bn128_Fr> inverted = values;
+    lagrange::batch_invert(inverted);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        assert(values[i] * inverted[i] == libff::alt_bn128_Fr::one());
+    }
+
+    // closed form against the product definition
+    for (size_t n : {1, 2, 3, 7, 16})
+    {
+        std::vector<libff::alt_bn128_Fr> coeffs = lagrange::coefficients(n);
+        libff::alt_bn128_Fr sum = libff::alt_bn128_Fr::zero();
+        for (size_t i = 1; i <= n; i++)
+        {
+            libff::alt_bn128_Fr expected = libff::alt_bn128_Fr::one();
+            for (size_t j = 1; j <= n; j++)
+            {
+                if (j == i)
+                {
+                    continue;
+                }
+                expected = expected * libff::alt_bn128_Fr((long)j) *
+                           (libff::alt_bn128_Fr((long)j) - libff::alt_bn128_Fr((long)i)).inverse();
+            }
+            assert(coeffs[i - 1] == expected);
+            sum = sum + coeffs[i - 1];
+        }
+        // interpolating the constant 1
+        assert(sum == libff::alt_bn128_Fr::one());
+    }
+
+    // running aggregate matches a full merge
+    const size_t num_all = 16;
+    std::array<uint8_t, 32> hash_arr;
+    hash_arr.fill(0x3c);
+    std::shared_ptr<std::array<uint8_t, 32>> spHashArr =
+        std::make_shared<std::array<uint8_t, 32>>(hash_arr);
+    auto keys = BLSPrivateKeyShare::generateSampleKeys(num_all, num_all);
+
+    Block full;
+    Block running;
+    for (size_t i = 0; i < num_all; i++)
+    {
+        auto vote = std::make_shared<BlockVote>();
+        vote->voter_id_ = i + 1;
+        vote->sig_share_ = keys->first->at(i)->sign(spHashArr, i + 1);
+        full.add_vote(i + 1, vote);
+    }
+    full.merge_votes(num_all, num_all);
+
+    lagrange::init_cache(num_all);
+    for (size_t i = 0; i < num_all; i++)
+    {
+        auto vote = std::make_shared<BlockVote>();
+        vote->voter_id_ = i + 1;
+        vote->sig_share_ = keys->first->at(i)->sign(spHashArr, i + 1);
+        assert(running.add_vote(i + 1, vote));
+        assert(!running.add_vote(i + 1, vote));
+    }
+    // take one out and put it back
+    auto vote = running.votes_.at(5);
+    running.remove_vote(5);
+    assert(!running.is_vote_enough(num_all));
+    running.add_vote(5, vote);
+    running.merge_votes(num_all, num_all);
+
+    assert(full.tss_sig_ != nullptr && running.tss_sig_ != nullptr);
+    assert(*(full.tss_sig_->getSig()) == *(running.tss_sig_->getSig()));
+    assert(keys->second->VerifySig(spHashArr, running.tss_sig_));
+
+    // coefficients for a subset against the product definition
+    std::vector<uint64_t> subset = {2, 3, 5, 8, 13};
+    std::vector<libff::alt_bn128_Fr> subset_coeffs = lagrange::coefficients(subset);
+    for (size_t i = 0; i < subset.size(); i++)
+    {
+        libff::alt_bn128_Fr expected = libff::alt_bn128_Fr::one();
+        for (size_t j = 0; j < subset.size(); j++)
+        {
+            if (j == i)
+            {
+                continue;
+            }
+            const libff::alt_bn128_Fr x_i((long)subset[i]);
+            const libff::alt_bn128_Fr x_j((long)subset[j]);
+            expected = expected * x_j * (x_j - x_i).inverse();
+        }
+        assert(subset_coeffs[i] == expected);
+    }
+
+    // t-of-n from whichever t voters came first
+    const size_t num_signed = 11;
+    auto t_keys = BLSPrivateKeyShare::generateSampleKeys(num_signed, num_all);
+    Block quorum;
+    for (size_t i = 3; i < 3 + num_signed; i++)
+    {
+        auto vote = std::make_shared<BlockVote>();
+        vote->voter_id_ = i + 1;
+        vote->sig_share_ = t_keys->first->at(i)->sign(spHashArr, i + 1);
+        quorum.add_vote(i + 1, vote);
+    }
+    quorum.merge_votes(num_signed, num_all);
+    assert(quorum.tss_sig_ != nullptr);
+    assert(t_keys->second->VerifySig(spHashArr, quorum.tss_sig_));
+
+    spdlog::info("test_lagrange passed");
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "server/mempool.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace tomchain;
+
+namespace
+{
+    std::vector<ecdsa::Key> signers(2);
+
+    /**
+     * @brief `count` transactions with ids from `first_id`, those in
+     * `forged` signed by the wrong wallet.
+     */
+    SignedTxBatch make_batch(uint64_t first_id, size_t count, const std::vector<size_t> &forged)
+    {
+        SignedTxBatch batch;
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint64_t sender = first_id + i;
+            batch.txs.emplace_back(first_id + i, sender, 1, 0, 1);
+            const sha256::digest digest = batch.txs.back().signing_digest();
+            const bool is_forged = std::find(forged.begin(), forged.end(), i) != forged.end();
+            batch.sigs.push_back(std::get<0>(
+                signers[(sender + (is_forged ? 1 : 0)) % signers.size()].Sign(
+                    std::vector<uint8_t>(digest.begin(), digest.end()))));
+        }
+        return batch;
+    }
+
+    std::vector<uint64_t> ids(const std::vector<Transaction> &txs)
+    {
+        std::vector<uint64_t> out;
+        for (const Transaction &tx : txs)
+        {
+            out.push_back(tx.id_);
+        }
+        return out;
+    }
+}
+
+int main()
+{
+    std::vector<ecdsa::PubKey> pkeys;
+    for (ecdsa::Key &signer : signers)
+    {
+        pkeys.push_back(signer.CreatePubKey());
+    }
+    // one verifier keeps the batches in submission order
+    Mempool mempool(pkeys, 1, 4);
+    mempool.start();
+
+    SignedTxBatch first = make_batch(0, 10, {});
+    const Transaction *first_data = first.txs.data();
+    mempool.submit(std::move(first));
+    mempool.submit(make_batch(100, 10, {1, 4, 9}));
+    mempool.submit(make_batch(200, 10, {}));
+
+    while (mempool.size() < 27)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // forged signatures are counted and dropped
+    const Mempool::Stats stats = mempool.take_stats();
+    assert(stats.verified == 27);
+    assert(stats.rejected == 3);
+    assert(stats.ready == 27);
+
+    // a whole verified vector becomes the block body without a copy
+    std::vector<Transaction> block;
+    assert(mempool.take(10, block));
+    assert(block.data() == first_data);
+    assert(ids(block) == std::vector<uint64_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+    // a partial front
+    block.clear();
+    assert(mempool.take(4, block));
+    assert(ids(block) == std::vector<uint64_t>({100, 102, 103, 105}));
+
+    // the rest of that vector and part of the next
+    block.clear();
+    assert(mempool.take(6, block));
+    assert(ids(block) == std::vector<uint64_t>({106, 107, 108, 200, 201, 202}));
+
+    // too few ready leaves `out` alone
+    block.clear();
+    assert(!mempool.take(8, block));
+    assert(block.empty());
+    assert(mempool.take(7, block));
+    assert(ids(block) == std::vector<uint64_t>({203, 204, 205, 206, 207, 208, 209}));
+    assert(mempool.size() == 0);
+
+    mempool.stop();
+
+    spdlog::info("test_mempool passed");
+
+    return 0;
+}
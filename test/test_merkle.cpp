@@ -0,0 +1,160 @@
+#include "merkle.hpp"
+#include "block.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+using namespace tomchain;
+
+// straightforward pairwise reduction, for comparison
+static merkle::digest reference_root(const std::vector<Transaction>& txs)
+{
+    if (txs.empty())
+    {
+        return sha256::hash(nullptr, 0);
+    }
+
+    std::vector<merkle::digest> level;
+    for (const Transaction& tx : txs)
+    {
+        uint8_t record[1 + sizeof(Transaction)];
+        record[0] = 0x00;
+        std::memcpy(&record[1], &tx, sizeof(Transaction));
+        level.push_back(sha256::hash(record, sizeof(record)));
+    }
+    while (level.size() > 1)
+    {
+        std::vector<merkle::digest> above;
+        for (size_t i = 0; i < level.size(); i += 2)
+        {
+            if (i + 1 == level.size())
+            {
+                above.push_back(level[i]);
+                continue;
+            }
+            uint8_t record[1 + 2 * sha256::digest_size];
+            record[0] = 0x01;
+            std::memcpy(&record[1], level[i].data(), sha256::digest_size);
+            std::memcpy(&record[1 + sha256::digest_size], level[i + 1].data(), sha256::digest_size);
+            above.push_back(sha256::hash(record, sizeof(record)));
+        }
+        level = above;
+    }
+    return level[0];
+}
+
+int main()
+{
+    for (size_t n : {0, 1, 2, 3, 5, 8, 13, 100, 257, 1000, 4099})
+    {
+        std::vector<Transaction> txs;
+        for (uint64_t i = 0; i < n; i++)
+        {
+            txs.push_back(Transaction(i, i * 3, i * 7, i * 11, 1));
+        }
+
+        merkle::tree tree(txs);
+        assert(tree.leaf_count() == n);
+        assert(tree.root() == reference_root(txs));
+        assert(merkle::root(txs) == tree.root());
+
+        // ranges, including single leaves and the promoted tail
+        const size_t step = n < 16 ? 1 : n / 7;
+        for (size_t begin = 0; begin < n; begin += step)
+        {
+            for (size_t end = begin + 1; end <= n; end += step)
+            {
+                auto proof = tree.prove(begin, end);
+                assert(merkle::verify(tree.root(), n, begin, &txs[begin], end - begin, proof));
+
+                std::vector<Transaction> forged(txs.begin() + begin, txs.begin() + end);
+                forged.back().value_ += 1;
+                assert(!merkle::verify(tree.root(), n, begin, forged.data(), forged.size(), proof));
+
+                if (!proof.empty())
+                {
+                    auto short_proof = proof;
+                    short_proof.pop_back();
+                    assert(!merkle::verify(tree.root(), n, begin, &txs[begin], end - begin, short_proof));
+                }
+            }
+        }
+        assert(tree.prove(0, n + 1).empty());
+    }
+
+    // trees over block digests, as used for batch votes
+    for (size_t n : {1, 2, 3, 7, 16})
+    {
+        std::vector<merkle::digest> digests;
+        for (uint64_t i = 0; i < n; i++)
+        {
+            digests.push_back(sha256::hash((const uint8_t*)&i, sizeof(i)));
+        }
+
+        merkle::tree tree(digests);
+        assert(tree.leaf_count() == n);
+        for (size_t i = 0; i < n; i++)
+        {
+            auto proof = tree.prove(i, i + 1);
+            assert(merkle::verify(tree.root(), n, i, &digests[i], 1, proof));
+            merkle::digest forged = digests[i];
+            forged[0] ^= 1;
+            assert(!merkle::verify(tree.root(), n, i, &forged, 1, proof));
+        }
+    }
+
+    // batch members share their servers and cover each id once
+    {
+        const uint64_t server_count = 3;
+        const uint64_t batch_size = 4;
+        std::vector<size_t> hits(100, 0);
+        for (uint64_t first_id = 0; first_id < 100; first_id++)
+        {
+            if (Block::batch_first_id(first_id, batch_size, server_count) != first_id)
+            {
+                continue;
+            }
+            for (uint64_t i = 0; i < batch_size; i++)
+            {
+                const uint64_t id = Block::batch_member_id(first_id, i, server_count);
+                assert(Block::batch_first_id(id, batch_size, server_count) == first_id);
+                assert(Block::batch_index(id, batch_size, server_count) == i);
+                assert(Block::get_server_id(id, server_count) == Block::get_server_id(first_id, server_count));
+                if (id < hits.size())
+                {
+                    hits[id]++;
+                }
+            }
+        }
+        for (size_t hit : hits)
+        {
+            assert(hit == 1);
+        }
+    }
+
+    // header-only checks: the digest covers the root, not the body
+    Block block(5, 4, 0);
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        block.insert(Transaction(i, i, i + 1, 10, 1));
+    }
+    block.seal();
+    assert(block.header_.tx_count_ == 100);
+    assert(Block::verify_header(block.header_));
+    assert(block.verify_body());
+
+    BlockHeader forged_hdr(block.header_);
+    forged_hdr.tx_count_ += 1;
+    assert(!Block::verify_header(forged_hdr));
+
+    block.tx_vec_.pop_back();
+    assert(Block::verify_header(block.header_));
+    assert(!block.verify_body());
+
+    spdlog::info("test_merkle passed");
+
+    return 0;
+}
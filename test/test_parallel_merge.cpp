@@ -1,4 +1,20 @@
 #include "libBLS/libBLS.h"
+#include "lagrange.hpp"
+#include "msm.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace tomchain;
+
+template<typename F>
+static double time_ms(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
 
 int main()
 {
@@ -51,5 +67,52 @@ int main()
     assert(libff::alt_bn128_q_limbs == 4); 
     assert(sizeof(libff::alt_bn128_G1) == 96); 
 
+    // merge benchmark: libBLS serial and threaded merge against the 
+    // cached Lagrange coefficients with one scalar multiplication per 
+    // share, and with the Pippenger kernel 
+    std::printf("%6s %12s %12s %12s %12s %8s\n", 
+        "n", "merge(1)ms", "merge(16)ms", "naive ms", "msm ms", "window"); 
+    for (size_t n : {16, 64, 256, 1024})
+    {
+        auto bench_keys = BLSPrivateKeyShare::generateSampleKeys(n, n); 
+        std::vector<std::shared_ptr<BLSSigShare>> shares; 
+        std::vector<libff::alt_bn128_G1> points; 
+        for (size_t i = 0; i < n; i++)
+        {
+            shares.push_back(bench_keys->first->at(i)->sign(spHashArr, i + 1)); 
+            points.push_back(*(shares.back()->getSigShare())); 
+        }
+
+        std::shared_ptr<BLSSignature> merged_serial; 
+        std::shared_ptr<BLSSignature> merged_threaded; 
+        const double serial_ms = time_ms([&]() {
+            BLSSigShareSet sig_set(n, n); 
+            for (auto& share : shares) { sig_set.addSigShare(share); }
+            merged_serial = sig_set.merge(); 
+        }); 
+        const double threaded_ms = time_ms([&]() {
+            BLSSigShareSet sig_set(n, n); 
+            for (auto& share : shares) { sig_set.addSigShare(share); }
+            merged_threaded = sig_set.merge(16); 
+        }); 
+
+        const std::vector<libff::alt_bn128_Fr> coeffs = lagrange::coefficients(n); 
+        libff::alt_bn128_G1 naive_sig; 
+        libff::alt_bn128_G1 msm_sig; 
+        const double naive_ms = time_ms([&]() {
+            naive_sig = msm::naive(points, coeffs); 
+        }); 
+        const double msm_ms = time_ms([&]() {
+            msm_sig = msm::multi_exp(points, coeffs); 
+        }); 
+
+        assert(*(merged_serial->getSig()) == *(merged_threaded->getSig())); 
+        assert(*(merged_serial->getSig()) == naive_sig); 
+        assert(*(merged_serial->getSig()) == msm_sig); 
+
+        std::printf("%6zu %12.2f %12.2f %12.2f %12.2f %8zu\n", 
+            n, serial_ms, threaded_ms, naive_ms, msm_ms, msm::window_bits(n)); 
+    }
+
     return 0; 
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "sha256.hpp"
+#include "block.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+using namespace tomchain;
+
+static std::string to_hex(const sha256::digest& d)
+{
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    for (uint8_t b : d)
+    {
+        out.push_back(digits[b >> 4]);
+        out.push_back(digits[b & 0xf]);
+    }
+    return out;
+}
+
+int main()
+{
+    const sha256::backend backends[] = {
+        sha256::backend::portable,
+        sha256::backend::shani,
+        sha256::backend::avx2
+    };
+
+    // known vectors
+    const std::string abc = "abc";
+    const std::string two_blocks =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    for (auto b : backends)
+    {
+        if (!sha256::supported(b))
+        {
+            continue;
+        }
+        assert(to_hex(sha256::hash((const uint8_t*)abc.data(), abc.size(), b)) ==
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        assert(to_hex(sha256::hash(nullptr, 0, b)) ==
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        assert(to_hex(sha256::hash((const uint8_t*)two_blocks.data(), two_blocks.size(), b)) ==
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    }
+
+    // all backends agree, across block boundaries and chunked updates
+    std::vector<uint8_t> msg(1000);
+    for (size_t i = 0; i < msg.size(); i++)
+    {
+        msg[i] = (uint8_t)(i * 31 + 7);
+    }
+    for (size_t len : {1, 55, 56, 63, 64, 65, 119, 128, 1000})
+    {
+        auto expected = sha256::hash(msg.data(), len, sha256::backend::portable);
+        for (auto b : backends)
+        {
+            if (!sha256::supported(b))
+            {
+                continue;
+            }
+            assert(sha256::hash(msg.data(), len, b) == expected);
+
+            sha256::context ctx(b);
+            for (size_t off = 0; off < len; off += 17)
+            {
+                ctx.update(msg.data() + off, std::min<size_t>(17, len - off));
+            }
+            assert(ctx.finish() == expected);
+        }
+    }
+
+    // hash_many matches hash, including a partial group of lanes
+    const size_t msg_size = 40;
+    const size_t msg_count = 21;
+    std::vector<sha256::digest> many(msg_count);
+    sha256::hash_many(msg.data(), msg_size, msg_count, many.data());
+    for (size_t i = 0; i < msg_count; i++)
+    {
+        assert(many[i] == sha256::hash(msg.data() + i * msg_size, msg_size,
+            sha256::backend::portable));
+    }
+
+    // block digest covers id, base id and the transaction root only
+    Block block(3, 2, 0);
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        block.insert(Transaction(i, i + 1, i + 2, 100, 1));
+    }
+    assert(!block.is_sealed());
+    assert(!block.verify_digest());
+    block.seal();
+    assert(block.is_sealed());
+    assert(block.verify_digest());
+
+    block.header_.dist_ts_ = 42;
+    block.header_.commit_ts_ = 43;
+    block.votes_[1] = std::make_shared<BlockVote>();
+    assert(block.verify_digest());
+
+    block.tx_vec_[4].value_ += 1;
+    assert(!block.verify_digest());
+    block.tx_vec_[4].value_ -= 1;
+    assert(block.verify_digest());
+
+    auto signed_hash = block.get_sha256();
+    assert(std::equal(signed_hash->begin(), signed_hash->end(),
+        block.header_.digest_.begin()));
+
+    spdlog::info("sha256 best backend: {}", (int)sha256::best_backend());
+    spdlog::info("test_sha256 passed");
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "share_verifier.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+using namespace tomchain;
+
+int main()
+{
+    const size_t num_all = 32;
+
+    std::array<uint8_t, 32> hash_arr;
+    hash_arr.fill(0x5a);
+    std::shared_ptr<std::array<uint8_t, 32>> spHashArr =
+        std::make_shared<std::array<uint8_t, 32>>(hash_arr);
+    std::array<uint8_t, 32> other_arr;
+    other_arr.fill(0xa5);
+    std::shared_ptr<std::array<uint8_t, 32>> spOtherArr =
+        std::make_shared<std::array<uint8_t, 32>>(other_arr);
+
+    auto keys = BLSPrivateKeyShare::generateSampleKeys(num_all, num_all);
+
+    // signer index starts from one
+    std::vector<share_verifier::item> items;
+    for (size_t i = 0; i < num_all; i++)
+    {
+        std::shared_ptr<BLSPrivateKeyShare> skey_share = keys->first->at(i);
+        BLSPublicKeyShare pkey_share(*(skey_share->getPrivateKey()), num_all, num_all);
+        std::shared_ptr<BLSSigShare> sig_share = skey_share->sign(spHashArr, i + 1);
+        items.push_back({i + 1, *(sig_share->getSigShare()), *(pkey_share.getPublicKey())});
+    }
+
+    // all valid: a single check
+    size_t checks = 0;
+    auto start = std::chrono::steady_clock::now();
+    assert(share_verifier::find_invalid(hash_arr, items, &checks).empty());
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    assert(checks == 1);
+    spdlog::info("{} shares verified in {} us", num_all, elapsed.count());
+
+    // one share over another message
+    auto forged = items;
+    forged[7].sig = *(keys->first->at(7)->sign(spOtherArr, 8)->getSigShare());
+    checks = 0;
+    auto bad = share_verifier::find_invalid(hash_arr, forged, &checks);
+    assert(bad.size() == 1 && bad[0] == 8);
+    spdlog::info("1 bad share found with {} checks", checks);
+
+    // a share signed with another voter's key, and a swapped pair
+    forged = items;
+    forged[0].sig = items[1].sig;
+    forged[31].sig = items[30].sig;
+    forged[30].sig = items[31].sig;
+    bad = share_verifier::find_invalid(hash_arr, forged, &checks);
+    std::sort(bad.begin(), bad.end());
+    assert((bad == std::vector<uint64_t>{1, 31, 32}));
+
+    // a point off the curve is rejected without a pairing
+    forged = items;
+    forged[3].sig.X = forged[3].sig.X + libff::alt_bn128_Fq::one();
+    bad = share_verifier::find_invalid(hash_arr, forged);
+    assert(bad.size() == 1 && bad[0] == 4);
+
+    spdlog::info("test_share_verifier passed");
+
+    return 0;
+}